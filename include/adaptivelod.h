@@ -0,0 +1,80 @@
+#ifndef ADAPTIVELOD_H
+#define ADAPTIVELOD_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+// Rows and columns (2^ADAPTIVELOD_SKETCH_WIDTH_BITS) of the count-min sketch of the messages of each tile
+#define ADAPTIVELOD_SKETCH_DEPTH 4
+#define ADAPTIVELOD_SKETCH_WIDTH_BITS 14
+
+// The four children of a split tile are merged back when, together, they carry less than 1/ADAPTIVELOD_MERGE_FACTOR
+// of the split threshold (so that a tile close to the threshold is not split and merged at every interval)
+#define ADAPTIVELOD_MERGE_FACTOR 4
+
+// Maximum number of split tiles
+#define ADAPTIVELOD_MAX_SPLITS 65536
+
+// Adaptive level of detail of the quadkeys: the map is partitioned into tiles of different levels (a quadtree whose
+// roots are all the tiles of the minimum level), so that sparse regions get coarse quadkeys and dense regions fine ones
+// The messages of each tile of the partition are counted in a count-min sketch, and, at the end of each interval:
+// - each tile which received more messages than the split threshold is split into its four children (one level per
+//   interval, up to the maximum level);
+// - the four children of a split tile are merged back if they are not split themselves and, together, received less
+//   than the merge threshold
+// The partition changes only at the end of the intervals, so that the quadkey of a tile is stable during an interval
+class adaptiveLod {
+	std::vector<uint32_t> m_sketch;          // ADAPTIVELOD_SKETCH_DEPTH rows of counters
+	std::unordered_set<uint64_t> m_split;    // Binary quadkeys (see quadkey_morton.h) of the split tiles
+	std::unordered_set<uint64_t> m_pending;  // Tiles which exceeded the split threshold during the current interval
+	unsigned int m_min_level;
+	unsigned int m_max_level;
+	uint32_t m_split_count;                  // Split and merge thresholds, in messages per interval
+	uint32_t m_merge_count;
+
+	uint64_t m_splits;
+	uint64_t m_merges;
+	uint64_t m_refused;                      // Splits not performed as ADAPTIVELOD_MAX_SPLITS tiles were already split
+
+	// Count a message of the tile "qk", returning the estimated number of messages of the tile in the current interval
+	uint32_t count(uint64_t qk);
+	uint32_t estimate(uint64_t qk);
+
+	public:
+		// The tiles passed to classify() are of level "max_level", and they are split when they receive more than
+		// "split_rate" messages per second, with intervals of "interval_ms" milliseconds
+		adaptiveLod(unsigned int min_level, unsigned int max_level, double split_rate, int interval_ms);
+
+		// Count a message of the tile (tile_x, tile_y) of the maximum level, returning the level of the tile of the
+		// partition containing it
+		unsigned int classify(uint32_t tile_x, uint32_t tile_y);
+
+		// Update the partition at the end of an interval, returning true if it has changed
+		bool rebalance(void);
+
+		// Write the partition to the text file "path" (replaced atomically), returning false (and setting "error") in case of errors
+		// After a comment header, the file lists the quadkeys of all the tiles of the partition finer than the minimum
+		// level, one per line: any position outside them belongs to its tile of the minimum level
+		bool writeMap(const std::string &path, std::string &error);
+
+		size_t getSplitTiles(void) {
+			return m_split.size();
+		}
+
+		uint64_t getSplits(void) {
+			return m_splits;
+		}
+
+		uint64_t getMerges(void) {
+			return m_merges;
+		}
+
+		uint64_t getRefused(void) {
+			return m_refused;
+		}
+};
+
+#endif // ADAPTIVELOD_H
@@ -0,0 +1,98 @@
+#ifndef ADDR_FORMAT_H
+#define ADDR_FORMAT_H
+
+// Allocation-free formatting of socket addresses, used to attach the source of each relayed message
+// as AMQP property, without relying on inet_ntoa() (which is not thread-safe) or on any dynamic memory allocation
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Maximum length of a formatted "address:port" string (including the terminating '\0')
+#define ADDR_FORMAT_MAXLEN 64
+
+// Write the decimal representation of "value" into "out", returning the number of written characters
+static inline size_t addr_format_uint(char *out, uint32_t value) {
+	char digits[10];
+	size_t ndigits=0;
+
+	do {
+		digits[ndigits++]='0'+(value%10);
+		value/=10;
+	} while(value>0);
+
+	for(size_t i=0;i<ndigits;i++) {
+		out[i]=digits[ndigits-1-i];
+	}
+
+	return ndigits;
+}
+
+// Write an IPv4 address (network byte order) in dotted-decimal notation into "out" (at least INET_ADDRSTRLEN bytes long),
+// returning the number of written characters (the string is not '\0'-terminated)
+static inline size_t addr_format_ipv4(char *out, const struct in_addr *addr) {
+	const uint8_t *bytes=(const uint8_t *) &addr->s_addr;
+	size_t len=0;
+
+	for(int i=0;i<4;i++) {
+		if(i>0) {
+			out[len++]='.';
+		}
+		len+=addr_format_uint(out+len,bytes[i]);
+	}
+
+	return len;
+}
+
+// Write "address:port" into "out" (at least ADDR_FORMAT_MAXLEN bytes long), returning the length of the '\0'-terminated string
+static inline size_t addr_format_sockaddr_in(char *out, const struct sockaddr_in *sa) {
+	size_t len=addr_format_ipv4(out,&sa->sin_addr);
+
+	out[len++]=':';
+	len+=addr_format_uint(out+len,ntohs(sa->sin_port));
+	out[len]='\0';
+
+	return len;
+}
+
+// Return true if "addr" is an IPv4-mapped IPv6 address (i.e., ::ffff:a.b.c.d, as received by dual-stack sockets)
+static inline int addr_is_v4mapped(const struct sockaddr_in6 *addr) {
+	return IN6_IS_ADDR_V4MAPPED(&addr->sin6_addr);
+}
+
+// Write "address:port" (IPv4, or IPv4-mapped IPv6 addresses) or "[address]:port" (IPv6) into "out" (at least ADDR_FORMAT_MAXLEN bytes long),
+// returning the length of the '\0'-terminated string
+// inet_ntop() is used for IPv6 addresses, as it is thread-safe and does not allocate any memory
+static inline size_t addr_format_sockaddr(char *out, const struct sockaddr *sa) {
+	size_t len=0;
+
+	if(sa->sa_family==AF_INET) {
+		return addr_format_sockaddr_in(out,(const struct sockaddr_in *) sa);
+	} else if(sa->sa_family==AF_INET6) {
+		const struct sockaddr_in6 *sa6=(const struct sockaddr_in6 *) sa;
+
+		if(addr_is_v4mapped(sa6)) {
+			len=addr_format_ipv4(out,(const struct in_addr *) &sa6->sin6_addr.s6_addr[12]);
+		} else {
+			out[len++]='[';
+			if(inet_ntop(AF_INET6,&sa6->sin6_addr,out+len,ADDR_FORMAT_MAXLEN-len)==NULL) {
+				out[0]='\0';
+				return 0;
+			}
+			while(out[len]!='\0') {
+				len++;
+			}
+			out[len++]=']';
+		}
+
+		out[len++]=':';
+		len+=addr_format_uint(out+len,ntohs(sa6->sin6_port));
+	}
+
+	out[len]='\0';
+
+	return len;
+}
+
+#endif // ADDR_FORMAT_H
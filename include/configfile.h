@@ -0,0 +1,24 @@
+#ifndef CONFIGFILE_H
+#define CONFIGFILE_H
+
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+// Global (i.e., not pipeline-specific) options which can be set in a configuration file
+typedef struct _config_global_opts {
+	int amqp_threads;                        // Number of threads running the (shared) Proton container (0 = one for each AMQP connection)
+} config_global_opts_t;
+
+// Parse a relayer configuration file, defining one or more pipelines
+// The file is made of "key = value" lines, where each key has the same name as the corresponding long command line option
+// (e.g., "listen-port = 49900"). Each "[name]" line starts the definition of a new pipeline; all the keys set before
+// the first pipeline definition are used as default values for all the pipelines. Lines starting with '#' or ';' are ignored.
+// The "listen" key can be repeated, to make the same pipeline listen on several endpoints, and the "lane-rule" key
+// can be repeated to define several lane classification rules.
+// "defaults" contains the pipeline options coming from the command line, used for all the keys not specified in the file
+// It returns false, after printing an error message, if the file cannot be read or contains invalid entries
+bool parse_config_file(const std::string &filename, const pipeline_opts_t &defaults, std::vector<pipeline_opts_t> &pipelines, config_global_opts_t &global_opts);
+
+#endif // CONFIGFILE_H
@@ -0,0 +1,95 @@
+#ifndef CONFLATION_H
+#define CONFLATION_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+#include <proton/message.hpp>
+
+#include "hashtable.h"
+
+// Default number of slots of the conflation table (i.e., maximum number of distinct keys per conflation interval)
+#define CONFLATION_DEFAULT_SLOTS 65536
+
+// Key used to conflate messages
+typedef enum {
+	CONFLATE_BY_STATION,                     // ETSI station ID and message ID (non-ETSI packets are not conflated)
+	CONFLATE_BY_SOURCE                       // Source address and port
+} conflation_key_mode_t;
+
+// Parse the name of a conflation key mode ("station" or "source"), returning false if the name is not valid
+bool parse_conflation_key_mode(const std::string &name, conflation_key_mode_t &mode);
+
+typedef struct _conflation_key {
+	uint64_t hi;
+	uint64_t lo;
+	uint32_t extra;
+} conflation_key_t;
+
+static inline bool conflation_key_equal(const conflation_key_t &a, const conflation_key_t &b) {
+	return a.hi==b.hi && a.lo==b.lo && a.extra==b.extra;
+}
+
+// Hash of a key, combining its three fields (also used by the per-source tables of the rate limiter)
+static inline uint64_t conflation_key_hash(const conflation_key_t &key) {
+	return hash_mix64(key.hi*0x9E3779B97F4A7C15ULL ^ key.lo ^ ((uint64_t) key.extra << 32));
+}
+
+// Build the conflation key of a station (station ID and message ID) or of a source address (IPv4, IPv6 or local socket)
+void conflation_key_station(uint32_t station_id, uint8_t message_id, conflation_key_t &key);
+void conflation_key_source(const struct sockaddr_storage &src_addr, conflation_key_t &key);
+
+// Latest-value conflation table: it keeps, for each key, only the newest message received during the current
+// conflation interval, in a fixed-size open-addressing (linear probing) hash table
+// The messages are flushed, in order of first arrival of their key, at the end of each interval
+class conflationTable {
+	typedef struct _conflation_slot {
+		bool used;
+		conflation_key_t key;
+		proton::message msg;
+		size_t conn_idx;                     // Index of the AMQP connection and of the sender the message should be sent to
+		int sender_idx;
+		int lane;                            // Priority lane
+	} conflation_slot_t;
+
+	std::vector<conflation_slot_t> m_slots;
+	std::vector<uint32_t> m_used;            // Indexes of the used slots, in order of first arrival
+	size_t m_mask;
+	size_t m_max_used;                       // Maximum number of used slots (to keep the probe sequences short)
+
+	public:
+		// "slots" is rounded up to a power of 2
+		conflationTable(size_t slots = CONFLATION_DEFAULT_SLOTS);
+
+		// Store "msg" (which is moved into the table), replacing any older message with the same key
+		// Returns 1 if an older message has been replaced, 0 if the key was not in the table, or -1 if the table is
+		// full (the message is then left untouched, and should be sent immediately)
+		int store(const conflation_key_t &key, proton::message &msg, size_t conn_idx, int sender_idx, int lane);
+
+		// Call send(msg, conn_idx, sender_idx, lane) for each stored message, then empty the table
+		template<typename F>
+		void flush(F send) {
+			for(uint32_t idx : m_used) {
+				conflation_slot_t &slot=m_slots[idx];
+
+				send(slot.msg,slot.conn_idx,slot.sender_idx,slot.lane);
+				slot.used=false;
+				slot.msg.clear();
+			}
+
+			m_used.clear();
+		}
+
+		size_t getCount(void) {
+			return m_used.size();
+		}
+
+		size_t getSlots(void) {
+			return m_slots.size();
+		}
+};
+
+#endif // CONFLATION_H
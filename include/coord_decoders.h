@@ -0,0 +1,218 @@
+#ifndef COORD_DECODERS_H
+#define COORD_DECODERS_H
+
+// Decoders of the latitude/longitude pair carried inside each relayed payload (used to compute the "quadkeys" property)
+// The coordinates are two consecutive values (latitude first) of the same numeric type, at a given offset from the
+// beginning of the payload. Each combination of type, byte order and strip/keep behaviour is a separate template
+// instantiation, selected once at startup through a function pointer, so that the per-packet path does not branch on the format
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <endian.h>
+#include <math.h>
+#include <string>
+
+#include "etsi_position.h"
+
+typedef enum {
+	COORD_INT32,                             // Signed 32 bits integers, in units of 1/scale degrees (e.g., 1e-7 degrees)
+	COORD_FLOAT32,                           // IEEE 754 single precision, in units of 1/scale degrees
+	COORD_FLOAT64,                           // IEEE 754 double precision, in units of 1/scale degrees
+	COORD_ETSI                               // Reference position of an ETSI CAM/DENM (see etsi_position.h), possibly behind GeoNetworking/BTP
+} coord_type_t;
+
+// Coordinates format, as specified by the user
+typedef struct _coord_format {
+	coord_type_t type;
+	bool big_endian;
+	size_t offset;                           // Offset of the latitude from the beginning of the payload, in bytes
+	double scale;                            // Units per degree (the decoded values are divided by scale)
+	bool strip;                              // = true to remove the coordinates from the relayed payload
+} coord_format_t;
+
+// Result of the decoding of a payload
+typedef struct _coord_decoded {
+	double lat;
+	double lon;
+	size_t strip_offset;                     // Bytes [strip_offset, strip_offset+strip_len) must be removed from the relayed payload
+	size_t strip_len;
+	bool has_int;                            // = true if lat_int and lon_int are valid (COORD_INT32 and COORD_ETSI only)
+	int32_t lat_int;                         // Coordinates as received, before the division by the scale (1e7 for COORD_ETSI)
+	int32_t lon_int;
+	bool has_ids;                            // = true if station_id and message_id are valid (COORD_ETSI only)
+	uint32_t station_id;
+	uint8_t message_id;
+} coord_decoded_t;
+
+// Decode the coordinates of the "len" bytes long payload "buf", returning false if the payload is too short
+// Coordinates which are not available are returned as NaN
+typedef bool (*coord_decoder_fn)(const uint8_t *buf, size_t len, const coord_format_t &fmt, coord_decoded_t &out);
+
+// Result of the validation of the decoded coordinates
+typedef enum {
+	COORD_VALID=0,
+	COORD_UNAVAILABLE=1,                     // NaN, or ETSI "unavailable" value (ETSI_LAT_UNAVAILABLE/ETSI_LON_UNAVAILABLE)
+	COORD_OUT_OF_RANGE=2                     // Latitude outside [-90, 90] or longitude outside [-180, 180] degrees (or infinite)
+} coord_status_t;
+
+// Validate the decoded coordinates before projecting them, without data-dependent branches (each check is a comparison
+// combined with bitwise operators, as most packets are valid and a mispredicted branch costs more than all the checks)
+// "sentinels" = true if the integer coordinates are in 1e-7 degrees, where the ETSI "unavailable" values must be detected
+static inline coord_status_t coord_validate(const coord_decoded_t &c, bool sentinels) {
+	// NaN fails all the comparisons, including c.lat==c.lat
+	int nan=(c.lat!=c.lat) | (c.lon!=c.lon);
+	int sentinel=(sentinels & c.has_int) & ((c.lat_int==ETSI_LAT_UNAVAILABLE) | (c.lon_int==ETSI_LON_UNAVAILABLE));
+	int in_range=(fabs(c.lat)<=90.0) & (fabs(c.lon)<=180.0);
+	int unavailable=nan | sentinel;
+
+	return (coord_status_t) (unavailable*COORD_UNAVAILABLE + (1-unavailable)*(1-in_range)*COORD_OUT_OF_RANGE);
+}
+
+// Unsigned integer with the same size as each coordinate type, used to load and byte swap the raw value
+template<typename T> struct coord_is_int { static const bool value=false; };
+template<> struct coord_is_int<int32_t> { static const bool value=true; };
+
+template<typename T> struct coord_raw_type;
+template<> struct coord_raw_type<int32_t> { typedef uint32_t type; };
+template<> struct coord_raw_type<float> { typedef uint32_t type; };
+template<> struct coord_raw_type<double> { typedef uint64_t type; };
+
+static inline uint32_t coord_to_host(uint32_t raw, bool big_endian) {
+	return big_endian ? be32toh(raw) : le32toh(raw);
+}
+
+static inline uint64_t coord_to_host(uint64_t raw, bool big_endian) {
+	return big_endian ? be64toh(raw) : le64toh(raw);
+}
+
+// Load a (possibly unaligned) coordinate value from "ptr"
+template<typename T, bool BigEndian>
+static inline T coord_load(const uint8_t *ptr) {
+	typename coord_raw_type<T>::type raw;
+	T value;
+
+	memcpy(&raw,ptr,sizeof(raw));
+	raw=coord_to_host(raw,BigEndian);
+	memcpy(&value,&raw,sizeof(value));
+
+	return value;
+}
+
+template<typename T, bool BigEndian, bool Strip>
+static bool coord_decode(const uint8_t *buf, size_t len, const coord_format_t &fmt, coord_decoded_t &out) {
+	if(len<fmt.offset+2*sizeof(T)) {
+		return false;
+	}
+
+	T lat=coord_load<T,BigEndian>(buf+fmt.offset);
+	T lon=coord_load<T,BigEndian>(buf+fmt.offset+sizeof(T));
+
+	out.lat=(double) lat/fmt.scale;
+	out.lon=(double) lon/fmt.scale;
+	out.has_int=coord_is_int<T>::value;
+	// Floating point values are not converted (they may not fit in an int32)
+	out.lat_int=coord_is_int<T>::value ? (int32_t) lat : 0;
+	out.lon_int=coord_is_int<T>::value ? (int32_t) lon : 0;
+	out.strip_offset=fmt.offset;
+	out.strip_len=Strip ? 2*sizeof(T) : 0;
+	out.has_ids=false;
+
+	return true;
+}
+
+// ETSI CAM/DENM: the payload is always relayed as it is, and any packet which is not a supported CAM/DENM is relayed
+// without coordinates (there is no full ASN.1 decoder to fall back to)
+static bool coord_decode_etsi(const uint8_t *buf, size_t len, const coord_format_t &fmt, coord_decoded_t &out) {
+	etsi_position_t pos;
+
+	out.strip_offset=0;
+	out.strip_len=0;
+	out.has_int=false;
+
+	if(!etsi_extract_position_auto(buf,len,pos)) {
+		out.lat=NAN;
+		out.lon=NAN;
+		out.has_ids=false;
+
+		return true;
+	}
+
+	out.lat=pos.lat==ETSI_LAT_UNAVAILABLE ? NAN : (double) pos.lat/1e7;
+	out.lon=pos.lon==ETSI_LON_UNAVAILABLE ? NAN : (double) pos.lon/1e7;
+	out.has_int=true;
+	out.lat_int=pos.lat;
+	out.lon_int=pos.lon;
+	out.has_ids=true;
+	out.station_id=pos.station_id;
+	out.message_id=pos.message_id;
+
+	return true;
+}
+
+template<typename T>
+static inline coord_decoder_fn coord_select_decoder_type(const coord_format_t &fmt) {
+	if(fmt.big_endian) {
+		return fmt.strip ? &coord_decode<T,true,true> : &coord_decode<T,true,false>;
+	}
+
+	return fmt.strip ? &coord_decode<T,false,true> : &coord_decode<T,false,false>;
+}
+
+// Return the decoder specialized for "fmt"
+static inline coord_decoder_fn coord_select_decoder(const coord_format_t &fmt) {
+	switch(fmt.type) {
+		case COORD_FLOAT32:
+			return coord_select_decoder_type<float>(fmt);
+		case COORD_FLOAT64:
+			return coord_select_decoder_type<double>(fmt);
+		case COORD_ETSI:
+			return &coord_decode_etsi;
+		default:
+			return coord_select_decoder_type<int32_t>(fmt);
+	}
+}
+
+// Default scale of each coordinate type (1e7 for integers, i.e., 1e-7 degrees, as in the ETSI messages, 1 for floating point values)
+static inline double coord_default_scale(coord_type_t type) {
+	return type==COORD_INT32 ? 1e7 : 1.0;
+}
+
+// Parse a coordinates type and byte order name ("i32be", "i32le", "f32be", "f32le", "f64be" or "f64le"), or "etsi",
+// returning false if the name is not valid
+static inline bool coord_parse_format_name(const std::string &name, coord_format_t &fmt) {
+	if(name=="etsi") {
+		fmt.type=COORD_ETSI;
+		fmt.big_endian=true;
+		return true;
+	}
+
+	if(name.size()!=5) {
+		return false;
+	}
+
+	std::string type=name.substr(0,3);
+	std::string order=name.substr(3);
+
+	if(type=="i32") {
+		fmt.type=COORD_INT32;
+	} else if(type=="f32") {
+		fmt.type=COORD_FLOAT32;
+	} else if(type=="f64") {
+		fmt.type=COORD_FLOAT64;
+	} else {
+		return false;
+	}
+
+	if(order=="be") {
+		fmt.big_endian=true;
+	} else if(order=="le") {
+		fmt.big_endian=false;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+#endif // COORD_DECODERS_H
@@ -0,0 +1,60 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+
+// Number of generations (time buckets) of the duplicate suppression set
+#define DEDUP_GENERATIONS 4
+
+// Default number of payload hashes stored in each generation
+#define DEDUP_DEFAULT_SLOTS 65536
+
+// Duplicate suppression set, using a fixed amount of memory
+// The XXH64 hashes of the payloads are stored in DEDUP_GENERATIONS open-addressing tables ("generations"), each one
+// covering window/(DEDUP_GENERATIONS-1) ms: new hashes are inserted into the current generation, while lookups check
+// all of them. rotate() (to be called every window/(DEDUP_GENERATIONS-1) ms) empties the oldest generation, which then
+// becomes the current one: a repeated payload is thus always detected if it arrives within "window" ms from the first
+// copy (and it may still be detected up to window*DEDUP_GENERATIONS/(DEDUP_GENERATIONS-1) ms after it)
+class dedupFilter {
+	std::vector<uint64_t> m_tables;          // DEDUP_GENERATIONS tables of m_slots hashes (0 = empty slot)
+	size_t m_slots;
+	size_t m_mask;
+	size_t m_max_used;                       // Maximum number of hashes per generation (to keep the probe sequences short)
+	size_t m_used[DEDUP_GENERATIONS];
+	int m_current;
+
+	uint64_t m_lookups;
+	uint64_t m_hits;
+	uint64_t m_full;                         // Payloads which could not be inserted, as the current generation was full
+
+	public:
+		// "slots" (number of hashes per generation) is rounded up to a power of 2
+		dedupFilter(size_t slots = DEDUP_DEFAULT_SLOTS);
+
+		// Returns true if the same payload has been seen during the current window, otherwise it records it and returns false
+		bool isDuplicate(const uint8_t *payload, size_t len);
+
+		// Start a new generation, forgetting the payloads of the oldest one
+		void rotate(void);
+
+		uint64_t getLookups(void) {
+			return m_lookups;
+		}
+
+		uint64_t getHits(void) {
+			return m_hits;
+		}
+
+		uint64_t getFull(void) {
+			return m_full;
+		}
+
+		// Memory used by the hash tables, in bytes
+		size_t getMemoryUsage(void) {
+			return m_tables.size()*sizeof(uint64_t);
+		}
+};
+
+#endif // DEDUP_H
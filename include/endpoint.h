@@ -0,0 +1,61 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+// UDP endpoint on which a pipeline listens for packets
+// It is specified as "<address>:<port>[,option[,option...]]", where <address> is an IPv4 address, an IPv6 address
+// between square brackets (e.g., "[::]:49900", which listens on both IPv6 and IPv4, unless "v6only" is specified),
+// or "*" (any address, both IPv6 and IPv4). Available options:
+// - dev=<interface>: bind to a specific network interface (SO_BINDTODEVICE)
+// - v6only: when listening on an IPv6 address, do not accept IPv4 packets
+// - queue=<queue or topic>: relay the packets received on this endpoint to a different queue/topic than the pipeline one
+// - tag=<string>: attach, to each message received on this endpoint, a "listen_tag" AMQP property with the given value
+// - mcast-if=<interface>: when <address> is an IPv4 or IPv6 multicast group, join it on the given interface (it can be
+//   specified more than once, to join the group on several interfaces; if not specified, the group is joined on the
+//   interface selected by the kernel)
+// When <address> is a multicast group, the socket is bound to the group address, so that each endpoint only receives the
+// packets sent to its own group (even when several groups share the same port), and can thus be mapped to its own queue
+// Producers running on the same host can also use local endpoints, with the same "queue" and "tag" options:
+// - "unix:<path>": AF_UNIX datagram socket, bound to <path>
+// - "shm:<path>[,ring-size=<bytes>]": shared-memory rings (see shmring.h), handed to the producers connecting to the
+//   AF_UNIX control socket <path> (one ring of "ring-size" bytes for each producer)
+typedef enum {
+	LISTEN_UDP,
+	LISTEN_UNIX_DGRAM,
+	LISTEN_SHM_RING
+} listen_endpoint_type_t;
+
+typedef struct _listen_endpoint {
+	std::string spec;                        // Original specification (used for logging)
+	listen_endpoint_type_t type;
+	std::string path;                        // Socket path of LISTEN_UNIX_DGRAM and LISTEN_SHM_RING endpoints
+	size_t ring_size;                        // Size of the ring of each producer of LISTEN_SHM_RING endpoints
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	std::string device;
+	bool v6only;
+	std::string queue;                       // Empty to use the pipeline queue/topic
+	std::string tag;                         // Empty to avoid attaching any "listen_tag" property
+	std::vector<std::string> mcast_ifaces;   // Interfaces on which the multicast group should be joined (empty for the default one)
+} listen_endpoint_t;
+
+// Returns true if the endpoint address is an IPv4 or IPv6 multicast group
+bool is_multicast_endpoint(const listen_endpoint_t &endpoint);
+
+// Parse an endpoint specification, returning false, and an error description in "error", if it is not valid
+bool parse_listen_endpoint(const std::string &spec, listen_endpoint_t &endpoint, std::string &error);
+
+// Build an endpoint from the legacy --bindto and --listen-port options ("0.0.0.0" means any IPv4 address)
+bool make_listen_endpoint(const std::string &bind_ip, int port, listen_endpoint_t &endpoint, std::string &error);
+
+// Remove the AF_UNIX socket left at "path" by a previous run, if any (any other kind of file is left untouched)
+void unlink_stale_socket(const std::string &path);
+
+// Create a UDP (or AF_UNIX datagram) socket and bind it to "endpoint", returning the socket descriptor, or -1 (with an
+// error description in "error"); it must not be called for LISTEN_SHM_RING endpoints
+int open_listen_socket(const listen_endpoint_t &endpoint, std::string &error);
+
+#endif // ENDPOINT_H
@@ -0,0 +1,188 @@
+#ifndef ETSI_POSITION_H
+#define ETSI_POSITION_H
+
+// Decode-free extraction of the station ID, message ID and reference position from UPER-encoded ETSI CAM
+// (EN 302 637-2) and DENM (EN 302 637-3) messages, optionally preceded by the GeoNetworking and BTP headers
+// All the fields read here come before any optional field whose presence could move them, except for the DENM
+// "termination" field, which is handled through its presence bit: the bit offsets can thus be precomputed, for both
+// protocol versions 1 and 2 of the messages
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ItsPduHeader: protocolVersion (8 bits), messageID (8 bits), stationID (32 bits)
+#define ETSI_MSGID_DENM 1
+#define ETSI_MSGID_CAM 2
+#define ETSI_ITS_HEADER_BYTES 6
+
+// CAM: header (48) + generationDeltaTime (16) + CamParameters preamble (extension bit + 2 optional containers) +
+// BasicContainer extension bit (1) + stationType (8) -> referencePosition
+#define ETSI_CAM_LAT_BIT 76
+
+// DENM: header (48) + DENM preamble (3 optional containers) + ManagementContainer preamble (extension bit +
+// 5 optional/default fields, the first one being "termination") + actionID (48) + detectionTime (42) + referenceTime (42)
+// -> [termination (1 bit, if present)] -> eventPosition
+#define ETSI_DENM_TERMINATION_PRESENT_BIT 52
+#define ETSI_DENM_LAT_BIT 189
+
+// Latitude: INTEGER (-900000000..900000001), 31 bits; longitude: INTEGER (-1800000000..1800000001), 32 bits
+#define ETSI_LAT_BITS 31
+#define ETSI_LON_BITS 32
+#define ETSI_LAT_OFFSET 900000000
+#define ETSI_LON_OFFSET 1800000000
+#define ETSI_LAT_UNAVAILABLE 900000001
+#define ETSI_LON_UNAVAILABLE 1800000001
+
+// BTP destination ports of CAMs and DENMs (TS 103 248)
+#define ETSI_BTP_PORT_CAM 2001
+#define ETSI_BTP_PORT_DENM 2002
+
+typedef struct _etsi_position {
+	uint8_t protocol_version;
+	uint8_t message_id;
+	uint32_t station_id;
+	int32_t lat;                             // Latitude, in 1e-7 degrees (ETSI_LAT_UNAVAILABLE if not available)
+	int32_t lon;                             // Longitude, in 1e-7 degrees (ETSI_LON_UNAVAILABLE if not available)
+} etsi_position_t;
+
+// Read "nbits" (up to 32) bits, starting at bit "bit_off" (MSB first, as in UPER) of "buf", which is "len" bytes long
+// Returns false if the buffer is too short
+static inline bool etsi_read_bits(const uint8_t *buf, size_t len, size_t bit_off, unsigned int nbits, uint32_t &out) {
+	size_t first=bit_off/8;
+	size_t last=(bit_off+nbits-1)/8;
+	uint64_t acc=0;
+
+	if(last>=len) {
+		return false;
+	}
+
+	for(size_t i=first;i<=last;i++) {
+		acc=(acc<<8) | buf[i];
+	}
+
+	acc>>=(7-((bit_off+nbits-1)%8));
+	out=(uint32_t) (acc & ((1ULL<<nbits)-1));
+
+	return true;
+}
+
+// Skip the GeoNetworking (basic, common and extended) and BTP headers, returning the offset of the facilities layer
+// payload, and the BTP destination port, or false if the packet is not a non-secured GeoNetworking packet carrying BTP
+static inline bool etsi_skip_gn_btp(const uint8_t *buf, size_t len, size_t &payload_off, uint16_t &btp_port) {
+	size_t ext_len;
+
+	// Basic header (4 bytes): the next header must be the common header (secured packets cannot be parsed without decoding them)
+	if(len<4 || (buf[0] & 0x0F)!=1) {
+		return false;
+	}
+
+	// Common header (8 bytes): next header (BTP-A = 1, BTP-B = 2), header type and subtype
+	if(len<12) {
+		return false;
+	}
+
+	uint8_t common_nh=buf[4]>>4;
+	uint8_t ht=buf[5]>>4;
+	uint8_t hst=buf[5] & 0x0F;
+
+	if(common_nh!=1 && common_nh!=2) {
+		return false;
+	}
+
+	switch(ht) {
+		case 1:                              // Beacon
+			ext_len=24;
+			break;
+		case 2:                              // GeoUnicast
+			ext_len=48;
+			break;
+		case 3:                              // GeoAnycast
+		case 4:                              // GeoBroadcast
+			ext_len=44;
+			break;
+		case 5:                              // Topologically-scoped broadcast (single-hop or multi-hop)
+			ext_len=28;
+			break;
+		case 6:                              // Location service (request or reply)
+			ext_len=hst==0 ? 36 : 48;
+			break;
+		default:
+			return false;
+	}
+
+	payload_off=4+8+ext_len+4;
+	if(len<payload_off) {
+		return false;
+	}
+
+	btp_port=((uint16_t) buf[payload_off-4] << 8) | buf[payload_off-3];
+
+	return true;
+}
+
+// Extract the position from a CAM or DENM, starting at the ItsPduHeader
+// Returns false if the message is not a CAM/DENM of a supported version, or if it is truncated
+static inline bool etsi_extract_position(const uint8_t *buf, size_t len, etsi_position_t &pos) {
+	size_t lat_bit;
+	uint32_t raw_lat, raw_lon;
+
+	if(len<ETSI_ITS_HEADER_BYTES) {
+		return false;
+	}
+
+	pos.protocol_version=buf[0];
+	pos.message_id=buf[1];
+	pos.station_id=((uint32_t) buf[2] << 24) | ((uint32_t) buf[3] << 16) | ((uint32_t) buf[4] << 8) | buf[5];
+
+	if(pos.protocol_version!=1 && pos.protocol_version!=2) {
+		return false;
+	}
+
+	if(pos.message_id==ETSI_MSGID_CAM) {
+		lat_bit=ETSI_CAM_LAT_BIT;
+	} else if(pos.message_id==ETSI_MSGID_DENM) {
+		uint32_t termination_present;
+
+		if(!etsi_read_bits(buf,len,ETSI_DENM_TERMINATION_PRESENT_BIT,1,termination_present)) {
+			return false;
+		}
+		lat_bit=ETSI_DENM_LAT_BIT+termination_present;
+	} else {
+		return false;
+	}
+
+	if(!etsi_read_bits(buf,len,lat_bit,ETSI_LAT_BITS,raw_lat) ||
+		!etsi_read_bits(buf,len,lat_bit+ETSI_LAT_BITS,ETSI_LON_BITS,raw_lon)) {
+		return false;
+	}
+
+	pos.lat=(int32_t) ((int64_t) raw_lat-ETSI_LAT_OFFSET);
+	pos.lon=(int32_t) ((int64_t) raw_lon-ETSI_LON_OFFSET);
+
+	return true;
+}
+
+// Extract the position from a packet containing either a CAM/DENM, or a GeoNetworking (version 1) packet carrying a
+// CAM/DENM over BTP: the two cases are told apart by the first byte (GeoNetworking version and next header, or
+// facilities layer protocolVersion)
+static inline bool etsi_extract_position_auto(const uint8_t *buf, size_t len, etsi_position_t &pos) {
+	if(len>0 && (buf[0]>>4)==1) {
+		size_t payload_off;
+		uint16_t btp_port;
+
+		if(!etsi_skip_gn_btp(buf,len,payload_off,btp_port) || (btp_port!=ETSI_BTP_PORT_CAM && btp_port!=ETSI_BTP_PORT_DENM)) {
+			return false;
+		}
+
+		if(!etsi_extract_position(buf+payload_off,len-payload_off,pos)) {
+			return false;
+		}
+
+		// The facilities layer message must match the BTP port
+		return pos.message_id==(btp_port==ETSI_BTP_PORT_CAM ? ETSI_MSGID_CAM : ETSI_MSGID_DENM);
+	}
+
+	return etsi_extract_position(buf,len,pos);
+}
+
+#endif // ETSI_POSITION_H
@@ -0,0 +1,39 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+// Helpers shared by the fixed-size open-addressing hash tables of the relayer (conflation, deduplication, rate
+// limiting, tile cache, heatmap) and by the count-min sketch of the adaptive level of detail
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimum number of slots of a table
+#define HASHTABLE_MIN_SLOTS 16
+
+// Finalizer (mixing function) of splitmix64: it spreads the entropy of all the bits of "x" over all the bits of the result,
+// so that the index of the slot can be taken from any slice of it
+static inline uint64_t hash_mix64(uint64_t x) {
+	x=(x ^ (x >> 30))*0xBF58476D1CE4E5B9ULL;
+	x=(x ^ (x >> 27))*0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+// Number of slots of a table asked to hold "slots" entries: a power of 2 (the index is then hash & (size-1)), at least HASHTABLE_MIN_SLOTS
+static inline size_t hashtable_size(size_t slots) {
+	size_t size=HASHTABLE_MIN_SLOTS;
+
+	while(size<slots) {
+		size<<=1;
+	}
+
+	return size;
+}
+
+// Maximum number of used slots of a linear probing table of "size" slots: the load factor is kept below 75%, so that
+// the probe sequences stay short
+static inline size_t hashtable_max_used(size_t size) {
+	return size-size/4;
+}
+
+#endif // HASHTABLE_H
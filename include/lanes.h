@@ -0,0 +1,44 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+// Maximum number of priority lanes
+#define LANES_MAX 8
+
+// Default maximum number of messages waiting in each lane
+#define LANES_DEFAULT_QUEUE_SIZE 10000
+
+// Field matched by a lane classification rule
+typedef enum {
+	LANE_MATCH_MSGID,                        // ETSI ItsPduHeader messageID (after the GeoNetworking/BTP headers, if present), i.e., the second payload byte
+	LANE_MATCH_PORT,                         // Destination port (i.e., port of the endpoint the packet has been received on)
+	LANE_MATCH_SOURCE                        // Source address prefix
+} lane_match_type_t;
+
+typedef struct _lane_rule {
+	int lane;                                // Lane of the matching packets (0 = highest priority)
+	lane_match_type_t type;
+	uint8_t msgid;
+	uint16_t port;
+	int family;                              // Source prefix (AF_INET or AF_INET6, IPv4 prefixes match also IPv4-mapped IPv6 sources)
+	uint8_t prefix[16];
+	int prefix_len;
+} lane_rule_t;
+
+// Parse a lane classification rule, as <lane>:msgid=<id>, <lane>:port=<port> or <lane>:src=<address>[/<prefix length>]
+// Returns false, setting "error", if the rule is not valid
+bool parse_lane_rule(const std::string &spec, lane_rule_t &rule, std::string &error);
+
+// Parse a comma-separated list of lane weights (e.g., "8,2,1"), returning false if it is not valid
+bool parse_lane_weights(const std::string &spec, std::vector<unsigned int> &weights);
+
+// Return the lane of a packet: the lane of the first matching rule, or "default_lane" if no rule matches
+int lane_classify(const std::vector<lane_rule_t> &rules, int default_lane, const uint8_t *buf, size_t len,
+	const struct sockaddr_storage &src_addr, uint16_t dst_port);
+
+#endif // LANES_H
@@ -4,7 +4,16 @@
 #include <proton/messaging_handler.hpp>
 #include <proton/container.hpp>
 #include <proton/work_queue.hpp>
+#include <proton/sender.hpp>
+#include <proton/message.hpp>
 #include <atomic> // For std::atomic<bool>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Maximum number of messages sent from the priority lanes each time the lane scheduler runs on the Proton thread
+#define LANES_SERVE_BATCH 64
 
 typedef struct _pthread_camrelayer_args {
 	std::string m_broker_address;
@@ -21,8 +30,38 @@ class msgrelayerAMQP : public proton::messaging_handler {
 	// http://qpid.apache.org/releases/qpid-proton-0.32.0/proton/cpp/examples/multithreaded_client.cpp.html
 	pthread_camrelayer_args_t cr_arg_cl;         // AMQP and application parameters
 	proton::work_queue *m_work_queue_ptr;        // Pointer to a work queue for "injecting" CAMs from an external thread
-	proton::sender m_sender;                     // Sender to the CAM queue/topic
-	std::atomic<bool> m_sender_ready;            // = true when the sender is ready (i.e. we can send CAMs), = false otherwise
+	std::vector<std::string> m_queue_names;      // Queues/topics to open a sender to (index 0 is always cr_arg_cl.m_queue_name)
+	std::vector<proton::sender> m_senders;       // Senders to the CAM queues/topics (accessed only from the Proton thread)
+	unsigned int m_senders_open;                 // Number of senders already open on the current connection
+	std::atomic<bool> m_sender_ready;            // = true when all the senders are ready (i.e. we can send CAMs), = false otherwise
+
+	// Counters used to report the outcome of a graceful (draining) shutdown
+	std::atomic<uint64_t> m_enqueued;            // Number of messages successfully added to the work queue by sendMessage_AMQP()
+	std::atomic<uint64_t> m_settled;             // Number of messages settled by the broker
+	std::atomic<uint64_t> m_lost;                // Number of messages which will never be settled (in flight when the connection dropped, or sent while disconnected)
+	uint64_t m_in_flight;                        // Messages sent on the current connection and not yet settled (accessed only from the Proton thread)
+	bool m_connected;                            // = true while the connection is up (accessed only from the Proton thread)
+	std::atomic<bool> m_connection_closed;       // = true when the AMQP connection has been closed
+
+	// Priority lanes (used only when m_lanes>1): each lane has its own bounded queue and its own sender to each queue/topic
+	// (the sender of queue/topic "q" for lane "l" is m_senders[q*m_lanes+l]), and the lanes are served on the Proton thread
+	int m_lanes;
+	std::vector<unsigned int> m_lane_weights;    // Weights of the weighted round-robin scheduling (empty for strict priority)
+	size_t m_lane_queue_size;
+	std::vector<std::deque<std::pair<int,proton::message>>> m_lane_queues; // Messages (with their queue/topic index) waiting in each lane
+	std::mutex m_lane_mutex;                     // Protects m_lane_queues
+	std::atomic<bool> m_lanes_scheduled;         // = true when serveLanes() has already been added to the work queue
+	std::vector<long> m_lane_current;            // Smooth weighted round-robin state (accessed only from the Proton thread)
+
+	// Send (from the Proton thread) "msg" through the sender with index "idx", counting it as lost if the connection is down
+	void sendDelivery(size_t idx, const proton::message &msg);
+	// Count the messages in flight on the connection which has just dropped as lost (their settlement will never arrive)
+	void dropInFlight(void);
+
+	// Send (from the Proton thread) a batch of messages waiting in the lanes, in priority order
+	void serveLanes(void);
+	// Pop the next message to be sent, returning its lane (or -1 if no lane has messages with a sender with credit)
+	int popLaneMessage(std::pair<int,proton::message> &entry);
 
 	// Internal authentication/configuration variables
 	std::string m_username;
@@ -39,6 +78,9 @@ class msgrelayerAMQP : public proton::messaging_handler {
 	void on_sender_open(proton::sender& protonsender) override;
 	void on_sendable (proton::sender& sndr) override;
 	void on_message(proton::delivery &dlvr, proton::message &msg) override;
+	void on_tracker_settle(proton::tracker &trk) override;
+	void on_connection_close(proton::connection &c) override;
+	void on_transport_error(proton::transport &t) override;
 
 	public:
 		// Empty constructor
@@ -50,11 +92,52 @@ class msgrelayerAMQP : public proton::messaging_handler {
 
 		void set_args(const pthread_camrelayer_args_t camrelay_args);
 
+		// Add an additional queue/topic to send messages to, over the same AMQP connection
+		// It must be called before starting the container; it returns the index of the corresponding sender, to be passed
+		// to sendMessage_AMQP() (if the queue/topic has already been added, the index of the existing sender is returned)
+		int addQueue(const std::string &queue_name);
+
+		// Open the AMQP connection on the container "c", with this object as handler of all the connection events
+		// It can be called to share the same container among several msgrelayerAMQP objects (i.e., several connections)
+		void connect(proton::container &c);
+
 		// Public function to be called from any external thread to trigger the transmission of a message
 		// uint8_t *buffer should contain the message bytes
 		// int bufsize should contain the size, in bytes, of "buffer"
 		void sendMessage_AMQP(uint8_t *buffer, int bufsize);
 		void sendMessage_AMQP(uint8_t *buffer, int bufsize, const double &lat, const double &lon, const int &lev);
+		// Send an already prepared message through the sender with index "sender_idx" (as returned by addQueue())
+		// When priority lanes are enabled, the message is added to lane "lane" (0 = highest priority); false is returned
+		// if the message could not be queued (e.g., lane full)
+		bool sendMessage_AMQP(const proton::message &msg, int sender_idx = 0, int lane = 0);
+
+		// Enable "lanes" priority lanes, each one holding at most "queue_size" messages, scheduled with strict priority
+		// (empty "weights") or weighted round-robin; the AMQP priority of the messages is set depending on their lane
+		// It must be called before starting the container
+		void setLanes(int lanes, const std::vector<unsigned int> &weights, size_t queue_size);
+
+		int getLanes(void) {
+			return m_lanes;
+		}
+
+		// AMQP header priority (0-9) of the messages of "lane": 9 for lane 0, down to the default priority (4) for the last lane
+		uint8_t getLanePriority(int lane) {
+			return m_lanes>1 ? 4+((m_lanes-1-lane)*5)/(m_lanes-1) : 4;
+		}
+
+		// Number of messages passed to sendMessage_AMQP() and not yet settled by the broker (egress backlog)
+		// The messages lost with a dropped connection are not part of it, so that the backlog goes back to zero after reconnecting
+		uint64_t getBacklog(void) {
+			uint64_t done=m_settled+m_lost;
+			uint64_t enqueued=m_enqueued;
+
+			return enqueued>done ? enqueued-done : 0;
+		}
+
+		// Number of messages settled by the broker so far (to be snapshotted for all the connections before draining them)
+		uint64_t getSettled(void) {
+			return m_settled;
+		}
 
 		// Public function to wait for the sender to be ready, before calling sendMessage_AMQP()
 		// The application, after starting the container with run(), should call wait_sender_ready()
@@ -62,6 +145,14 @@ class msgrelayerAMQP : public proton::messaging_handler {
 		bool wait_sender_ready(void);
 		bool wait_sender_ready(std::atomic<bool> *terminatorFlag);
 
+		// Public function to gracefully terminate the AMQP client, to be called after the application has stopped calling sendMessage_AMQP()
+		// It waits, for at most timeout_ms milliseconds, for all the queued messages to be sent and settled by the broker,
+		// and then it closes the sender and the connection (making the container run() return)
+		// "settled_before" is the value of getSettled() when the drain of all the connections started: the number of messages
+		// settled since then is stored into "flushed", while the number of messages which could not be settled before the
+		// deadline is stored into "abandoned"
+		void drain(uint64_t timeout_ms, uint64_t settled_before, uint64_t &flushed, uint64_t &abandoned);
+
 		// Set credentials/configuration options
 		void setUsername(std::string username) {
 			m_username=username;
@@ -98,4 +189,38 @@ class msgrelayerAMQP : public proton::messaging_handler {
 		}
 };
 
+// Container-level handler used to start several msgrelayerAMQP connections on the same (possibly multi-threaded) Proton container
+class msgrelayerContainerHandler : public proton::messaging_handler {
+	std::vector<msgrelayerAMQP *> m_relayers;
+	int m_threads=1;                             // Number of threads which should run the container
+	int m_unlock_pd_wr=-1;
+
+	void on_container_start(proton::container& c) override;
+
+	public:
+		void addRelayer(msgrelayerAMQP *relayer) {
+			m_relayers.push_back(relayer);
+		}
+
+		const std::vector<msgrelayerAMQP *> &getRelayers(void) {
+			return m_relayers;
+		}
+
+		void setThreads(int threads) {
+			m_threads=threads>0 ? threads : 1;
+		}
+
+		int getThreads(void) {
+			return m_threads;
+		}
+
+		void setUnlockPipeDescriptorWrite(int unlock_pd_wr) {
+			m_unlock_pd_wr=unlock_pd_wr;
+		}
+
+		int getUnlockPipeDescriptorWrite(void) {
+			return m_unlock_pd_wr;
+		}
+};
+
 #endif // MESSAGERELAYERAMQP_H
@@ -0,0 +1,312 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <cinttypes>
+#include <netinet/in.h>
+
+#include <proton/message.hpp>
+
+#include "messagerelayeramqp.h"
+#include "quadkey_ts_simple.h"
+#include "rxbatch.h"
+#include "endpoint.h"
+#include "shmingest.h"
+#include "coord_decoders.h"
+#include "conflation.h"
+#include "dedup.h"
+#include "ratelimit.h"
+#include "lanes.h"
+#include "timers.h"
+#include "tilecache.h"
+#include "spatial_keys.h"
+#include "stationindex.h"
+#include "adaptivelod.h"
+#include "tileheatmap.h"
+
+// Source information (sender IP address and port, kernel receive timestamp) attached to each relayed message as AMQP properties
+typedef enum {
+	SRC_PROPS_NONE,                          // No source information
+	SRC_PROPS_TEXT,                          // "src" (string, "address:port", or socket path/"pid:<pid>" for local sources) and "rx_ts_ns" (ulong, ns since the epoch)
+	SRC_PROPS_BINARY                         // "src_addr" (binary, address in network byte order), "src_port" (ushort) and "rx_ts_ns" (ulong)
+} src_props_mode_t;
+
+// Parse the name of a source properties mode ("none", "text" or "binary"), returning false if the name is not valid
+bool parse_src_props_mode(const std::string &name, src_props_mode_t &mode);
+
+// Form of the quadkey attached to each relayed message
+typedef enum {
+	QUADKEY_FORMAT_STRING,                   // "quadkeys" (string, e.g., "120203...")
+	QUADKEY_FORMAT_ULONG,                    // "quadkey" (ulong, Morton code and level, see quadkey_morton.h)
+	QUADKEY_FORMAT_BOTH                      // Both "quadkeys" and "quadkey"
+} quadkey_format_t;
+
+// Parse the name of a quadkey format ("string", "ulong" or "both"), returning false if the name is not valid
+bool parse_quadkey_format(const std::string &name, quadkey_format_t &format);
+
+// Spatial keys attached to each relayed message with valid coordinates (any combination of these flags)
+typedef enum {
+	SPATIAL_KEYS_QUADKEY=1,                  // "quadkeys" (string) and/or "quadkey" (ulong), depending on the quadkey format
+	SPATIAL_KEYS_GEOHASH=2,                  // "geohash" (string)
+	SPATIAL_KEYS_MORTON=4                    // "morton" (ulong, 64 bits Morton code of the coordinates, see spatial_keys.h)
+} spatial_keys_t;
+
+// Parse a comma-separated list of spatial keys ("quadkey", "geohash" and "morton"), returning false if any name is not valid
+bool parse_spatial_keys(const std::string &list, unsigned int &keys);
+
+// Handling of the packets whose coordinates are not available or out of range (see coord_validate())
+typedef enum {
+	COORD_INVALID_NO_QUADKEY,                // Relay them without spatial keys
+	COORD_INVALID_DROP,                      // Drop them
+	COORD_INVALID_DEAD_LETTER                // Relay them, without spatial keys and with a "coord_error" property, to the dead-letter queue/topic
+} coord_invalid_policy_t;
+
+// Parse the name of an invalid coordinates policy ("no-quadkey", "drop" or "dead-letter"), returning false if the name is not valid
+bool parse_coord_invalid_policy(const std::string &name, coord_invalid_policy_t &policy);
+
+// Options of a single UDP->AMQP relaying pipeline (i.e., one UDP socket relaying to one AMQP queue/topic)
+// They can be set via the command line options (single pipeline) or via a configuration file (multiple pipelines)
+typedef struct _pipeline_opts {
+	std::string name;                        // Pipeline name (used only for logging)
+
+	pthread_camrelayer_args_t amqp_args;     // Broker URL and queue/topic
+	std::string bind_ip;
+	int listen_port;
+	std::vector<listen_endpoint_t> listen_endpoints; // Endpoints to listen on (if empty, a single endpoint is built from bind_ip and listen_port)
+	int minimum_msg_size;
+	int max_msg_size;                        // Packets larger than max_msg_size bytes are truncated (or dropped, if drop_truncated is true)
+	bool drop_truncated;
+	bool udp_gro;                            // = true to enable UDP Generic Receive Offload on the pipeline socket
+	bool quadk_enable;
+	int quadk_level;
+	quadkey_format_t quadk_format;
+	unsigned int spatial_keys;               // Spatial keys to be attached to each message (spatial_keys_t flags)
+	int geohash_precision;                   // Number of characters of the "geohash" property
+	int quadk_nbr_level;                     // Level of the neighbor tiles attached to each message (0 to disable them)
+	int quadk_cache_slots;                   // Number of cells of the tile cache (0 to disable the cache)
+	std::string station_index_path;          // Query socket of the index of the latest station positions (empty to disable the index)
+	int station_max_age_ms;                  // Stations are removed from the index when their latest position is older than this
+	int adaptive_lod_min_level;              // Coarsest level of the adaptive quadkeys (0 to always use quadk_level)
+	double adaptive_lod_split_rate;          // Rate (messages per second) above which a tile of the adaptive partition is split
+	int adaptive_lod_interval_ms;            // Interval at which the adaptive partition is updated
+	std::string adaptive_lod_map_path;       // File where the adaptive partition is written at each change (empty to not write it)
+	std::string heatmap_path;                // File where the per-tile heatmap is written at the end of each interval (empty to disable the heatmap)
+	int heatmap_level;                       // Level of the tiles of the heatmap (0 for the level of the quadkeys)
+	int heatmap_interval_ms;
+	heatmap_format_t heatmap_format;
+	int heatmap_slots;                       // Number of slots of each heatmap table
+	coord_format_t coord_format;             // Format of the coordinates used to compute the quadkeys (scale = 0 for the default of the type)
+	coord_invalid_policy_t coord_invalid;    // Handling of the packets with coordinates not available or out of range
+	std::string coord_dead_letter_queue;     // Queue/topic of the packets with invalid coordinates (COORD_INVALID_DEAD_LETTER only)
+	src_props_mode_t src_props;
+	int conflate_interval_ms;                // Latest-value conflation interval (0 to disable conflation)
+	conflation_key_mode_t conflate_key;
+	int conflate_slots;                      // Maximum number of distinct keys per conflation interval
+	int dedup_window_ms;                     // Duplicate suppression window (0 to disable duplicate suppression)
+	int dedup_slots;                         // Maximum number of payload hashes stored for each DEDUP_GENERATIONS-th of the window
+	double rate_limit;                       // Maximum rate of each source, in packets per second (0 to disable rate limiting)
+	double rate_burst;                       // Token bucket size (0 = one second worth of packets)
+	ratelimit_key_mode_t rate_key;
+	int rate_slots;                          // Maximum number of tracked sources
+	long shed_watermark;                     // Egress backlog (unsettled messages) above which low priority packets are dropped (0 to disable shedding)
+	int priority_lanes;                      // Number of priority lanes of the AMQP connections (0 or 1 to disable priority lanes)
+	std::vector<unsigned int> lane_weights;  // Weighted round-robin weights of the lanes (empty for strict priority)
+	int lane_queue_size;                     // Maximum number of messages waiting in each lane
+	std::vector<lane_rule_t> lane_rules;     // Classification rules (the first matching rule wins, unmatched packets go to the last lane)
+
+	// AMQP connection options
+	std::string amqp_username;
+	std::string amqp_password;
+	bool amqp_reconnect;
+	bool amqp_allow_sasl;
+	bool amqp_allow_plain;
+	long amqp_idle_timeout_ms;
+	int amqp_connections;                    // Number of parallel AMQP connections used to relay the messages of this pipeline
+} pipeline_opts_t;
+
+// Per-pipeline counters
+typedef struct _pipeline_stats {
+	uint64_t received;                       // Received UDP packets
+	uint64_t relayed;                        // Messages passed to the AMQP client
+	uint64_t truncated;                      // Packets larger than the maximum message size
+	uint64_t too_small;                      // Packets dropped as smaller than the minimum message size
+	uint64_t duplicates;                     // Packets dropped as duplicates of a packet received during the dedup window
+	uint64_t rate_limited;                   // Packets dropped as exceeding the rate of their source
+	uint64_t overload_shed;                  // Packets dropped by the overload shedder
+	uint64_t lane_relayed[LANES_MAX];        // Messages relayed through each priority lane
+	uint64_t lane_full;                      // Messages dropped as their priority lane was full
+	uint64_t send_failed;                    // Messages dropped as the AMQP client could not queue them (e.g., connection not ready)
+	uint64_t gro_segments;                   // Packets split from buffers coalesced by UDP GRO
+	uint64_t coord_unavailable;              // Packets whose coordinates are not available (e.g., ETSI "unavailable" values, or not a CAM/DENM)
+	uint64_t coord_out_of_range;             // Packets whose coordinates are out of range
+	uint64_t coord_invalid;                  // Packets relayed without quadkeys, as their coordinates are not available or out of range
+	uint64_t coord_dropped;                  // Packets dropped, as their coordinates are not available or out of range
+	uint64_t coord_dead_letter;              // Packets relayed to the dead-letter queue/topic
+	uint64_t conflated;                      // Messages replaced by a newer message with the same conflation key
+	uint64_t conflation_full;                // Messages relayed without conflation, as the conflation table was full
+} pipeline_stats_t;
+
+// Runtime state of each endpoint a pipeline listens on
+typedef struct _pipeline_endpoint {
+	listen_endpoint_t ep;
+	int sfd;                                 // UDP (or AF_UNIX datagram) socket descriptor
+	shmRingIngest *shm;                      // Shared-memory rings of LISTEN_SHM_RING endpoints (NULL for the other endpoints)
+	bool gro_enabled;                        // = true if UDP GRO has been successfully enabled on sfd
+	uint16_t dst_port;                       // Port of UDP endpoints (0 for local endpoints), used by the lane classification
+	std::vector<int> sender_idx;             // Index of the sender to the endpoint queue/topic inside each element of m_relayers
+} pipeline_endpoint_t;
+
+// Coordinates and tile of a packet, decoded and computed for a whole batch of received packets before relaying them,
+// so that the tile coordinates can be computed by the vectorized QuadKeyTSSimple::LatLonToTileXYBatch()
+typedef struct _pipeline_geo {
+	bool decoded;                            // = false if the payload is too short to contain the coordinates
+	bool valid;                              // = true if both coordinates are available and in range (tile_x and tile_y are then valid)
+	coord_status_t status;                   // Result of the validation of the coordinates (if decoded)
+	coord_decoded_t coords;
+	uint32_t tile_x;
+	uint32_t tile_y;
+	int batch_points;                        // Points passed to the batch computation (0: tile found in the tile cache, 1: the coordinates, 2: the corners of their cache cell)
+} pipeline_geo_t;
+
+// Position of a packet, projected once and shared by all the spatial key encoders
+typedef struct _spatial_point {
+	double lat;
+	double lon;
+	uint32_t tile_x;                         // Web Mercator tile (quadkeys)
+	uint32_t tile_y;
+	unsigned int tile_level;
+	uint64_t morton;                         // 64 bits Morton code of the quantized coordinates (geohash and morton, 0 if neither is enabled)
+} spatial_point_t;
+
+// Spatial key encoder, attaching the key(s) of "point" to "msg" as AMQP properties
+typedef void (*spatial_key_encoder_fn)(const spatial_point_t &point, const pipeline_opts_t &opts, proton::message &msg);
+
+// Fill "opts" with the default values of all the pipeline options
+void pipeline_opts_init(pipeline_opts_t &opts);
+
+// Returns true if two pipelines can share the same AMQP connection(s) (i.e., same broker and same connection options)
+bool pipeline_opts_same_connection(const pipeline_opts_t &a, const pipeline_opts_t &b);
+
+class relayerPipeline {
+	pipeline_opts_t m_opts;
+	std::vector<msgrelayerAMQP *> m_relayers; // AMQP connections used by this pipeline (they may be shared with other pipelines)
+	std::vector<pipeline_endpoint_t> m_endpoints;
+	pipeline_stats_t m_stats;
+	QuadKeys::QuadKeyTSSimple m_tilesys;
+	coord_decoder_fn m_coord_decoder;        // Decoder specialized for m_opts.coord_format
+	bool m_coord_sentinels;                  // = true if the integer coordinates may carry the ETSI "unavailable" values
+	std::vector<int> m_dead_letter_idx;      // Index of the sender to the dead-letter queue/topic inside each element of m_relayers
+	conflationTable *m_conflation;           // NULL if conflation is disabled
+	Timer *m_conflation_timer;
+	dedupFilter *m_dedup;                    // NULL if duplicate suppression is disabled
+	Timer *m_dedup_timer;
+	sourceRateLimiter *m_ratelimiter;        // NULL if both rate limiting and overload shedding are disabled
+	tileCache *m_tile_cache;                 // NULL if the tile cache is disabled
+	std::vector<spatial_key_encoder_fn> m_key_encoders; // Encoders of the spatial keys selected by m_opts.spatial_keys
+	stationIndex *m_station_index;           // NULL if the station index is disabled
+	Timer *m_station_timer;
+	adaptiveLod *m_adaptive_lod;             // NULL if the adaptive level of detail is disabled
+	Timer *m_adaptive_lod_timer;
+	tileHeatmap *m_heatmap;                  // NULL if the heatmap is disabled
+	Timer *m_heatmap_timer;
+	std::vector<pipeline_geo_t> m_geo;       // Coordinates and tiles of the packets of the current batch (if quadkeys are enabled)
+	std::vector<double> m_geo_lat;           // Valid coordinates of the current batch (or corners of the tile cache cells), passed to LatLonToTileXYBatch()
+	std::vector<double> m_geo_lon;
+	std::vector<uint32_t> m_geo_tile_x;
+	std::vector<uint32_t> m_geo_tile_y;
+
+	public:
+		relayerPipeline(const pipeline_opts_t &opts);
+		~relayerPipeline();
+
+		relayerPipeline(const relayerPipeline &) = delete;
+		relayerPipeline &operator=(const relayerPipeline &) = delete;
+
+		// Add an AMQP connection to relay the messages to (a sender to the pipeline queue/topic, and to the queue/topic of
+		// each endpoint specifying a different one, is added to it)
+		// When more than one connection is added, the messages are spread over them depending on their source address,
+		// so that the encoding and transmission work can be performed in parallel by different Proton threads, while
+		// keeping the order of the messages coming from the same source
+		// It must be called before starting the Proton container
+		void addRelayer(msgrelayerAMQP *relayer);
+
+		const std::vector<msgrelayerAMQP *> &getRelayers(void) {
+			return m_relayers;
+		}
+
+		const pipeline_opts_t &getOptions(void) {
+			return m_opts;
+		}
+
+		// Create and bind the sockets of all the pipeline endpoints
+		// Returns false, after printing an error message, if any socket could not be created or bound
+		bool openSockets(void);
+		void closeSockets(void);
+
+		size_t getEndpointsCount(void) {
+			return m_endpoints.size();
+		}
+
+		// Append to "fds" the descriptors to be monitored (for POLLIN) by the event loop for the endpoint "ep_idx"
+		// The descriptors of shared-memory endpoints change when producers connect or disconnect (see handleEvent())
+		void getPollDescriptors(size_t ep_idx, std::vector<int> &fds);
+
+		// Handle an event on the descriptor "fd" of the endpoint "ep_idx", relaying the received packets/records
+		// ("rx_batch" is used as temporary storage for the packets received from sockets)
+		// Returns true if the descriptors to be monitored have changed, and should be retrieved again with getPollDescriptors()
+		bool handleEvent(udpRxBatch &rx_batch, size_t ep_idx, int fd);
+
+		// Returns true if some shared-memory records are waiting to be relayed: in this case, the event loop should not
+		// block, and relayPendingRecords() should be called at each iteration
+		bool hasPendingRecords(void);
+		void relayPendingRecords(void);
+
+		// Append to "fds" the descriptors of the pipeline timers (e.g., conflation interval, dedup window, heatmap interval), and of the station index
+		// query socket, to be monitored for POLLIN, and call handleTimer() when one of them becomes readable
+		void getTimerDescriptors(std::vector<int> &fds);
+		void handleTimer(int fd);
+
+		// Relay all the messages currently held by the conflation stage
+		void flushConflated(void);
+
+		// End the current heatmap interval, writing its snapshot (e.g., at the termination, so that its counts are not lost)
+		void flushHeatmap(void);
+
+		// Receive a batch of packets from the socket of endpoint "ep_idx", using "rx_batch" as temporary storage, and relay them
+		void receiveAndRelay(udpRxBatch &rx_batch, size_t ep_idx);
+
+		const pipeline_stats_t &getStats(void) {
+			return m_stats;
+		}
+
+		void printStats(void);
+
+	private:
+		// "geo" holds the precomputed coordinates and tile of the packet (it is not used if quadkeys are disabled)
+		void relayDatagram(rx_datagram_t &dgram, pipeline_endpoint_t &endpoint, const pipeline_geo_t &geo);
+
+		// Decode the coordinates of the packet "idx" of the current batch into m_geo[idx]
+		void decodeCoordinates(size_t idx, const rx_datagram_t &dgram);
+		// Compute the tiles of the first "count" packets of the current batch, after decodeCoordinates() has been called for each of them
+		void computeTiles(size_t count);
+
+		// Relay a batch of records from the shared-memory rings of "endpoint"
+		void relayShmRecords(pipeline_endpoint_t &endpoint);
+
+		// Returns true if the packet should be dropped, as its source exceeds its rate or the egress backlog is too large
+		bool shedPacket(const rx_datagram_t &dgram);
+
+		// Store "msg" into the conflation table, returning false if it should instead be sent immediately
+		bool conflateMessage(proton::message &msg, const rx_datagram_t &dgram, size_t conn_idx, int sender_idx, int lane);
+
+		// Pass "msg" to the AMQP connection "conn_idx", updating the counters
+		void sendMessage(const proton::message &msg, size_t conn_idx, int sender_idx, int lane);
+
+		// Write the adaptive partition to m_opts.adaptive_lod_map_path (if set)
+		void publishPartition(void);
+
+		// Attach the source address/port and receive timestamp, according to m_opts.src_props
+		void addSourceProperties(proton::message &msg, const struct sockaddr_storage &src_addr, uint64_t rx_ts_ns);
+};
+
+#endif // PIPELINE_H
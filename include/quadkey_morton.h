@@ -0,0 +1,146 @@
+#ifndef QUADKEY_MORTON_H
+#define QUADKEY_MORTON_H
+
+// Conversion between the string and the binary (ulong) forms of a quadkey
+// This header does not depend on any other file of the relayer, and it can be included by C (C99) and C++ consumers
+//
+// The binary form of a quadkey of level L (1 <= L <= 26) is (morton << 5) | L, where "morton" is the Morton code
+// (Z-order) of the tile, i.e., the tile X and Y coordinates with interleaved bits (X in the even bits, Y in the odd
+// bits). The Morton code, read as a base-4 number, has the same digits as the quadkey string, so that:
+// - all the tiles of level L inside the tile of a shorter quadkey prefix form a single numeric range, which can be
+//   obtained with quadkey_ulong_range() (e.g., to be used in a "quadkey >= lo AND quadkey < hi" selector);
+// - sorting by the binary form, for quadkeys of the same level, is the same as sorting the strings.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define QUADKEY_LEVEL_BITS 5
+#define QUADKEY_MAX_LEVEL 26
+
+// Spread the lower 32 bits of "v" over the even bits of the result
+static inline uint64_t quadkey_spread_bits(uint32_t v) {
+	uint64_t x=v;
+
+	x=(x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+	x=(x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+	x=(x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	x=(x | (x << 2)) & 0x3333333333333333ULL;
+	x=(x | (x << 1)) & 0x5555555555555555ULL;
+
+	return x;
+}
+
+// Inverse of quadkey_spread_bits(): gather the even bits of "x"
+static inline uint32_t quadkey_gather_bits(uint64_t x) {
+	x&=0x5555555555555555ULL;
+	x=(x | (x >> 1)) & 0x3333333333333333ULL;
+	x=(x | (x >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+	x=(x | (x >> 4)) & 0x00FF00FF00FF00FFULL;
+	x=(x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+	x=(x | (x >> 16)) & 0x00000000FFFFFFFFULL;
+
+	return (uint32_t) x;
+}
+
+static inline uint64_t quadkey_morton_encode(uint32_t tile_x, uint32_t tile_y) {
+	return quadkey_spread_bits(tile_x) | (quadkey_spread_bits(tile_y) << 1);
+}
+
+static inline void quadkey_morton_decode(uint64_t morton, uint32_t *tile_x, uint32_t *tile_y) {
+	*tile_x=quadkey_gather_bits(morton);
+	*tile_y=quadkey_gather_bits(morton >> 1);
+}
+
+// Binary form of the tile (tile_x, tile_y) of level "level"
+static inline uint64_t quadkey_ulong_encode(uint32_t tile_x, uint32_t tile_y, unsigned int level) {
+	return (quadkey_morton_encode(tile_x,tile_y) << QUADKEY_LEVEL_BITS) | level;
+}
+
+static inline unsigned int quadkey_ulong_level(uint64_t qk) {
+	return (unsigned int) (qk & ((1U << QUADKEY_LEVEL_BITS)-1));
+}
+
+static inline uint64_t quadkey_ulong_morton(uint64_t qk) {
+	return qk >> QUADKEY_LEVEL_BITS;
+}
+
+// Convert a quadkey string ("len" digits, each one between '0' and '3') to its binary form
+// Returns 0 (which is never a valid binary quadkey) if the string is empty, too long, or contains invalid digits
+static inline uint64_t quadkey_string_to_ulong(const char *str, size_t len) {
+	uint64_t morton=0;
+
+	if(len==0 || len>QUADKEY_MAX_LEVEL) {
+		return 0;
+	}
+
+	for(size_t i=0;i<len;i++) {
+		if(str[i]<'0' || str[i]>'3') {
+			return 0;
+		}
+		morton=(morton << 2) | (uint64_t) (str[i]-'0');
+	}
+
+	return (morton << QUADKEY_LEVEL_BITS) | len;
+}
+
+// Write the string form of a binary quadkey into "out" (at least QUADKEY_MAX_LEVEL+1 bytes long), returning the
+// length of the '\0'-terminated string (0 if the level is not valid)
+static inline size_t quadkey_ulong_to_string(uint64_t qk, char *out) {
+	unsigned int level=quadkey_ulong_level(qk);
+	uint64_t morton=quadkey_ulong_morton(qk);
+
+	if(level==0 || level>QUADKEY_MAX_LEVEL) {
+		out[0]='\0';
+		return 0;
+	}
+
+	for(unsigned int i=0;i<level;i++) {
+		out[level-1-i]='0'+(char) (morton & 3);
+		morton>>=2;
+	}
+	out[level]='\0';
+
+	return level;
+}
+
+// Compute the range [*lo, *hi) of the binary forms of all the quadkeys of level "level" inside the tile of the
+// quadkey "prefix" (in binary form, with a level not greater than "level")
+// Returns 0 if the levels are not valid, 1 otherwise
+static inline int quadkey_ulong_range(uint64_t prefix, unsigned int level, uint64_t *lo, uint64_t *hi) {
+	unsigned int prefix_level=quadkey_ulong_level(prefix);
+	unsigned int shift;
+
+	if(prefix_level==0 || prefix_level>level || level>QUADKEY_MAX_LEVEL) {
+		return 0;
+	}
+
+	shift=2*(level-prefix_level);
+	*lo=((quadkey_ulong_morton(prefix) << shift) << QUADKEY_LEVEL_BITS) | level;
+	*hi=(((quadkey_ulong_morton(prefix)+1) << shift) << QUADKEY_LEVEL_BITS) | level;
+
+	return 1;
+}
+
+// Number of tiles written by quadkey_ulong_neighbors()
+#define QUADKEY_NEIGHBORS_MAX 9
+
+// Write into "out" the binary form of the tile (tile_x, tile_y) of level "level" followed by the ones of its neighbors
+// (N, NE, E, SE, S, SW, W, NW), returning the number of tiles written: the tiles beyond the north and south edges of
+// the map do not exist (and are skipped), while the X coordinate wraps around at 180 degrees of longitude
+static inline size_t quadkey_ulong_neighbors(uint32_t tile_x, uint32_t tile_y, unsigned int level, uint64_t *out) {
+	static const int dx[QUADKEY_NEIGHBORS_MAX]={0,0,1,1,1,0,-1,-1,-1};
+	static const int dy[QUADKEY_NEIGHBORS_MAX]={0,-1,-1,0,1,1,1,0,-1};
+	uint32_t mask=(1U << level)-1;
+	size_t count=0;
+
+	for(int i=0;i<QUADKEY_NEIGHBORS_MAX;i++) {
+		if((dy[i]<0 && tile_y==0) || (dy[i]>0 && tile_y==mask)) {
+			continue;
+		}
+		out[count++]=quadkey_ulong_encode((tile_x+dx[i]) & mask,tile_y+dy[i],level);
+	}
+
+	return count;
+}
+
+#endif // QUADKEY_MORTON_H
@@ -11,6 +11,9 @@
 #include <algorithm>
 #include <iterator>
 #include <array>
+#include <cstdint>
+
+#include "quadkey_morton.h"
 
 namespace QuadKeys
 {
@@ -25,6 +28,29 @@ namespace QuadKeys
         	QuadKeyTSSimple();
         	void setLevelOfDetail(int levelOfDetail = 16);
         	std::string LatLonToQuadKey(double latitude, double longitude);
+        	// Quadkey string of the tile (tileX, tileY) at the current level of detail
+        	std::string TileXYToQuadKey(uint32_t tileX, uint32_t tileY);
+        	// Tile coordinates, at the current level of detail, of a latitude/longitude pair
+        	// The Mercator projection is interpolated over a latitude table, falling back to the exact formula near the tile
+        	// edges, so that the result is always the same as with the exact formula
+        	void LatLonToTileXY(double latitude, double longitude, uint32_t &tileX, uint32_t &tileY);
+        	// LatLonToTileXY() computing the Mercator projection with the exact formula (sin() and log()), used as fallback
+        	// near the tile edges and as reference by the consistency checks
+        	void LatLonToTileXYExact(double latitude, double longitude, uint32_t &tileX, uint32_t &tileY);
+        	// Binary form of the quadkey (Morton code and level, see quadkey_morton.h)
+        	uint64_t LatLonToQuadKeyULong(double latitude, double longitude);
+        	// Batch versions of LatLonToTileXY() and LatLonToQuadKeyULong(), for "n" latitude/longitude pairs, vectorized
+        	// with AVX-512 or AVX2 when supported by the CPU (detected at runtime), with the same results as the scalar functions
+        	void LatLonToTileXYBatch(const double *lat, const double *lon, size_t n, uint32_t *tileX, uint32_t *tileY);
+        	void LatLonToQuadKeyULongBatch(const double *lat, const double *lon, size_t n, uint64_t *quadKeys);
+        	// Instruction set used by the batch functions ("avx512", "avx2" or "scalar")
+        	static const char *getBatchImplementation(void);
+        	// Force the instruction set used by the batch functions (e.g., to compare the results of the different
+        	// implementations), returning false if it is not supported by the CPU; it must be called before any batch computation
+        	static bool setBatchImplementation(const char *name);
+        	int getLevelOfDetail(void) {
+        		return m_levelOfDetail;
+        	}
     };
 }
 
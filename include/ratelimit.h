@@ -0,0 +1,98 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "conflation.h"
+
+// Default number of slots of the per-source table (i.e., maximum number of tracked sources)
+#define RATELIMIT_DEFAULT_SLOTS 16384
+
+// A source is forgotten, when the table is full, only after RATELIMIT_IDLE_SEC seconds without packets (and with a full bucket)
+#define RATELIMIT_IDLE_SEC 10
+
+// Number of forgotten sources whose dropped packets are still reported by getTopShed()
+#define RATELIMIT_EXPIRED_REPORTS 64
+
+// Key used to identify a source
+typedef enum {
+	RATELIMIT_BY_IP,                         // Source address only
+	RATELIMIT_BY_IP_PORT                     // Source address and port
+} ratelimit_key_mode_t;
+
+// Parse the name of a rate limiting key mode ("ip" or "ip-port"), returning false if the name is not valid
+bool parse_ratelimit_key_mode(const std::string &name, ratelimit_key_mode_t &mode);
+
+// Per-source counters, as reported by getTopShed()
+typedef struct _ratelimit_source_report {
+	std::string source;                      // "address" or "address:port" (depending on the key mode), or "local" for local producers
+	uint64_t passed;                         // Packets accepted by the token bucket (they may still be dropped by the overload shedder)
+	uint64_t shed_rate;                      // Packets dropped as exceeding the source rate
+	uint64_t shed_overload;                  // Packets dropped by the overload shedder
+} ratelimit_source_report_t;
+
+// Per-source token buckets, kept in a fixed-size open-addressing (linear probing) hash table
+// Each bucket holds up to "burst" tokens and it is refilled at "rate" tokens per second, lazily (i.e., only when a
+// packet from the same source is received); each relayed packet consumes one token
+// When the table is full, the idle sources (full bucket and no packets for RATELIMIT_IDLE_SEC seconds) are forgotten,
+// whatever they had dropped (their totals are kept apart for reporting), and the packets of any further source are not
+// limited (they are counted as "untracked")
+class sourceRateLimiter {
+	typedef struct _ratelimit_slot {
+		bool used;
+		conflation_key_t key;
+		struct sockaddr_in6 addr;            // Source address (a struct sockaddr_in for IPv4 sources), used only for reporting
+		double tokens;
+		uint64_t last_ns;                    // Time of the last refill
+		uint64_t seen_ns;                    // Time of the last packet (passed or dropped)
+		uint64_t passed;
+		uint64_t shed_rate;
+		uint64_t shed_overload;
+	} ratelimit_slot_t;
+
+	std::vector<ratelimit_slot_t> m_slots;
+	size_t m_mask;
+	size_t m_max_used;                       // Maximum number of used slots (to keep the probe sequences short)
+	size_t m_used;
+	double m_rate;                           // Tokens per nanosecond (0 = no rate limit, only the overload shedding is accounted)
+	double m_burst;
+	ratelimit_key_mode_t m_key_mode;
+	uint64_t m_untracked;
+	uint64_t m_last_expire_ns;
+	std::vector<ratelimit_source_report_t> m_expired_shed; // Sources forgotten after dropping packets, in decreasing order of dropped packets
+
+	ratelimit_source_report_t makeReport(const ratelimit_slot_t &slot);
+
+	// Return the slot of "src_addr", adding it if needed (NULL if the table is full)
+	ratelimit_slot_t *lookup(const struct sockaddr_storage &src_addr, uint64_t now_ns);
+	bool isIdle(const ratelimit_slot_t &slot, uint64_t now_ns);
+	void expireIdle(uint64_t now_ns);
+
+	public:
+		// "rate" is in packets per second, "slots" is rounded up to a power of 2
+		sourceRateLimiter(double rate, double burst, size_t slots, ratelimit_key_mode_t key_mode);
+
+		// Returns false if a packet received from "src_addr" at "now_ns" (monotonic time) exceeds the source rate, and should be dropped
+		bool allow(const struct sockaddr_storage &src_addr, uint64_t now_ns);
+
+		// Account a packet from "src_addr" dropped by the overload shedder
+		void countOverloadShed(const struct sockaddr_storage &src_addr, uint64_t now_ns);
+
+		// Fill "out" with the (at most "max") sources with the highest number of dropped packets
+		void getTopShed(size_t max, std::vector<ratelimit_source_report_t> &out);
+
+		uint64_t getUntracked(void) {
+			return m_untracked;
+		}
+
+		size_t getCount(void) {
+			return m_used;
+		}
+};
+
+#endif // RATELIMIT_H
@@ -0,0 +1,82 @@
+#ifndef RXBATCH_H
+#define RXBATCH_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <sys/socket.h>
+#include <netinet/udp.h>
+#include <time.h>
+#include <vector>
+
+// UDP Generic Receive Offload socket option (Linux >= 5.0), defined here in case of older C library headers
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// Maximum number of UDP packets received with a single recvmmsg() call
+#define RX_BATCH_SIZE 32
+
+// Size of the "small" buffer class, used to receive the vast majority of the packets (i.e., any packet fitting in a 1500 bytes MTU)
+// The small buffers of all the slots are contiguous in memory, keeping the common case cache-dense
+#define RX_SMALL_BUF_SIZE 2048
+
+// Maximum size of a UDP payload (including datagrams reassembled from IP fragments)
+#define RX_MAX_UDP_PAYLOAD 65535
+
+// Maximum number of segments which can be coalesced by UDP GRO into a single buffer (UDP_MAX_SEGMENTS in the kernel)
+#define RX_GRO_MAX_SEGMENTS 64
+
+// Single received UDP packet
+typedef struct _rx_datagram {
+	uint8_t *data;                           // Pointer to the (contiguous) packet payload
+	size_t len;                              // Number of payload bytes available in data
+	size_t orig_len;                         // Original size of the UDP payload (> len when the packet has been truncated)
+	bool truncated;                          // = true if the packet was larger than the maximum message size
+	struct sockaddr_storage src_addr;        // Source address and port
+	uint64_t rx_ts_ns;                       // Kernel receive timestamp, in ns since the epoch (0 if not available)
+	bool gro_segment;                        // = true if the packet has been split from a buffer coalesced by UDP GRO
+} rx_datagram_t;
+
+// Batch of receive buffers, organized as a slab pool with two size classes
+// Each slot receives into its small buffer first, and only the bytes exceeding RX_SMALL_BUF_SIZE are scattered into
+// the slot large buffer; in this case the small part is then moved in front of them to obtain a contiguous payload
+// The large buffers are allocated without initialization, so their memory pages are touched only by large packets
+// When UDP GRO is enabled on the socket, a slot may receive several same-sized packets coalesced by the kernel into a single
+// buffer: they are split here into separate rx_datagram_t entries, pointing to the original buffer (i.e., without copying them)
+class udpRxBatch {
+	uint8_t *m_small_slab;                   // RX_BATCH_SIZE buffers of RX_SMALL_BUF_SIZE bytes
+	uint8_t *m_large_slab;                   // RX_BATCH_SIZE buffers of m_large_buf_size bytes
+	size_t m_large_buf_size;
+
+	struct mmsghdr m_mmsg[RX_BATCH_SIZE];
+	struct iovec m_iov[RX_BATCH_SIZE][2];
+	char m_ctrl[RX_BATCH_SIZE][CMSG_SPACE(sizeof(struct timespec))+CMSG_SPACE(sizeof(int))] __attribute__((aligned(sizeof(size_t))));
+	struct sockaddr_storage m_src_addr[RX_BATCH_SIZE];
+	std::vector<rx_datagram_t> m_datagrams;
+	uint64_t m_gro_buffers;                  // Number of received buffers containing more than one coalesced packet
+
+	public:
+		// max_msg_size is the maximum size, in bytes, of the packets which can be received without being truncated
+		udpRxBatch(size_t max_msg_size = RX_MAX_UDP_PAYLOAD);
+		~udpRxBatch();
+
+		udpRxBatch(const udpRxBatch &) = delete;
+		udpRxBatch &operator=(const udpRxBatch &) = delete;
+
+		// Receive up to RX_BATCH_SIZE buffers from the socket "sfd", without blocking, truncating any packet
+		// larger than max_msg_size (which cannot be larger than the max_msg_size passed to the constructor)
+		// "gro" should be true if UDP GRO has been enabled on the socket: in this case the full buffer size is always used
+		// (the constructor max_msg_size should then be RX_MAX_UDP_PAYLOAD) and each coalesced buffer is split into its packets
+		// It returns the number of received packets (which can be retrieved with getDatagram()), or -1 in case of errors
+		int receive(int sfd, size_t max_msg_size, bool gro = false);
+
+		uint64_t getGROBuffers(void) {
+			return m_gro_buffers;
+		}
+
+		rx_datagram_t &getDatagram(int idx) {
+			return m_datagrams[idx];
+		}
+};
+
+#endif // RXBATCH_H
@@ -0,0 +1,89 @@
+#ifndef SHMINGEST_H
+#define SHMINGEST_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "shmring.h"
+#include "rxbatch.h"
+
+// Default size of the ring data allocated for each shared-memory producer
+#define SHM_RING_DEFAULT_SIZE (4*1024*1024)
+
+// Maximum number of records consumed (over all the producers of an endpoint) by a single receive() call, before giving
+// control back to the event loop
+#define SHM_RX_BATCH_SIZE 256
+
+// Relayer side of the shared-memory ingest (see shmring.h): it accepts the producers on an AF_UNIX control socket,
+// allocates one SPSC ring for each of them, and consumes their records
+// All the producers of the same endpoint share the same doorbell eventfd, so that only the control socket, the doorbell,
+// and one descriptor per producer (only used to detect disconnections) are monitored by the event loop
+class shmRingIngest {
+	typedef struct _shm_producer {
+		int conn_fd;                         // Control connection of the producer
+		shmring_hdr_t *hdr;
+		uint8_t *data;
+		size_t map_size;
+		// Private copies of the ring geometry: the header is writable by the producer, so only tail and consumer_waiting are read back from it
+		uint64_t ring_size;
+		uint32_t max_record_size;
+		uint64_t head;                       // Consumer position (published to hdr->head by release())
+		bool failed;                         // = true if the producer corrupted its ring (it is then no longer consumed)
+		struct sockaddr_storage src_addr;    // Source used for the AMQP properties (AF_UNIX, "pid:<producer PID>")
+	} shm_producer_t;
+
+	std::string m_path;
+	size_t m_ring_size;
+	int m_listen_fd;
+	int m_doorbell_fd;
+	std::vector<shm_producer_t> m_producers;
+	std::vector<rx_datagram_t> m_datagrams;
+	bool m_pending;                          // = true if some records were left in the rings after the last receive()
+
+	bool acceptProducer(void);
+	void removeProducer(size_t idx);
+
+	public:
+		// "path" is the control socket path, "ring_size" the size of the ring data of each producer (rounded up to a power of 2)
+		shmRingIngest(const std::string &path, size_t ring_size = SHM_RING_DEFAULT_SIZE);
+		~shmRingIngest();
+
+		shmRingIngest(const shmRingIngest &) = delete;
+		shmRingIngest &operator=(const shmRingIngest &) = delete;
+
+		// Create the control socket and the doorbell, returning false (with an error description in "error") in case of errors
+		bool open(std::string &error);
+		// Disconnect all the producers and remove the control socket
+		void close(void);
+
+		// Append the descriptors to be monitored by the event loop (for POLLIN) to "fds"
+		void getPollDescriptors(std::vector<int> &fds);
+
+		// Handle an event on one of the descriptors returned by getPollDescriptors()
+		// Returns true if the set of descriptors to be monitored has changed (i.e., a producer connected or disconnected)
+		bool handleEvent(int fd);
+
+		// Consume up to SHM_RX_BATCH_SIZE records from the rings (without copying them), returning their number
+		// The records (retrieved with getDatagram()) remain valid until release() is called
+		int receive(size_t max_msg_size);
+
+		// Give back the space of the records returned by the last receive() call to the producers
+		// If all the rings are empty, the producers are asked to ring the doorbell for the next record, otherwise
+		// hasPending() returns true, and receive() should be called again without waiting for the doorbell
+		void release(void);
+
+		bool hasPending(void) {
+			return m_pending;
+		}
+
+		rx_datagram_t &getDatagram(int idx) {
+			return m_datagrams[idx];
+		}
+
+		size_t getProducersCount(void) {
+			return m_producers.size();
+		}
+};
+
+#endif // SHMINGEST_H
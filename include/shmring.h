@@ -0,0 +1,238 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+// Shared-memory single-producer/single-consumer ring, used by producers running on the same host as the relayer to hand
+// it the records to be relayed (each record is relayed exactly like the payload of a UDP packet), without any system call
+// per record in the steady state
+// This header is self-contained and C-compatible (C99 + GCC/Clang atomic builtins), so that it can be copied into the
+// code of any producer. Usage:
+//   shmring_producer_t prod;
+//   if(shmring_producer_connect(&prod,"/run/relayer.sock")<0) { ... }  // "shm:/run/relayer.sock" endpoint of the relayer
+//   if(shmring_producer_send(&prod,buf,len)<0 && errno==EAGAIN) { ... } // ring full: retry later, or drop
+//   shmring_producer_close(&prod);
+// Protocol: the producer connects to the relayer control socket (AF_UNIX, SOCK_SEQPACKET), which replies with a
+// memfd containing the ring and an eventfd (the "doorbell"), passed as SCM_RIGHTS. The producer appends the records
+// and advances "tail", the relayer consumes them and advances "head". The doorbell is rung only when the relayer has
+// declared, through "consumer_waiting", that it found the ring empty and is going to sleep.
+// The producer is disconnected (and the ring released) when the control socket is closed.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define SHMRING_MAGIC 0x524d4853U            // "SHMR"
+#define SHMRING_VERSION 1
+
+// Each record is stored as a 4 bytes length, followed by the payload, padded to a multiple of SHMRING_REC_ALIGN bytes
+// A record which does not fit in the space left before the end of the ring is preceded by a padding marker, telling the
+// consumer to restart from the beginning of the ring (records are thus always contiguous in memory)
+#define SHMRING_REC_ALIGN 8
+#define SHMRING_REC_PAD 0xFFFFFFFFU
+#define SHMRING_REC_SIZE(len) ((((uint64_t) (len))+4+SHMRING_REC_ALIGN-1) & ~((uint64_t) SHMRING_REC_ALIGN-1))
+
+// Ring header, at the beginning of the shared memory, followed by the ring data (data_size bytes, a power of 2)
+// Positions are free-running byte counters (the offset inside the ring is position & (data_size-1))
+// The fields written by the producer and by the consumer lie on different cache lines, to avoid false sharing
+typedef struct _shmring_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t data_size;                      // Size of the ring data, in bytes (power of 2)
+	uint32_t max_record_size;                // Maximum payload size of a single record
+	uint32_t data_offset;                    // Offset of the ring data from the beginning of the shared memory
+
+	uint64_t tail __attribute__((aligned(64))); // Written by the producer only
+
+	uint64_t head __attribute__((aligned(64))); // Written by the consumer only
+	uint32_t consumer_waiting;               // Set by the consumer before sleeping, cleared by the producer ringing the doorbell
+} shmring_hdr_t;
+
+typedef struct _shmring_producer {
+	int ctrl_fd;                             // Control socket (closing it disconnects the producer)
+	int doorbell_fd;                         // eventfd used to wake up the relayer
+	shmring_hdr_t *hdr;
+	uint8_t *data;
+	size_t map_size;
+	uint64_t tail;                           // Local copy of hdr->tail
+	uint64_t head_cache;                     // Last head seen by the producer (refreshed only when the ring looks full)
+} shmring_producer_t;
+
+// Connect to the relayer listening on the control socket "path" and map the ring it allocates for this producer
+// Returns 0 on success, or -1 (with errno set) in case of errors
+static inline int shmring_producer_connect(shmring_producer_t *prod, const char *path) {
+	struct sockaddr_un addr;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	struct stat st;
+	char ctrl[CMSG_SPACE(2*sizeof(int))] __attribute__((aligned(sizeof(size_t))));
+	uint32_t version;
+	int fds[2];
+	void *map;
+
+	memset(prod,0,sizeof(*prod));
+	prod->ctrl_fd=-1;
+	prod->doorbell_fd=-1;
+
+	if(strlen(path)>=sizeof(addr.sun_path)) {
+		errno=ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strcpy(addr.sun_path,path);
+
+	prod->ctrl_fd=socket(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0);
+	if(prod->ctrl_fd<0) {
+		return -1;
+	}
+
+	if(connect(prod->ctrl_fd,(const struct sockaddr *) &addr,sizeof(addr))<0) {
+		goto error;
+	}
+
+	// The relayer replies with its protocol version, along with the ring memfd and the doorbell eventfd
+	memset(&msg,0,sizeof(msg));
+	iov.iov_base=&version;
+	iov.iov_len=sizeof(version);
+	msg.msg_iov=&iov;
+	msg.msg_iovlen=1;
+	msg.msg_control=ctrl;
+	msg.msg_controllen=sizeof(ctrl);
+
+	if(recvmsg(prod->ctrl_fd,&msg,MSG_CMSG_CLOEXEC)!=(ssize_t) sizeof(version)) {
+		errno=EPROTO;
+		goto error;
+	}
+
+	cmsg=CMSG_FIRSTHDR(&msg);
+	if(cmsg==NULL || cmsg->cmsg_level!=SOL_SOCKET || cmsg->cmsg_type!=SCM_RIGHTS || cmsg->cmsg_len!=CMSG_LEN(2*sizeof(int))) {
+		errno=EPROTO;
+		goto error;
+	}
+	memcpy(fds,CMSG_DATA(cmsg),sizeof(fds));
+	prod->doorbell_fd=fds[1];
+
+	if(version!=SHMRING_VERSION || fstat(fds[0],&st)<0) {
+		close(fds[0]);
+		errno=EPROTO;
+		goto error;
+	}
+
+	map=mmap(NULL,st.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,fds[0],0);
+	close(fds[0]);
+	if(map==MAP_FAILED) {
+		goto error;
+	}
+
+	prod->hdr=(shmring_hdr_t *) map;
+	prod->map_size=st.st_size;
+
+	if(prod->hdr->magic!=SHMRING_MAGIC || prod->hdr->version!=SHMRING_VERSION ||
+		(size_t) prod->hdr->data_offset+prod->hdr->data_size>prod->map_size) {
+		munmap(map,prod->map_size);
+		prod->hdr=NULL;
+		errno=EPROTO;
+		goto error;
+	}
+
+	prod->data=(uint8_t *) map+prod->hdr->data_offset;
+	prod->tail=__atomic_load_n(&prod->hdr->tail,__ATOMIC_RELAXED);
+	prod->head_cache=__atomic_load_n(&prod->hdr->head,__ATOMIC_ACQUIRE);
+
+	return 0;
+
+	error:
+	{
+		int saved_errno=errno;
+
+		if(prod->doorbell_fd>=0) {
+			close(prod->doorbell_fd);
+			prod->doorbell_fd=-1;
+		}
+		close(prod->ctrl_fd);
+		prod->ctrl_fd=-1;
+		errno=saved_errno;
+	}
+
+	return -1;
+}
+
+// Append a record to the ring, waking up the relayer only if it is waiting for new records
+// Returns 0 on success, or -1 with errno set to EAGAIN (ring full) or EMSGSIZE (record larger than max_record_size)
+static inline int shmring_producer_send(shmring_producer_t *prod, const void *buf, uint32_t len) {
+	uint64_t size=prod->hdr->data_size;
+	uint64_t pos=prod->tail & (size-1);
+	uint64_t contig=size-pos;
+	uint64_t rec_size=SHMRING_REC_SIZE(len);
+	uint64_t needed;
+
+	if(len>prod->hdr->max_record_size) {
+		errno=EMSGSIZE;
+		return -1;
+	}
+
+	// If the record does not fit before the end of the ring, the remaining space is skipped
+	needed=contig<rec_size ? contig+rec_size : rec_size;
+
+	if(prod->tail+needed-prod->head_cache>size) {
+		prod->head_cache=__atomic_load_n(&prod->hdr->head,__ATOMIC_ACQUIRE);
+
+		if(prod->tail+needed-prod->head_cache>size) {
+			errno=EAGAIN;
+			return -1;
+		}
+	}
+
+	if(contig<rec_size) {
+		uint32_t pad=SHMRING_REC_PAD;
+
+		memcpy(prod->data+pos,&pad,sizeof(pad));
+		prod->tail+=contig;
+		pos=0;
+	}
+
+	memcpy(prod->data+pos,&len,sizeof(len));
+	memcpy(prod->data+pos+4,buf,len);
+	prod->tail+=rec_size;
+
+	// Publish the record, then check (after a full barrier, pairing with the one of the consumer) if the relayer is sleeping
+	__atomic_store_n(&prod->hdr->tail,prod->tail,__ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&prod->hdr->consumer_waiting,__ATOMIC_RELAXED) &&
+		__atomic_exchange_n(&prod->hdr->consumer_waiting,0,__ATOMIC_ACQ_REL)) {
+		uint64_t one=1;
+
+		if(write(prod->doorbell_fd,&one,sizeof(one))<0) {
+			// The doorbell can only fail if the relayer is gone: the record is anyway in the ring
+		}
+	}
+
+	return 0;
+}
+
+static inline void shmring_producer_close(shmring_producer_t *prod) {
+	if(prod->hdr!=NULL) {
+		munmap(prod->hdr,prod->map_size);
+		prod->hdr=NULL;
+	}
+
+	if(prod->doorbell_fd>=0) {
+		close(prod->doorbell_fd);
+		prod->doorbell_fd=-1;
+	}
+
+	if(prod->ctrl_fd>=0) {
+		close(prod->ctrl_fd);
+		prod->ctrl_fd=-1;
+	}
+}
+
+#endif // SHMRING_H
@@ -0,0 +1,60 @@
+#ifndef SPATIAL_KEYS_H
+#define SPATIAL_KEYS_H
+
+// Spatial keys computed from a latitude/longitude pair, in addition to the quadkeys (see quadkey_morton.h)
+// This header does not depend on any other file of the relayer except quadkey_morton.h, and it can be included by C
+// (C99) and C++ consumers
+//
+// Both the geohash and the 64 bits Morton code are computed from the same quantization of the coordinates: latitude
+// and longitude are mapped (without any projection) to 32 bits unsigned integers, which are then interleaved with the
+// same kernel used for the quadkeys, in the geohash bit order (longitude in the odd bits, latitude in the even bits),
+// so that:
+// - the geohash of precision P is the base32 encoding of the highest 5*P bits of the Morton code;
+// - all the positions inside the cell of a geohash (or of any prefix of the Morton code) form a single numeric range
+//   of Morton codes.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "quadkey_morton.h"
+
+// Maximum precision (number of characters) of a geohash computed from the 64 bits Morton code
+#define SPATIAL_GEOHASH_MAX_PRECISION 12
+
+// Map a latitude (between -90 and 90) and a longitude (between -180 and 180) to 32 bits unsigned integers
+// Values out of range are clamped, and NaNs are mapped to 0
+static inline void spatial_quantize(double lat, double lon, uint32_t *q_lat, uint32_t *q_lon) {
+	double v_lat=(lat+90)*(4294967296.0/180);
+	double v_lon=(lon+180)*(4294967296.0/360);
+
+	*q_lat=v_lat>=4294967295.0 ? 0xFFFFFFFFU : (v_lat>0 ? (uint32_t) v_lat : 0);
+	*q_lon=v_lon>=4294967295.0 ? 0xFFFFFFFFU : (v_lon>0 ? (uint32_t) v_lon : 0);
+}
+
+// 64 bits Morton code of a latitude/longitude pair (geohash bit order)
+static inline uint64_t spatial_morton(double lat, double lon) {
+	uint32_t q_lat, q_lon;
+
+	spatial_quantize(lat,lon,&q_lat,&q_lon);
+
+	return quadkey_morton_encode(q_lat,q_lon);
+}
+
+// Write the geohash of precision "precision" (from 1 to SPATIAL_GEOHASH_MAX_PRECISION) corresponding to the Morton
+// code "morton" into "out" (at least precision+1 bytes long), returning the length of the '\0'-terminated string
+static inline size_t spatial_geohash(uint64_t morton, unsigned int precision, char *out) {
+	static const char base32[]="0123456789bcdefghjkmnpqrstuvwxyz";
+
+	if(precision>SPATIAL_GEOHASH_MAX_PRECISION) {
+		precision=SPATIAL_GEOHASH_MAX_PRECISION;
+	}
+
+	for(unsigned int i=0;i<precision;i++) {
+		out[i]=base32[(morton >> (59-5*i)) & 0x1F];
+	}
+	out[precision]='\0';
+
+	return precision;
+}
+
+#endif // SPATIAL_KEYS_H
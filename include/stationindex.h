@@ -0,0 +1,97 @@
+#ifndef STATIONINDEX_H
+#define STATIONINDEX_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+// Number of low Morton code bits (of the 64 bits code of spatial_keys.h) dropped in the ordered index: stations are
+// moved inside the index only when they leave their cell (about 38 m x 19 m), not at every position update
+#define STATIONINDEX_CELL_SHIFT 24
+
+// Maximum number of stations returned by a single query
+#define STATIONINDEX_MAX_RESULTS 1000
+
+// Maximum number of Morton code ranges a bounding box is decomposed into
+#define STATIONINDEX_MAX_RANGES 64
+
+// Maximum size of a query datagram
+#define STATIONINDEX_MAX_QUERY_SIZE 256
+
+typedef struct _station_entry {
+	double lat;
+	double lon;
+	uint64_t cell;                           // Morton code of the position, without the lowest STATIONINDEX_CELL_SHIFT bits
+	uint64_t ts_ns;                          // Receive timestamp of the latest position (ns since the epoch)
+	uint32_t tile_x;                         // Tile at the level of the quadkeys of the pipeline
+	uint32_t tile_y;
+} station_entry_t;
+
+// In-memory index of the latest position of each station, ordered by Morton code, answering the bounding box and
+// tile queries received on an AF_UNIX datagram socket
+// Each query is a single text datagram, and the answer (sent back to the address of the sender, which must thus be
+// bound) is a single datagram too:
+// - "box <lat_min> <lon_min> <lat_max> <lon_max>": stations inside the bounding box (in degrees, borders included)
+// - "tile <quadkey>": stations inside the tile, with the same tiles as the relayed quadkeys (the quadkey cannot be
+//   longer than the level of the quadkeys of the pipeline)
+// - "station <id>": latest position of a station
+// - "stats": number of stations and of queries
+// The answer is "ok <count>[ truncated]", followed by a "<station_id> <lat> <lon> <age_ms>" line for each station
+// (at most STATIONINDEX_MAX_RESULTS), or "error <description>"
+// Stations whose latest position is older than the maximum age are not returned, and they are removed by expire()
+class stationIndex {
+	std::unordered_map<uint32_t,station_entry_t> m_stations;
+	std::set<std::pair<uint64_t,uint32_t>> m_order; // (cell, station ID), ordered by cell
+	uint64_t m_max_age_ns;
+	int m_tile_level;
+	int m_sfd;
+	std::string m_path;
+
+	uint64_t m_updates;
+	uint64_t m_queries;
+
+	// Stations inside the bounding box (and, if tile_level>0, inside the tile tile_x, tile_y of level tile_level)
+	bool query(double lat_min, double lon_min, double lat_max, double lon_max, int tile_level, uint32_t tile_x, uint32_t tile_y,
+		uint64_t now_ns, std::vector<std::pair<uint32_t,const station_entry_t *>> &out);
+
+	public:
+		// "tile_level" is the level of the tiles passed to update()
+		stationIndex(uint64_t max_age_ms, int tile_level);
+		~stationIndex();
+
+		stationIndex(const stationIndex &) = delete;
+		stationIndex &operator=(const stationIndex &) = delete;
+
+		// Create and bind the query socket, returning false (and setting "error") in case of errors
+		bool openSocket(const std::string &path, std::string &error);
+		void closeSocket(void);
+
+		// Query socket descriptor, to be monitored for POLLIN, calling handleQuery() when it becomes readable
+		int getFd(void) {
+			return m_sfd;
+		}
+
+		// Receive and answer a query
+		void handleQuery(void);
+
+		// Answer the text query "request" (as received by handleQuery()), writing the text of the answer into "reply"
+		void answer(const char *request, std::string &reply);
+
+		void update(uint32_t station_id, double lat, double lon, uint32_t tile_x, uint32_t tile_y, uint64_t ts_ns);
+
+		// Remove the stations whose latest position is older than the maximum age
+		void expire(uint64_t now_ns);
+
+		size_t getCount(void) {
+			return m_stations.size();
+		}
+
+		uint64_t getQueries(void) {
+			return m_queries;
+		}
+};
+
+#endif // STATIONINDEX_H
@@ -0,0 +1,84 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+
+// Default number of cells stored by the tile cache
+#define TILECACHE_DEFAULT_SLOTS 4096
+
+// Cells are sized to about 1/TILECACHE_CELLS_PER_TILE of the tile width
+#define TILECACHE_CELLS_PER_TILE 16
+
+// Result of tileCache::lookup()
+typedef enum {
+	TILECACHE_HIT,                           // The tile of the cell is cached
+	TILECACHE_MISS,                          // The cell is not cached: its corners should be computed and passed to insert()
+	TILECACHE_STRADDLE                       // The cell is known to span more than one tile: the tile of the point must be computed
+} tilecache_result_t;
+
+// Direct-mapped cache of the tiles of integer coordinates (e.g., degrees*1e7, as in the ETSI messages)
+// The coordinates are truncated to a grid of square cells (2^shift units wide, with shift chosen depending on the scale
+// and on the level of detail so that each cell is a small fraction of a tile), and each slot stores the tile of one cell
+// As the tile coordinates are monotonic in latitude and longitude, all the points of a cell are inside the same tile if
+// the two opposite corners of the cell are: this is checked by insert(), while the cells spanning more than one tile
+// are stored as "straddling", so that the tile of their points is always computed directly
+class tileCache {
+	typedef struct _tilecache_entry {
+		uint64_t key;                        // Cell coordinates (0 = empty slot)
+		uint32_t tile_x;                     // TILECACHE_STRADDLING_X if the cell spans more than one tile
+		uint32_t tile_y;
+	} tilecache_entry_t;
+
+	std::vector<tilecache_entry_t> m_entries;
+	size_t m_mask;
+	int m_shift;
+	double m_scale;
+
+	uint64_t m_lookups;
+	uint64_t m_hits;
+	uint64_t m_straddles;                    // Lookups of cells spanning more than one tile
+
+	uint64_t cellKey(int32_t lat, int32_t lon);
+	tilecache_entry_t &slot(uint64_t key);
+
+	public:
+		// "scale" is the number of coordinate units per degree, "level" the level of detail of the tiles
+		// "slots" is rounded up to a power of 2
+		tileCache(double scale, int level, size_t slots = TILECACHE_DEFAULT_SLOTS);
+
+		tilecache_result_t lookup(int32_t lat, int32_t lon, uint32_t &tile_x, uint32_t &tile_y);
+
+		// Corners of the cell of (lat, lon), in degrees (i.e., already divided by the scale, in the same way as the
+		// coordinate decoders do), to be converted to tiles after a TILECACHE_MISS
+		void getCellCorners(int32_t lat, int32_t lon, double &lat_min, double &lon_min, double &lat_max, double &lon_max);
+
+		// Store the tile of the cell of (lat, lon), given the tiles of the corners (lat_min, lon_min) and (lat_max, lon_max)
+		// Returns false (storing the cell as straddling) if the two corners are not inside the same tile
+		bool insert(int32_t lat, int32_t lon, uint32_t min_tile_x, uint32_t min_tile_y, uint32_t max_tile_x, uint32_t max_tile_y);
+
+		uint64_t getLookups(void) {
+			return m_lookups;
+		}
+
+		uint64_t getHits(void) {
+			return m_hits;
+		}
+
+		uint64_t getStraddles(void) {
+			return m_straddles;
+		}
+
+		// Width of the cells, in coordinate units
+		int64_t getCellSize(void) {
+			return (int64_t) 1 << m_shift;
+		}
+
+		// Memory used by the cache, in bytes
+		size_t getMemoryUsage(void) {
+			return m_entries.size()*sizeof(tilecache_entry_t);
+		}
+};
+
+#endif // TILECACHE_H
@@ -0,0 +1,103 @@
+#ifndef TILEHEATMAP_H
+#define TILEHEATMAP_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Default number of slots of each table of the heatmap (i.e., maximum number of distinct tiles per interval, divided by 0.75)
+#define HEATMAP_DEFAULT_SLOTS 65536
+
+// First field of the binary snapshots ("THM1", as read in little endian)
+#define HEATMAP_BINARY_MAGIC 0x314D4854
+
+// Format of the heatmap snapshots
+typedef enum {
+	HEATMAP_FORMAT_CSV,                      // "interval_start_ms,interval_end_ms,quadkey,messages,bytes" rows (quadkey as a string)
+	HEATMAP_FORMAT_BINARY                    // heatmap_header_t followed by heatmap_header_t.tiles heatmap_record_t records
+} heatmap_format_t;
+
+// Parse the name of a heatmap format ("csv" or "binary"), returning false if the name is not valid
+bool parse_heatmap_format(const std::string &name, heatmap_format_t &format);
+
+// Binary snapshots are written in host byte order, without any padding
+typedef struct _heatmap_header {
+	uint32_t magic;                          // HEATMAP_BINARY_MAGIC
+	uint32_t level;                          // Level of the tiles
+	uint64_t start_ns;                       // Interval start and end (ns since the epoch)
+	uint64_t end_ns;
+	uint64_t tiles;                          // Number of records following the header
+	uint64_t untracked_messages;             // Messages not counted in any tile, as the table was full
+	uint64_t untracked_bytes;
+} heatmap_header_t;
+
+typedef struct _heatmap_record {
+	uint64_t quadkey;                        // Binary quadkey (see quadkey_morton.h), 0 for the empty slots of the tables
+	uint64_t messages;
+	uint64_t bytes;
+} heatmap_record_t;
+
+// Per-tile message and byte counters, accumulated over fixed intervals (the relayer counts the received packets with a
+// valid position, i.e., the offered load, not only the messages eventually handed to the AMQP connections)
+// The counters are stored in two open-addressing tables: the active one is updated by add(), while rotate(), at the
+// end of each interval, swaps the two tables (so that the counting of the next interval starts immediately with an
+// empty table), writes a snapshot of the table of the interval just ended, sorted by quadkey, and empties it
+class tileHeatmap {
+	typedef struct _heatmap_table {
+		std::vector<heatmap_record_t> slots;
+		size_t used;
+		uint64_t untracked_messages;
+		uint64_t untracked_bytes;
+		uint64_t start_ns;
+	} heatmap_table_t;
+
+	heatmap_table_t m_tables[2];
+	heatmap_table_t *m_active;
+	heatmap_table_t *m_standby;
+	size_t m_mask;
+	size_t m_max_used;                       // Maximum number of tiles per table (to keep the probe sequences short)
+	unsigned int m_level;
+	unsigned int m_shift;                    // Difference between the level of the tiles passed to add() and m_level
+
+	uint64_t m_snapshots;
+
+	bool writeCSV(const heatmap_table_t &table, const std::vector<heatmap_record_t> &records, uint64_t end_ns, const std::string &path);
+	bool writeBinary(const heatmap_table_t &table, const std::vector<heatmap_record_t> &records, uint64_t end_ns, const std::string &path);
+
+	public:
+		// "level" is the level of the tiles of the heatmap, and "tile_level" (not smaller than "level") the level of the
+		// tiles passed to add(); "slots" is rounded up to a power of 2
+		tileHeatmap(unsigned int level, unsigned int tile_level, uint64_t start_ns, size_t slots = HEATMAP_DEFAULT_SLOTS);
+
+		// Count a message of "bytes" bytes inside the tile (tile_x, tile_y) of level "tile_level"
+		void add(uint32_t tile_x, uint32_t tile_y, size_t bytes);
+
+		// End the current interval at "now_ns", and write its snapshot to "path" (replaced atomically)
+		// Returns false (and sets "error") if the snapshot cannot be written
+		bool rotate(uint64_t now_ns, const std::string &path, heatmap_format_t format, std::string &error);
+
+		// Number of tiles counted in the current interval
+		size_t getTiles(void) {
+			return m_active->used;
+		}
+
+		uint64_t getUntracked(void) {
+			return m_active->untracked_messages;
+		}
+
+		uint64_t getSnapshots(void) {
+			return m_snapshots;
+		}
+
+		unsigned int getLevel(void) {
+			return m_level;
+		}
+
+		// Memory used by the two tables, in bytes
+		size_t getMemoryUsage(void) {
+			return 2*m_tables[0].slots.size()*sizeof(heatmap_record_t);
+		}
+};
+
+#endif // TILEHEATMAP_H
@@ -20,12 +20,19 @@
 class Timer {
 	public:
 		Timer(uint64_t time_ms):
-			m_time_ms(time_ms) {};
+			m_clock_fd(-1), m_time_ms(time_ms) {};
+		~Timer();
 
 		bool start();
 		bool stop();
 		bool rearm(uint64_t time_ms);
 		bool waitForExpiration();
+
+		// Timer descriptor, which can be monitored (for POLLIN) by an external event loop, calling waitForExpiration()
+		// (which then does not block) when it becomes readable
+		int getFd() {
+			return m_clock_fd;
+		}
 	private:
 		struct pollfd m_timerMon;
 		int m_clock_fd;
@@ -0,0 +1,163 @@
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+#include <fstream>
+
+#include "adaptivelod.h"
+#include "quadkey_morton.h"
+#include "hashtable.h"
+
+#define SKETCH_WIDTH (1U << ADAPTIVELOD_SKETCH_WIDTH_BITS)
+#define SKETCH_MASK (SKETCH_WIDTH-1)
+
+// Binary quadkey of the "child"-th (0 to 3, i.e., the last digit of its quadkey) child of the tile "qk"
+static inline uint64_t child_tile(uint64_t qk, unsigned int child) {
+	return ((((quadkey_ulong_morton(qk) << 2) | child)) << QUADKEY_LEVEL_BITS) | (quadkey_ulong_level(qk)+1);
+}
+
+adaptiveLod::adaptiveLod(unsigned int min_level, unsigned int max_level, double split_rate, int interval_ms) :
+	m_min_level(min_level), m_max_level(max_level), m_splits(0), m_merges(0), m_refused(0) {
+	double split_count=split_rate*interval_ms/1000.0;
+
+	m_sketch.assign(ADAPTIVELOD_SKETCH_DEPTH*SKETCH_WIDTH,0);
+
+	m_split_count=split_count>=1 ? (split_count<UINT32_MAX ? (uint32_t) split_count : UINT32_MAX) : 1;
+	m_merge_count=m_split_count/ADAPTIVELOD_MERGE_FACTOR;
+}
+
+// Each row of the sketch uses a different slice of the 64 bits hash
+uint32_t adaptiveLod::count(uint64_t qk) {
+	uint64_t h=hash_mix64(qk);
+	uint32_t min=UINT32_MAX;
+
+	for(int row=0;row<ADAPTIVELOD_SKETCH_DEPTH;row++) {
+		uint32_t &counter=m_sketch[row*SKETCH_WIDTH+((h >> (row*ADAPTIVELOD_SKETCH_WIDTH_BITS)) & SKETCH_MASK)];
+
+		if(counter<UINT32_MAX) {
+			counter++;
+		}
+		min=std::min(min,counter);
+	}
+
+	return min;
+}
+
+uint32_t adaptiveLod::estimate(uint64_t qk) {
+	uint64_t h=hash_mix64(qk);
+	uint32_t min=UINT32_MAX;
+
+	for(int row=0;row<ADAPTIVELOD_SKETCH_DEPTH;row++) {
+		min=std::min(min,m_sketch[row*SKETCH_WIDTH+((h >> (row*ADAPTIVELOD_SKETCH_WIDTH_BITS)) & SKETCH_MASK)]);
+	}
+
+	return min;
+}
+
+unsigned int adaptiveLod::classify(uint32_t tile_x, uint32_t tile_y) {
+	unsigned int level=m_min_level;
+	uint64_t qk=quadkey_ulong_encode(tile_x >> (m_max_level-level),tile_y >> (m_max_level-level),level);
+
+	// Descend the quadtree until a tile which is not split (no lookup at all while nothing is split)
+	while(!m_split.empty() && level<m_max_level && m_split.count(qk)>0) {
+		level++;
+		qk=quadkey_ulong_encode(tile_x >> (m_max_level-level),tile_y >> (m_max_level-level),level);
+	}
+
+	// The estimate can skip the threshold (the messages of colliding tiles increment the same counters), so any tile at
+	// or above it is queued, once per interval
+	if(count(qk)>=m_split_count && level<m_max_level) {
+		m_pending.insert(qk);
+	}
+
+	return level;
+}
+
+bool adaptiveLod::rebalance(void) {
+	std::vector<uint64_t> merges;
+
+	// The children of a tile which has just been split are all leaves, but they are merged back only after a whole
+	// interval, as their parent exceeded the split threshold (which is larger than the merge one) in this interval
+	for(uint64_t qk : m_split) {
+		uint64_t total=0;
+		bool leaves=true;
+
+		for(unsigned int child=0;child<4 && leaves;child++) {
+			uint64_t child_qk=child_tile(qk,child);
+
+			leaves=m_split.count(child_qk)==0;
+			total+=estimate(child_qk);
+		}
+
+		if(leaves && total<m_merge_count) {
+			merges.push_back(qk);
+		}
+	}
+
+	for(uint64_t qk : merges) {
+		m_split.erase(qk);
+	}
+	m_merges+=merges.size();
+
+	bool changed=!merges.empty();
+
+	for(uint64_t qk : m_pending) {
+		if(m_split.size()>=ADAPTIVELOD_MAX_SPLITS) {
+			m_refused++;
+		} else if(m_split.insert(qk).second) {
+			m_splits++;
+			changed=true;
+		}
+	}
+
+	m_pending.clear();
+	std::fill(m_sketch.begin(),m_sketch.end(),0);
+
+	return changed;
+}
+
+bool adaptiveLod::writeMap(const std::string &path, std::string &error) {
+	std::vector<std::string> tiles;
+	char qk_str[QUADKEY_MAX_LEVEL+1];
+	std::string tmp_path=path + ".tmp";
+
+	// Leaves of the quadtree below the minimum level: the children of the split tiles which are not split themselves
+	for(uint64_t qk : m_split) {
+		for(unsigned int child=0;child<4;child++) {
+			uint64_t child_qk=child_tile(qk,child);
+
+			if(m_split.count(child_qk)==0) {
+				tiles.push_back(std::string(qk_str,quadkey_ulong_to_string(child_qk,qk_str)));
+			}
+		}
+	}
+	std::sort(tiles.begin(),tiles.end());
+
+	std::ofstream map_file(tmp_path,std::ios::out | std::ios::trunc);
+
+	if(!map_file.is_open()) {
+		error="cannot open " + tmp_path + ": " + strerror(errno);
+		return false;
+	}
+
+	map_file << "# Adaptive quadkey partition: tiles of level " << m_min_level << ", except the following ones (from level " <<
+		m_min_level+1 << " to " << m_max_level << ")" << std::endl;
+	map_file << "# Split above " << m_split_count << " messages per interval, merged below " << m_merge_count << std::endl;
+	for(const std::string &tile : tiles) {
+		map_file << tile << "\n";
+	}
+	map_file.close();
+
+	if(map_file.fail()) {
+		error="cannot write " + tmp_path;
+		return false;
+	}
+
+	// Readers always see either the previous or the new partition
+	if(rename(tmp_path.c_str(),path.c_str())<0) {
+		error="cannot rename " + tmp_path + " to " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	return true;
+}
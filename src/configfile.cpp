@@ -0,0 +1,296 @@
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+
+#include "configfile.h"
+
+static std::string trim(const std::string &str) {
+	size_t first=str.find_first_not_of(" \t\r");
+
+	if(first==std::string::npos) {
+		return "";
+	}
+
+	return str.substr(first,str.find_last_not_of(" \t\r")-first+1);
+}
+
+static bool parse_bool(const std::string &value, bool &out) {
+	if(value=="true" || value=="yes" || value=="on" || value=="1") {
+		out=true;
+	} else if(value=="false" || value=="no" || value=="off" || value=="0") {
+		out=false;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool parse_long(const std::string &value, long &out) {
+	char *endptr;
+
+	errno=0;
+	out=strtol(value.c_str(),&endptr,10);
+
+	return errno==0 && !value.empty() && *endptr=='\0';
+}
+
+static bool parse_int(const std::string &value, int &out) {
+	long lvalue;
+
+	if(!parse_long(value,lvalue) || lvalue<INT_MIN || lvalue>INT_MAX) {
+		return false;
+	}
+
+	out=(int) lvalue;
+
+	return true;
+}
+
+static bool parse_double(const std::string &value, double &out) {
+	char *endptr;
+
+	errno=0;
+	out=strtod(value.c_str(),&endptr);
+
+	return errno==0 && !value.empty() && *endptr=='\0';
+}
+
+// Set a single pipeline option, given its key (i.e., the long command line option name) and value
+// Returns false if the key is unknown or if the value is not valid
+static bool set_pipeline_option(pipeline_opts_t &opts, const std::string &key, const std::string &value) {
+	if(key=="url") {
+		opts.amqp_args.m_broker_address=value;
+	} else if(key=="queue") {
+		opts.amqp_args.m_queue_name=value;
+	} else if(key=="listen-port") {
+		return parse_int(value,opts.listen_port) && opts.listen_port>=0 && opts.listen_port<=65535;
+	} else if(key=="bindto") {
+		opts.bind_ip=value;
+	} else if(key=="listen") {
+		listen_endpoint_t endpoint;
+		std::string error;
+
+		if(!parse_listen_endpoint(value,endpoint,error)) {
+			return false;
+		}
+		opts.listen_endpoints.push_back(endpoint);
+	} else if(key=="min-msg-size") {
+		return parse_int(value,opts.minimum_msg_size);
+	} else if(key=="max-msg-size") {
+		return parse_int(value,opts.max_msg_size) && opts.max_msg_size>0 && opts.max_msg_size<=RX_MAX_UDP_PAYLOAD;
+	} else if(key=="drop-truncated") {
+		return parse_bool(value,opts.drop_truncated);
+	} else if(key=="udp-gro") {
+		return parse_bool(value,opts.udp_gro);
+	} else if(key=="enable-quadkeys") {
+		return parse_bool(value,opts.quadk_enable);
+	} else if(key=="quadkeys-level") {
+		return parse_int(value,opts.quadk_level) && opts.quadk_level>=14 && opts.quadk_level<=18;
+	} else if(key=="quadkey-format") {
+		return parse_quadkey_format(value,opts.quadk_format);
+	} else if(key=="spatial-keys") {
+		return parse_spatial_keys(value,opts.spatial_keys);
+	} else if(key=="geohash-precision") {
+		return parse_int(value,opts.geohash_precision) && opts.geohash_precision>=1 && opts.geohash_precision<=SPATIAL_GEOHASH_MAX_PRECISION;
+	} else if(key=="quadkey-neighbors") {
+		return parse_int(value,opts.quadk_nbr_level) && opts.quadk_nbr_level>=0 && opts.quadk_nbr_level<=QUADKEY_MAX_LEVEL;
+	} else if(key=="station-index") {
+		opts.station_index_path=value;
+	} else if(key=="station-max-age") {
+		return parse_int(value,opts.station_max_age_ms) && opts.station_max_age_ms>0;
+	} else if(key=="adaptive-lod") {
+		return parse_int(value,opts.adaptive_lod_min_level) && opts.adaptive_lod_min_level>=0 && opts.adaptive_lod_min_level<=QUADKEY_MAX_LEVEL;
+	} else if(key=="adaptive-lod-rate") {
+		return parse_double(value,opts.adaptive_lod_split_rate) && opts.adaptive_lod_split_rate>0;
+	} else if(key=="adaptive-lod-interval") {
+		return parse_int(value,opts.adaptive_lod_interval_ms) && opts.adaptive_lod_interval_ms>0;
+	} else if(key=="adaptive-lod-map") {
+		opts.adaptive_lod_map_path=value;
+	} else if(key=="heatmap") {
+		opts.heatmap_path=value;
+	} else if(key=="heatmap-level") {
+		return parse_int(value,opts.heatmap_level) && opts.heatmap_level>=0 && opts.heatmap_level<=QUADKEY_MAX_LEVEL;
+	} else if(key=="heatmap-interval") {
+		return parse_int(value,opts.heatmap_interval_ms) && opts.heatmap_interval_ms>0;
+	} else if(key=="heatmap-format") {
+		return parse_heatmap_format(value,opts.heatmap_format);
+	} else if(key=="heatmap-slots") {
+		return parse_int(value,opts.heatmap_slots) && opts.heatmap_slots>0 && opts.heatmap_slots<=(1<<24);
+	} else if(key=="quadkey-cache") {
+		return parse_int(value,opts.quadk_cache_slots) && opts.quadk_cache_slots>=0 && opts.quadk_cache_slots<=(1<<24);
+	} else if(key=="coord-format") {
+		return coord_parse_format_name(value,opts.coord_format);
+	} else if(key=="coord-offset") {
+		long offset;
+
+		if(!parse_long(value,offset) || offset<0 || offset>RX_MAX_UDP_PAYLOAD) {
+			return false;
+		}
+		opts.coord_format.offset=offset;
+	} else if(key=="coord-scale") {
+		return parse_double(value,opts.coord_format.scale) && opts.coord_format.scale>=0;
+	} else if(key=="coord-keep") {
+		bool keep;
+
+		if(!parse_bool(value,keep)) {
+			return false;
+		}
+		opts.coord_format.strip=!keep;
+	} else if(key=="coord-invalid") {
+		return parse_coord_invalid_policy(value,opts.coord_invalid);
+	} else if(key=="coord-dead-letter-queue") {
+		opts.coord_dead_letter_queue=value;
+	} else if(key=="conflate-interval") {
+		return parse_int(value,opts.conflate_interval_ms) && opts.conflate_interval_ms>=0;
+	} else if(key=="conflate-key") {
+		return parse_conflation_key_mode(value,opts.conflate_key);
+	} else if(key=="conflate-slots") {
+		return parse_int(value,opts.conflate_slots) && opts.conflate_slots>0 && opts.conflate_slots<=(1<<24);
+	} else if(key=="dedup-window") {
+		return parse_int(value,opts.dedup_window_ms) && opts.dedup_window_ms>=0;
+	} else if(key=="dedup-slots") {
+		return parse_int(value,opts.dedup_slots) && opts.dedup_slots>0 && opts.dedup_slots<=(1<<24);
+	} else if(key=="rate-limit") {
+		return parse_double(value,opts.rate_limit) && opts.rate_limit>=0;
+	} else if(key=="rate-burst") {
+		return parse_double(value,opts.rate_burst) && opts.rate_burst>=0;
+	} else if(key=="rate-key") {
+		return parse_ratelimit_key_mode(value,opts.rate_key);
+	} else if(key=="rate-slots") {
+		return parse_int(value,opts.rate_slots) && opts.rate_slots>0 && opts.rate_slots<=(1<<24);
+	} else if(key=="shed-watermark") {
+		return parse_long(value,opts.shed_watermark) && opts.shed_watermark>=0;
+	} else if(key=="priority-lanes") {
+		return parse_int(value,opts.priority_lanes) && opts.priority_lanes>=1 && opts.priority_lanes<=LANES_MAX;
+	} else if(key=="lane-weights") {
+		return parse_lane_weights(value,opts.lane_weights);
+	} else if(key=="lane-queue-size") {
+		return parse_int(value,opts.lane_queue_size) && opts.lane_queue_size>0;
+	} else if(key=="lane-rule") {
+		lane_rule_t rule;
+		std::string error;
+
+		if(!parse_lane_rule(value,rule,error)) {
+			return false;
+		}
+		opts.lane_rules.push_back(rule);
+	} else if(key=="source-properties") {
+		return parse_src_props_mode(value,opts.src_props);
+	} else if(key=="amqp-username") {
+		opts.amqp_username=value;
+	} else if(key=="amqp-password") {
+		opts.amqp_password=value;
+	} else if(key=="amqp-reconnect") {
+		return parse_bool(value,opts.amqp_reconnect);
+	} else if(key=="amqp-sasl-auth") {
+		return parse_bool(value,opts.amqp_allow_sasl);
+	} else if(key=="amqp-plain-auth") {
+		return parse_bool(value,opts.amqp_allow_plain);
+	} else if(key=="amqp-idle-timeout") {
+		return parse_long(value,opts.amqp_idle_timeout_ms);
+	} else if(key=="amqp-connections") {
+		return parse_int(value,opts.amqp_connections) && opts.amqp_connections>=1;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool parse_config_file(const std::string &filename, const pipeline_opts_t &defaults, std::vector<pipeline_opts_t> &pipelines, config_global_opts_t &global_opts) {
+	std::ifstream cfgfile(filename);
+	std::string line;
+	int line_num=0;
+
+	// Options applied to all the pipelines (i.e., the command line options, plus the keys specified before the first pipeline)
+	pipeline_opts_t common_opts=defaults;
+	// Pipeline currently being parsed (NULL when parsing the common options)
+	pipeline_opts_t *curr_opts=NULL;
+	// = true after the first "listen" key of the current pipeline (which replaces the endpoints inherited from the common options)
+	bool curr_listen_set=false;
+	// = true after the first "lane-rule" key of the current pipeline (which replaces the rules inherited from the common options)
+	bool curr_lane_rules_set=false;
+
+	if(!cfgfile.is_open()) {
+		std::cerr << "Error: cannot open the configuration file " << filename << "." << std::endl;
+		return false;
+	}
+
+	pipelines.clear();
+
+	while(std::getline(cfgfile,line)) {
+		line_num++;
+		line=trim(line);
+
+		// Skip empty lines and comments
+		if(line.empty() || line[0]=='#' || line[0]==';') {
+			continue;
+		}
+
+		// New pipeline definition
+		if(line[0]=='[') {
+			if(line.back()!=']' || trim(line.substr(1,line.size()-2)).empty()) {
+				std::cerr << "Error in " << filename << ", line " << line_num << ": invalid pipeline name." << std::endl;
+				return false;
+			}
+
+			pipelines.push_back(common_opts);
+			curr_opts=&pipelines.back();
+			curr_opts->name=trim(line.substr(1,line.size()-2));
+			curr_listen_set=false;
+			curr_lane_rules_set=false;
+
+			continue;
+		}
+
+		size_t eq_pos=line.find('=');
+
+		if(eq_pos==std::string::npos) {
+			std::cerr << "Error in " << filename << ", line " << line_num << ": expected 'key = value'." << std::endl;
+			return false;
+		}
+
+		std::string key=trim(line.substr(0,eq_pos));
+		std::string value=trim(line.substr(eq_pos+1));
+
+		// Multiple "listen" keys are allowed, to listen on several endpoints
+		if(key=="listen" && curr_opts!=NULL && curr_listen_set==false) {
+			curr_opts->listen_endpoints.clear();
+			curr_listen_set=true;
+		}
+
+		// The same applies to "lane-rule" keys
+		if(key=="lane-rule" && curr_opts!=NULL && curr_lane_rules_set==false) {
+			curr_opts->lane_rules.clear();
+			curr_lane_rules_set=true;
+		}
+
+		// Global options can only be specified before the first pipeline definition
+		if(key=="amqp-threads" && curr_opts==NULL) {
+			if(!parse_int(value,global_opts.amqp_threads) || global_opts.amqp_threads<0) {
+				std::cerr << "Error in " << filename << ", line " << line_num << ": invalid number of AMQP threads." << std::endl;
+				return false;
+			}
+		} else if(!set_pipeline_option(curr_opts!=NULL ? *curr_opts : common_opts,key,value)) {
+			std::cerr << "Error in " << filename << ", line " << line_num << ": invalid option '" << key << "' or invalid value '" << value << "'." << std::endl;
+			return false;
+		}
+	}
+
+	if(pipelines.empty()) {
+		std::cerr << "Error: no pipeline has been defined in " << filename << "." << std::endl;
+		return false;
+	}
+
+	for(const pipeline_opts_t &opts : pipelines) {
+		if(opts.amqp_args.m_broker_address.empty() || opts.amqp_args.m_queue_name.empty()) {
+			std::cerr << "Error in " << filename << ": pipeline " << opts.name << " must specify both a broker URL and a queue." << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,98 @@
+#include <cstring>
+#include <utility>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+#include "conflation.h"
+
+bool parse_conflation_key_mode(const std::string &name, conflation_key_mode_t &mode) {
+	if(name=="station") {
+		mode=CONFLATE_BY_STATION;
+	} else if(name=="source") {
+		mode=CONFLATE_BY_SOURCE;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+void conflation_key_station(uint32_t station_id, uint8_t message_id, conflation_key_t &key) {
+	key.hi=station_id;
+	key.lo=message_id;
+	// Never used by source keys
+	key.extra=UINT32_MAX;
+}
+
+void conflation_key_source(const struct sockaddr_storage &src_addr, conflation_key_t &key) {
+	key.hi=0;
+	key.lo=0;
+	key.extra=(uint32_t) src_addr.ss_family << 16;
+
+	if(src_addr.ss_family==AF_INET) {
+		const struct sockaddr_in *sa=(const struct sockaddr_in *) &src_addr;
+
+		key.lo=sa->sin_addr.s_addr;
+		key.extra|=sa->sin_port;
+	} else if(src_addr.ss_family==AF_INET6) {
+		const struct sockaddr_in6 *sa6=(const struct sockaddr_in6 *) &src_addr;
+
+		memcpy(&key.hi,&sa6->sin6_addr.s6_addr[0],sizeof(key.hi));
+		memcpy(&key.lo,&sa6->sin6_addr.s6_addr[8],sizeof(key.lo));
+		key.extra|=sa6->sin6_port;
+	} else if(src_addr.ss_family==AF_UNIX) {
+		// Local sources are identified by a 64 bits FNV-1a hash of their path
+		const char *path=((const struct sockaddr_un *) &src_addr)->sun_path;
+		uint64_t hash=14695981039346656037ULL;
+
+		for(size_t i=0;i<sizeof(((const struct sockaddr_un *) &src_addr)->sun_path) && path[i]!='\0';i++) {
+			hash=(hash^(uint8_t) path[i])*1099511628211ULL;
+		}
+		key.lo=hash;
+	}
+}
+
+conflationTable::conflationTable(size_t slots) {
+	size_t size=hashtable_size(slots);
+
+	m_slots.resize(size);
+	for(conflation_slot_t &slot : m_slots) {
+		slot.used=false;
+	}
+
+	m_mask=size-1;
+	m_max_used=hashtable_max_used(size);
+	m_used.reserve(m_max_used);
+}
+
+int conflationTable::store(const conflation_key_t &key, proton::message &msg, size_t conn_idx, int sender_idx, int lane) {
+	size_t idx=conflation_key_hash(key) & m_mask;
+
+	while(m_slots[idx].used) {
+		if(conflation_key_equal(m_slots[idx].key,key)) {
+			// Newer message for the same key: replace the old one
+			m_slots[idx].msg=std::move(msg);
+			m_slots[idx].conn_idx=conn_idx;
+			m_slots[idx].sender_idx=sender_idx;
+			m_slots[idx].lane=lane;
+
+			return 1;
+		}
+
+		idx=(idx+1) & m_mask;
+	}
+
+	if(m_used.size()>=m_max_used) {
+		return -1;
+	}
+
+	m_slots[idx].used=true;
+	m_slots[idx].key=key;
+	m_slots[idx].msg=std::move(msg);
+	m_slots[idx].conn_idx=conn_idx;
+	m_slots[idx].sender_idx=sender_idx;
+	m_slots[idx].lane=lane;
+	m_used.push_back(idx);
+
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include <cstring>
+
+#include "dedup.h"
+#include "xxhash64.h"
+#include "hashtable.h"
+
+dedupFilter::dedupFilter(size_t slots) :
+	m_current(0), m_lookups(0), m_hits(0), m_full(0) {
+	m_slots=hashtable_size(slots);
+	m_mask=m_slots-1;
+	// The load factor is limited in each generation
+	m_max_used=hashtable_max_used(m_slots);
+	m_tables.assign(DEDUP_GENERATIONS*m_slots,0);
+	memset(m_used,0,sizeof(m_used));
+}
+
+bool dedupFilter::isDuplicate(const uint8_t *payload, size_t len) {
+	uint64_t hash=xxh64(payload,len,0);
+	size_t home;
+
+	// 0 marks the empty slots
+	if(hash==0) {
+		hash=1;
+	}
+
+	home=hash & m_mask;
+	m_lookups++;
+
+	for(int gen=0;gen<DEDUP_GENERATIONS;gen++) {
+		const uint64_t *table=&m_tables[gen*m_slots];
+
+		for(size_t idx=home;table[idx]!=0;idx=(idx+1) & m_mask) {
+			if(table[idx]==hash) {
+				m_hits++;
+				return true;
+			}
+		}
+	}
+
+	// New payload: insert it into the current generation (or just relay it, if the generation is full)
+	if(m_used[m_current]>=m_max_used) {
+		m_full++;
+		return false;
+	}
+
+	uint64_t *table=&m_tables[m_current*m_slots];
+	size_t idx=home;
+
+	while(table[idx]!=0) {
+		idx=(idx+1) & m_mask;
+	}
+	table[idx]=hash;
+	m_used[m_current]++;
+
+	return false;
+}
+
+void dedupFilter::rotate(void) {
+	m_current=(m_current+1) % DEDUP_GENERATIONS;
+
+	memset(&m_tables[m_current*m_slots],0,m_slots*sizeof(uint64_t));
+	m_used[m_current]=0;
+}
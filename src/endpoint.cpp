@@ -0,0 +1,336 @@
+#include <errno.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+#include "endpoint.h"
+#include "shmingest.h"
+
+static bool parse_port(const std::string &port_str, in_port_t &port) {
+	char *endptr;
+	long port_num;
+
+	errno=0;
+	port_num=strtol(port_str.c_str(),&endptr,10);
+
+	if(errno!=0 || port_str.empty() || *endptr!='\0' || port_num<0 || port_num>65535) {
+		return false;
+	}
+
+	port=htons((uint16_t) port_num);
+
+	return true;
+}
+
+// Fill the address of "endpoint" given an address string (IPv4, IPv6 without brackets, or "*") and a port string
+static bool set_endpoint_address(const std::string &addr_str, const std::string &port_str, listen_endpoint_t &endpoint, std::string &error) {
+	in_port_t port;
+
+	if(!parse_port(port_str,port)) {
+		error="invalid port '"+port_str+"'";
+		return false;
+	}
+
+	memset(&endpoint.addr,0,sizeof(endpoint.addr));
+
+	if(addr_str=="*") {
+		struct sockaddr_in6 *addr6=(struct sockaddr_in6 *) &endpoint.addr;
+
+		addr6->sin6_family=AF_INET6;
+		addr6->sin6_addr=in6addr_any;
+		addr6->sin6_port=port;
+		endpoint.addrlen=sizeof(struct sockaddr_in6);
+	} else if(addr_str.find(':')!=std::string::npos) {
+		struct sockaddr_in6 *addr6=(struct sockaddr_in6 *) &endpoint.addr;
+
+		addr6->sin6_family=AF_INET6;
+		addr6->sin6_port=port;
+		if(inet_pton(AF_INET6,addr_str.c_str(),&addr6->sin6_addr)<1) {
+			error="invalid IPv6 address '"+addr_str+"'";
+			return false;
+		}
+		endpoint.addrlen=sizeof(struct sockaddr_in6);
+	} else {
+		struct sockaddr_in *addr4=(struct sockaddr_in *) &endpoint.addr;
+
+		addr4->sin_family=AF_INET;
+		addr4->sin_port=port;
+		if(inet_pton(AF_INET,addr_str.c_str(),&addr4->sin_addr)<1) {
+			error="invalid IPv4 address '"+addr_str+"'";
+			return false;
+		}
+		endpoint.addrlen=sizeof(struct sockaddr_in);
+	}
+
+	return true;
+}
+
+bool parse_listen_endpoint(const std::string &spec, listen_endpoint_t &endpoint, std::string &error) {
+	size_t opts_pos=spec.find(',');
+	std::string addrport=spec.substr(0,opts_pos);
+	std::string addr_str, port_str;
+
+	endpoint.spec=spec;
+	endpoint.type=LISTEN_UDP;
+	endpoint.path="";
+	endpoint.ring_size=SHM_RING_DEFAULT_SIZE;
+	endpoint.device="";
+	endpoint.v6only=false;
+	endpoint.queue="";
+	endpoint.tag="";
+	endpoint.mcast_ifaces.clear();
+
+	// Local endpoints: "unix:<path>" and "shm:<path>"
+	if(addrport.compare(0,5,"unix:")==0 || addrport.compare(0,4,"shm:")==0) {
+		struct sockaddr_un *addr_un=(struct sockaddr_un *) &endpoint.addr;
+
+		endpoint.type=addrport[0]=='u' ? LISTEN_UNIX_DGRAM : LISTEN_SHM_RING;
+		endpoint.path=addrport.substr(addrport.find(':')+1);
+
+		if(endpoint.path.empty() || endpoint.path.size()>=sizeof(addr_un->sun_path)) {
+			error="invalid socket path in '"+addrport+"'";
+			return false;
+		}
+
+		memset(&endpoint.addr,0,sizeof(endpoint.addr));
+		addr_un->sun_family=AF_UNIX;
+		memcpy(addr_un->sun_path,endpoint.path.c_str(),endpoint.path.size());
+		endpoint.addrlen=sizeof(struct sockaddr_un);
+	// Split "<address>:<port>", where an IPv6 address must be enclosed in square brackets
+	} else if(!addrport.empty() && addrport[0]=='[') {
+		size_t close_pos=addrport.find(']');
+
+		if(close_pos==std::string::npos || close_pos+1>=addrport.size() || addrport[close_pos+1]!=':') {
+			error="invalid endpoint '"+addrport+"' (expected [<IPv6 address>]:<port>)";
+			return false;
+		}
+
+		addr_str=addrport.substr(1,close_pos-1);
+		port_str=addrport.substr(close_pos+2);
+	} else {
+		size_t colon_pos=addrport.rfind(':');
+
+		if(colon_pos==std::string::npos) {
+			error="invalid endpoint '"+addrport+"' (expected <address>:<port>)";
+			return false;
+		}
+
+		addr_str=addrport.substr(0,colon_pos);
+		port_str=addrport.substr(colon_pos+1);
+	}
+
+	if(endpoint.type==LISTEN_UDP && !set_endpoint_address(addr_str,port_str,endpoint,error)) {
+		return false;
+	}
+
+	// Parse the endpoint options
+	while(opts_pos!=std::string::npos) {
+		size_t next_pos=spec.find(',',opts_pos+1);
+		std::string option=spec.substr(opts_pos+1,next_pos==std::string::npos ? std::string::npos : next_pos-opts_pos-1);
+		size_t eq_pos=option.find('=');
+		std::string key=option.substr(0,eq_pos);
+		std::string value=eq_pos==std::string::npos ? "" : option.substr(eq_pos+1);
+
+		if(key=="v6only" && eq_pos==std::string::npos) {
+			endpoint.v6only=true;
+		} else if(key=="dev" && !value.empty()) {
+			endpoint.device=value;
+		} else if(key=="queue" && !value.empty()) {
+			endpoint.queue=value;
+		} else if(key=="tag" && !value.empty()) {
+			endpoint.tag=value;
+		} else if(key=="mcast-if" && !value.empty()) {
+			endpoint.mcast_ifaces.push_back(value);
+		} else if(key=="ring-size" && endpoint.type==LISTEN_SHM_RING && !value.empty()) {
+			char *endptr;
+			unsigned long long ring_size=strtoull(value.c_str(),&endptr,10);
+
+			if(*endptr!='\0' || ring_size==0 || ring_size>(1ULL<<30)) {
+				error="invalid ring size '"+value+"' (up to 1 GiB)";
+				return false;
+			}
+			endpoint.ring_size=ring_size;
+		} else {
+			error="invalid endpoint option '"+option+"'";
+			return false;
+		}
+
+		opts_pos=next_pos;
+	}
+
+	if(endpoint.type!=LISTEN_UDP && (endpoint.v6only || !endpoint.device.empty())) {
+		error="'v6only' and 'dev' can only be specified for UDP endpoints";
+		return false;
+	}
+
+	if(!endpoint.mcast_ifaces.empty() && !is_multicast_endpoint(endpoint)) {
+		error="'mcast-if' can only be specified for multicast group endpoints";
+		return false;
+	}
+
+	// Link-local IPv6 multicast groups need a scope, i.e., the interface they are joined on
+	if(endpoint.addr.ss_family==AF_INET6 && IN6_IS_ADDR_MC_LINKLOCAL(&((struct sockaddr_in6 *) &endpoint.addr)->sin6_addr)) {
+		if(endpoint.mcast_ifaces.size()!=1) {
+			error="exactly one 'mcast-if' must be specified for link-local IPv6 multicast groups";
+			return false;
+		}
+
+		((struct sockaddr_in6 *) &endpoint.addr)->sin6_scope_id=if_nametoindex(endpoint.mcast_ifaces[0].c_str());
+	}
+
+	return true;
+}
+
+bool is_multicast_endpoint(const listen_endpoint_t &endpoint) {
+	if(endpoint.addr.ss_family==AF_INET) {
+		return IN_MULTICAST(ntohl(((const struct sockaddr_in *) &endpoint.addr)->sin_addr.s_addr));
+	} else if(endpoint.addr.ss_family==AF_INET6) {
+		return IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6 *) &endpoint.addr)->sin6_addr);
+	}
+
+	return false;
+}
+
+// Join the multicast group of "endpoint" on the interface with index "ifindex" (0 to let the kernel choose the interface)
+static bool join_multicast_group(int sfd, const listen_endpoint_t &endpoint, unsigned int ifindex, std::string &error) {
+	if(endpoint.addr.ss_family==AF_INET) {
+		struct ip_mreqn mreq;
+
+		memset(&mreq,0,sizeof(mreq));
+		mreq.imr_multiaddr=((const struct sockaddr_in *) &endpoint.addr)->sin_addr;
+		mreq.imr_address.s_addr=htonl(INADDR_ANY);
+		mreq.imr_ifindex=ifindex;
+
+		if(setsockopt(sfd,IPPROTO_IP,IP_ADD_MEMBERSHIP,&mreq,sizeof(mreq))<0) {
+			error="cannot join the IPv4 multicast group: "+std::string(strerror(errno));
+			return false;
+		}
+	} else {
+		struct ipv6_mreq mreq6;
+
+		memset(&mreq6,0,sizeof(mreq6));
+		mreq6.ipv6mr_multiaddr=((const struct sockaddr_in6 *) &endpoint.addr)->sin6_addr;
+		mreq6.ipv6mr_interface=ifindex;
+
+		if(setsockopt(sfd,IPPROTO_IPV6,IPV6_JOIN_GROUP,&mreq6,sizeof(mreq6))<0) {
+			error="cannot join the IPv6 multicast group: "+std::string(strerror(errno));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool make_listen_endpoint(const std::string &bind_ip, int port, listen_endpoint_t &endpoint, std::string &error) {
+	endpoint.spec=(bind_ip.find(':')!=std::string::npos ? "["+bind_ip+"]" : bind_ip)+":"+std::to_string(port);
+	endpoint.type=LISTEN_UDP;
+	endpoint.path="";
+	endpoint.ring_size=SHM_RING_DEFAULT_SIZE;
+	endpoint.device="";
+	endpoint.v6only=false;
+	endpoint.queue="";
+	endpoint.tag="";
+
+	return set_endpoint_address(bind_ip,std::to_string(port),endpoint,error);
+}
+
+void unlink_stale_socket(const std::string &path) {
+	struct stat st;
+
+	if(lstat(path.c_str(),&st)==0 && S_ISSOCK(st.st_mode)) {
+		unlink(path.c_str());
+	}
+}
+
+int open_listen_socket(const listen_endpoint_t &endpoint, std::string &error) {
+	int sfd=socket(endpoint.addr.ss_family,SOCK_DGRAM,0);
+
+	if(sfd<0) {
+		error="cannot create socket: "+std::string(strerror(errno));
+		return -1;
+	}
+
+	// IPv6 sockets are dual-stack (i.e., they receive also IPv4 packets, as IPv4-mapped addresses), unless "v6only" is specified
+	if(endpoint.addr.ss_family==AF_INET6) {
+		int v6only=endpoint.v6only ? 1 : 0;
+
+		if(setsockopt(sfd,IPPROTO_IPV6,IPV6_V6ONLY,&v6only,sizeof(v6only))<0) {
+			error="cannot set IPV6_V6ONLY: "+std::string(strerror(errno));
+			close(sfd);
+			return -1;
+		}
+	}
+
+	if(!endpoint.device.empty()) {
+		if(setsockopt(sfd,SOL_SOCKET,SO_BINDTODEVICE,endpoint.device.c_str(),endpoint.device.size()+1)<0) {
+			error="cannot bind to device "+endpoint.device+": "+std::string(strerror(errno));
+			close(sfd);
+			return -1;
+		}
+	}
+
+	// Several sockets (possibly from different processes) can listen on the same port, for different multicast groups
+	if(is_multicast_endpoint(endpoint)) {
+		int reuse=1;
+
+		if(setsockopt(sfd,SOL_SOCKET,SO_REUSEADDR,&reuse,sizeof(reuse))<0) {
+			error="cannot set SO_REUSEADDR: "+std::string(strerror(errno));
+			close(sfd);
+			return -1;
+		}
+	}
+
+	if(endpoint.type==LISTEN_UNIX_DGRAM) {
+		unlink_stale_socket(endpoint.path);
+	}
+
+	if(bind(sfd,(const struct sockaddr *) &endpoint.addr,endpoint.addrlen)<0) {
+		error="cannot bind socket: "+std::string(strerror(errno));
+		close(sfd);
+		return -1;
+	}
+
+	if(is_multicast_endpoint(endpoint)) {
+		// Only receive the packets of the groups joined on this socket (Linux delivers, by default, the packets of any group
+		// joined on the system to all the sockets bound to the same port)
+		if(endpoint.addr.ss_family==AF_INET) {
+			int mcast_all=0;
+
+			if(setsockopt(sfd,IPPROTO_IP,IP_MULTICAST_ALL,&mcast_all,sizeof(mcast_all))<0) {
+				error="cannot disable IP_MULTICAST_ALL: "+std::string(strerror(errno));
+				close(sfd);
+				return -1;
+			}
+		}
+
+		if(endpoint.mcast_ifaces.empty()) {
+			if(!join_multicast_group(sfd,endpoint,0,error)) {
+				close(sfd);
+				return -1;
+			}
+		}
+
+		for(const std::string &iface : endpoint.mcast_ifaces) {
+			unsigned int ifindex=if_nametoindex(iface.c_str());
+
+			if(ifindex==0) {
+				error="unknown multicast interface "+iface;
+				close(sfd);
+				return -1;
+			}
+
+			if(!join_multicast_group(sfd,endpoint,ifindex,error)) {
+				error+=" (interface "+iface+")";
+				close(sfd);
+				return -1;
+			}
+		}
+	}
+
+	return sfd;
+}
@@ -0,0 +1,179 @@
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "lanes.h"
+#include "etsi_position.h"
+
+static bool parse_ulong(const std::string &value, unsigned long max, unsigned long &out) {
+	char *endptr;
+
+	if(value.empty() || value[0]=='-') {
+		return false;
+	}
+
+	errno=0;
+	out=strtoul(value.c_str(),&endptr,10);
+
+	return errno==0 && *endptr=='\0' && out<=max;
+}
+
+bool parse_lane_rule(const std::string &spec, lane_rule_t &rule, std::string &error) {
+	size_t colon_pos=spec.find(':');
+	size_t eq_pos=spec.find('=',colon_pos);
+	unsigned long value;
+
+	if(colon_pos==std::string::npos || eq_pos==std::string::npos) {
+		error="expected <lane>:<field>=<value> in '"+spec+"'";
+		return false;
+	}
+
+	if(!parse_ulong(spec.substr(0,colon_pos),LANES_MAX-1,value)) {
+		error="invalid lane in '"+spec+"' (lanes are numbered from 0 to "+std::to_string(LANES_MAX-1)+")";
+		return false;
+	}
+	rule.lane=value;
+
+	std::string field=spec.substr(colon_pos+1,eq_pos-colon_pos-1);
+	std::string match=spec.substr(eq_pos+1);
+
+	if(field=="msgid") {
+		if(!parse_ulong(match,255,value)) {
+			error="invalid message ID in '"+spec+"'";
+			return false;
+		}
+		rule.type=LANE_MATCH_MSGID;
+		rule.msgid=value;
+	} else if(field=="port") {
+		if(!parse_ulong(match,65535,value)) {
+			error="invalid port in '"+spec+"'";
+			return false;
+		}
+		rule.type=LANE_MATCH_PORT;
+		rule.port=value;
+	} else if(field=="src") {
+		size_t slash_pos=match.find('/');
+		std::string addr=match.substr(0,slash_pos);
+
+		memset(rule.prefix,0,sizeof(rule.prefix));
+		if(inet_pton(AF_INET,addr.c_str(),rule.prefix)==1) {
+			rule.family=AF_INET;
+			rule.prefix_len=32;
+		} else if(inet_pton(AF_INET6,addr.c_str(),rule.prefix)==1) {
+			rule.family=AF_INET6;
+			rule.prefix_len=128;
+		} else {
+			error="invalid source address in '"+spec+"'";
+			return false;
+		}
+
+		if(slash_pos!=std::string::npos) {
+			if(!parse_ulong(match.substr(slash_pos+1),rule.prefix_len,value)) {
+				error="invalid prefix length in '"+spec+"'";
+				return false;
+			}
+			rule.prefix_len=value;
+		}
+		rule.type=LANE_MATCH_SOURCE;
+	} else {
+		error="unknown field '"+field+"' in '"+spec+"' (expected msgid, port or src)";
+		return false;
+	}
+
+	return true;
+}
+
+bool parse_lane_weights(const std::string &spec, std::vector<unsigned int> &weights) {
+	size_t start=0;
+
+	weights.clear();
+
+	while(start<=spec.size()) {
+		size_t comma_pos=spec.find(',',start);
+		unsigned long value;
+
+		if(comma_pos==std::string::npos) {
+			comma_pos=spec.size();
+		}
+
+		if(!parse_ulong(spec.substr(start,comma_pos-start),1000000,value) || value==0) {
+			return false;
+		}
+		weights.push_back(value);
+
+		start=comma_pos+1;
+	}
+
+	return weights.size()<=LANES_MAX;
+}
+
+static bool prefix_match(const uint8_t *addr, const uint8_t *prefix, int prefix_len) {
+	int full_bytes=prefix_len/8;
+	int rem_bits=prefix_len%8;
+
+	if(memcmp(addr,prefix,full_bytes)!=0) {
+		return false;
+	}
+
+	return rem_bits==0 || ((addr[full_bytes]^prefix[full_bytes]) & (0xFF<<(8-rem_bits)))==0;
+}
+
+static bool source_match(const lane_rule_t &rule, const struct sockaddr_storage &src_addr) {
+	if(src_addr.ss_family==AF_INET && rule.family==AF_INET) {
+		return prefix_match((const uint8_t *) &((const struct sockaddr_in *) &src_addr)->sin_addr,rule.prefix,rule.prefix_len);
+	} else if(src_addr.ss_family==AF_INET6) {
+		const struct in6_addr *addr6=&((const struct sockaddr_in6 *) &src_addr)->sin6_addr;
+
+		if(rule.family==AF_INET6) {
+			return prefix_match(addr6->s6_addr,rule.prefix,rule.prefix_len);
+		} else if(IN6_IS_ADDR_V4MAPPED(addr6)) {
+			return prefix_match(&addr6->s6_addr[12],rule.prefix,rule.prefix_len);
+		}
+	}
+
+	return false;
+}
+
+int lane_classify(const std::vector<lane_rule_t> &rules, int default_lane, const uint8_t *buf, size_t len,
+	const struct sockaddr_storage &src_addr, uint16_t dst_port) {
+	// The message ID is looked for only once, and only if a rule needs it
+	int msgid=-2;
+
+	for(const lane_rule_t &rule : rules) {
+		switch(rule.type) {
+			case LANE_MATCH_MSGID:
+				if(msgid==-2) {
+					size_t payload_off=0;
+					uint16_t btp_port;
+
+					msgid=-1;
+					// GeoNetworking (version 1) packets are told apart from bare ITS messages by their first byte
+					if(len>0 && (buf[0]>>4)==1 && !etsi_skip_gn_btp(buf,len,payload_off,btp_port)) {
+						break;
+					}
+					if(len>payload_off+1) {
+						msgid=buf[payload_off+1];
+					}
+				}
+
+				if(msgid==rule.msgid) {
+					return rule.lane;
+				}
+				break;
+			case LANE_MATCH_PORT:
+				if(dst_port==rule.port) {
+					return rule.lane;
+				}
+				break;
+			case LANE_MATCH_SOURCE:
+				if(source_match(rule,src_addr)) {
+					return rule.lane;
+				}
+				break;
+		}
+	}
+
+	return default_lane;
+}
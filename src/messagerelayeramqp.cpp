@@ -2,6 +2,7 @@
 #include <proton/delivery.hpp>
 #include <proton/message.hpp>
 #include <proton/tracker.hpp>
+#include <proton/transport.hpp>
 #include <proton/connection_options.hpp>
 #include <proton/reconnect_options.hpp>
 
@@ -9,6 +10,7 @@
 #include "quadkey_ts_simple.h"
 
 #include <iostream>
+#include <chrono>
 #include <unistd.h>
 
 bool msgrelayerAMQP::wait_sender_ready(void) {
@@ -41,42 +43,220 @@ void msgrelayerAMQP::sendMessage_AMQP(uint8_t *buffer, int bufsize,const double
 	std::string quadkeys = tilesys.LatLonToQuadKey(latitude,longitude);
 	msg.properties().put("quadkeys", quadkeys);
 
-	// "Inject" the work of sending a new message with the current sender (m_sender)
-	// Checking m_work_queue_ptr!=NULL just for additional safety
-	if(m_work_queue_ptr!=NULL) {
-		// Create the AMQP message from the buffer
-		msg.body(proton::binary(buffer,buffer+bufsize));
+	// Create the AMQP message from the buffer
+	msg.body(proton::binary(buffer,buffer+bufsize));
 
-		// Add the work of sending the message via m_sender
-		m_work_queue_ptr->add([=]() {m_sender.send(msg);});
-	}
+	sendMessage_AMQP(msg);
 }
 
 void msgrelayerAMQP::sendMessage_AMQP(uint8_t *buffer, int bufsize) {
 	proton::message msg;
 
-	// "Inject" the work of sending a new message with the current sender (m_sender)
+	// Create the AMQP message from the buffer
+	msg.body(proton::binary(buffer,buffer+bufsize));
+
+	sendMessage_AMQP(msg);
+}
+
+bool msgrelayerAMQP::sendMessage_AMQP(const proton::message &msg, int sender_idx, int lane) {
 	// Checking m_work_queue_ptr!=NULL just for additional safety
-	if(m_work_queue_ptr!=NULL) {
-		// Create the AMQP message from the buffer
-		msg.body(proton::binary(buffer,buffer+bufsize));
+	if(m_work_queue_ptr==NULL) {
+		return false;
+	}
+
+	if(m_lanes<=1) {
+		// "Inject" the work of sending a new message with the sender with index sender_idx
+		if(m_work_queue_ptr->add([=]() {sendDelivery(sender_idx,msg);})) {
+			m_enqueued++;
+			return true;
+		}
+
+		return false;
+	}
+
+	if(lane<0 || lane>=m_lanes) {
+		lane=m_lanes-1;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_lane_mutex);
+
+		if(m_lane_queues[lane].size()>=m_lane_queue_size) {
+			return false;
+		}
+
+		m_lane_queues[lane].emplace_back(sender_idx,msg);
+		m_lane_queues[lane].back().second.priority(getLanePriority(lane));
+	}
+
+	m_enqueued++;
+
+	// Wake up the lane scheduler on the Proton thread, unless it is already going to run
+	if(!m_lanes_scheduled.exchange(true) && !m_work_queue_ptr->add([=]() {serveLanes();})) {
+		m_lanes_scheduled=false;
+	}
+
+	return true;
+}
+
+void msgrelayerAMQP::setLanes(int lanes, const std::vector<unsigned int> &weights, size_t queue_size) {
+	m_lanes=lanes>1 ? lanes : 1;
+	m_lane_weights=weights;
+	m_lane_weights.resize(weights.empty() ? 0 : m_lanes,1);
+	m_lane_queue_size=queue_size;
+	m_lane_queues.resize(m_lanes);
+	m_lane_current.assign(m_lanes,0);
+}
+
+int msgrelayerAMQP::popLaneMessage(std::pair<int,proton::message> &entry) {
+	std::lock_guard<std::mutex> lock(m_lane_mutex);
+	long total_weight=0;
+	int best=-1;
+
+	for(int lane=0;lane<m_lanes;lane++) {
+		// A lane whose sender has no credit does not block the other lanes (on_sendable() resumes it)
+		if(m_lane_queues[lane].empty() || m_senders[m_lane_queues[lane].front().first*m_lanes+lane].credit()<=0) {
+			continue;
+		}
+
+		if(m_lane_weights.empty()) {
+			// Strict priority: the first lane with messages wins
+			best=lane;
+			break;
+		}
+
+		// Smooth weighted round-robin
+		m_lane_current[lane]+=m_lane_weights[lane];
+		total_weight+=m_lane_weights[lane];
+		if(best<0 || m_lane_current[lane]>m_lane_current[best]) {
+			best=lane;
+		}
+	}
+
+	if(best>=0) {
+		if(!m_lane_weights.empty()) {
+			m_lane_current[best]-=total_weight;
+		}
+
+		entry=std::move(m_lane_queues[best].front());
+		m_lane_queues[best].pop_front();
+	}
+
+	return best;
+}
+
+void msgrelayerAMQP::serveLanes(void) {
+	std::pair<int,proton::message> entry;
+
+	m_lanes_scheduled=false;
+
+	// The senders are not available while (re)connecting: on_sendable() will resume the lanes
+	if(!m_connected || m_senders.size()<m_queue_names.size()*m_lanes) {
+		return;
+	}
+
+	// Send a limited batch at a time, so that the other events of the connection (e.g., settlements) are not delayed
+	for(int sent=0;sent<LANES_SERVE_BATCH;sent++) {
+		int lane=popLaneMessage(entry);
 
-		// Add the work of sending the message via m_sender
-		m_work_queue_ptr->add([=]() {m_sender.send(msg);});
+		if(lane<0) {
+			return;
+		}
+
+		sendDelivery(entry.first*m_lanes+lane,entry.second);
+	}
+
+	if(!m_lanes_scheduled.exchange(true) && !m_work_queue_ptr->add([=]() {serveLanes();})) {
+		m_lanes_scheduled=false;
+	}
+}
+
+void msgrelayerAMQP::sendDelivery(size_t idx, const proton::message &msg) {
+	// While reconnecting, m_senders still holds the senders of the dropped connection, whose deliveries would never be settled
+	if(!m_connected || idx>=m_senders.size()) {
+		m_lost++;
+		return;
+	}
+
+	m_senders[idx].send(msg);
+	m_in_flight++;
+}
+
+void msgrelayerAMQP::dropInFlight(void) {
+	m_lost+=m_in_flight;
+	m_in_flight=0;
+}
+
+void msgrelayerAMQP::drain(uint64_t timeout_ms, uint64_t settled_before, uint64_t &flushed, uint64_t &abandoned) {
+	std::chrono::steady_clock::time_point deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+
+	// The messages settled while the previous connections were being drained are counted as flushed too
+	flushed=m_settled-settled_before;
+	abandoned=m_enqueued-m_settled;
+
+	// Nothing can be flushed if the sender has never been opened
+	if(m_work_queue_ptr==NULL) {
+		return;
+	}
+
+	// Wait for all the queued messages to be sent and settled (or lost with a dropped connection), or for the drain deadline to expire
+	while(m_settled+m_lost<m_enqueued && !m_connection_closed && std::chrono::steady_clock::now()<deadline) {
+		usleep(1000);
+	}
+
+	flushed=m_settled-settled_before;
+	abandoned=m_enqueued-m_settled;
+
+	// Close the links and the connection from the Proton thread, and wait (within the same deadline) for the connection to be closed
+	if(!m_connection_closed && m_work_queue_ptr->add([=]() {
+			for(proton::sender &sndr : m_senders) {
+				sndr.close();
+			}
+			m_senders.front().connection().close();
+		})) {
+		while(!m_connection_closed && std::chrono::steady_clock::now()<deadline) {
+			usleep(1000);
+		}
 	}
 }
 
 msgrelayerAMQP::msgrelayerAMQP(const pthread_camrelayer_args_t camrelay_args) :
-	cr_arg_cl(camrelay_args), m_work_queue_ptr(NULL), m_sender_ready(false) {}
+	cr_arg_cl(camrelay_args), m_work_queue_ptr(NULL), m_queue_names(1,camrelay_args.m_queue_name), m_senders_open(0), m_sender_ready(false),
+	m_enqueued(0), m_settled(0), m_lost(0), m_in_flight(0), m_connected(false), m_connection_closed(false), m_lanes(1), m_lane_queue_size(0),
+	m_lanes_scheduled(false) {}
 
 msgrelayerAMQP::msgrelayerAMQP() :
-	m_work_queue_ptr(NULL), m_sender_ready(false) {}
+	m_work_queue_ptr(NULL), m_queue_names(1), m_senders_open(0), m_sender_ready(false), m_enqueued(0), m_settled(0), m_lost(0), m_in_flight(0),
+	m_connected(false), m_connection_closed(false), m_lanes(1), m_lane_queue_size(0), m_lanes_scheduled(false) {}
 
 void msgrelayerAMQP::set_args(const pthread_camrelayer_args_t camrelay_args) {
 	cr_arg_cl=camrelay_args;
+	m_queue_names[0]=cr_arg_cl.m_queue_name;
+}
+
+int msgrelayerAMQP::addQueue(const std::string &queue_name) {
+	for(size_t i=0;i<m_queue_names.size();i++) {
+		if(m_queue_names[i]==queue_name) {
+			return i;
+		}
+	}
+
+	m_queue_names.push_back(queue_name);
+
+	return m_queue_names.size()-1;
 }
 
 void msgrelayerAMQP::on_container_start(proton::container& c) {
+	connect(c);
+}
+
+void msgrelayerContainerHandler::on_container_start(proton::container& c) {
+	for(msgrelayerAMQP *relayer : m_relayers) {
+		relayer->connect(c);
+	}
+}
+
+void msgrelayerAMQP::connect(proton::container& c) {
 	proton::connection_options co;
 	bool co_set=false;
 
@@ -132,38 +312,77 @@ void msgrelayerAMQP::on_container_start(proton::container& c) {
 	}
 	
 	if(co_set == true) {
-		std::cout << "Connecting to the AMQP broker with user-defined connection options." << std::endl;
-		c.connect(cr_arg_cl.m_broker_address,co);
+		std::cout << "Connecting to the AMQP broker (" << cr_arg_cl.m_broker_address << ") with user-defined connection options." << std::endl;
 	} else {
-		std::cout << "Connecting to the AMQP broker with default connection options." << std::endl;
-		c.connect(cr_arg_cl.m_broker_address);
+		std::cout << "Connecting to the AMQP broker (" << cr_arg_cl.m_broker_address << ") with default connection options." << std::endl;
 	}
 
+	// This object always handles the events of its own connection, even when the container is shared with other connections
+	co.handler(*this);
+	c.connect(cr_arg_cl.m_broker_address,co);
+
 	// Old code - kept here just for reference
 	// c.connect(cr_arg_cl.m_broker_address,co.idle_timeout(proton::duration::FOREVER));
 	// c.connect(cr_arg_cl.m_broker_address,co.idle_timeout(proton::duration(1000)));
 }
 
 void msgrelayerAMQP::on_connection_open(proton::connection& c) {
-	c.open_sender(cr_arg_cl.m_queue_name);
+	// Open one sender for each queue/topic (the order of m_senders is the same as m_queue_names), and for each priority
+	// lane, so that the messages of a lane are never queued behind the ones of lower priority lanes
+	m_senders.clear();
+	m_senders_open=0;
+
+	// After a reconnection, the messages sent on the previous connection and never settled are lost
+	dropInFlight();
+	m_connected=true;
+
+	for(const std::string &queue_name : m_queue_names) {
+		for(int lane=0;lane<m_lanes;lane++) {
+			m_senders.push_back(c.open_sender(queue_name));
+		}
+	}
 }
 
 void msgrelayerAMQP::on_sender_open(proton::sender& protonsender) {
-	m_sender=protonsender;
+	// Get the work queue pointer out of the sender (all the senders share the same connection and work queue)
+	m_work_queue_ptr=&protonsender.work_queue();
 
-	// Get the work queue pointer out of the sender
-	m_work_queue_ptr=&m_sender.work_queue();
-
-	// Set "m_sender_ready" to true -> now the sender is ready and the application can safely call sendMessage_AMQP()
-	m_sender_ready=true;
+	// Set "m_sender_ready" to true when all the senders are open -> now the application can safely call sendMessage_AMQP()
+	if(++m_senders_open>=m_senders.size()) {
+		m_sender_ready=true;
+	}
 }
 
-// This function basically does nothing -> the std::cout can be optionally enabled to print some debug information
+// When priority lanes are enabled, resume serving the lanes as soon as a sender gets new credit
+// Otherwise, this function basically does nothing -> the std::cout can be optionally enabled to print some debug information
 void msgrelayerAMQP::on_sendable(proton::sender &s) {
     //std::cout<<"Credit left: "<<s.credit()<<std::endl;
+	if(m_lanes>1) {
+		serveLanes();
+	}
 }
 
 // This function basically does nothing other than printing "on_message" -> you can enable the "on_message" printing for debug purposes by decommenting the content of the function
 void msgrelayerAMQP::on_message(proton::delivery &dlvr, proton::message &msg) {
 	//std::cout<<"on_message: "<<std::endl;
 }
+
+// Count the messages settled by the broker, in order to know how many messages are still pending when draining
+void msgrelayerAMQP::on_tracker_settle(proton::tracker &trk) {
+	m_settled++;
+	if(m_in_flight>0) {
+		m_in_flight--;
+	}
+}
+
+void msgrelayerAMQP::on_transport_error(proton::transport &t) {
+	m_connected=false;
+	dropInFlight();
+
+	// Default handling of the error (as before this handler was overridden)
+	proton::messaging_handler::on_transport_error(t);
+}
+
+void msgrelayerAMQP::on_connection_close(proton::connection &c) {
+	m_connection_closed=true;
+}
@@ -0,0 +1,1180 @@
+#include <errno.h>
+#include <unistd.h>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <cstring>
+#include <cmath>
+#include <sys/un.h>
+
+#include <proton/message.hpp>
+#include <proton/binary.hpp>
+
+#include "pipeline.h"
+#include "addr_format.h"
+#include "timers.h"
+
+bool parse_src_props_mode(const std::string &name, src_props_mode_t &mode) {
+	if(name=="none") {
+		mode=SRC_PROPS_NONE;
+	} else if(name=="text") {
+		mode=SRC_PROPS_TEXT;
+	} else if(name=="binary") {
+		mode=SRC_PROPS_BINARY;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool parse_quadkey_format(const std::string &name, quadkey_format_t &format) {
+	if(name=="string") {
+		format=QUADKEY_FORMAT_STRING;
+	} else if(name=="ulong") {
+		format=QUADKEY_FORMAT_ULONG;
+	} else if(name=="both") {
+		format=QUADKEY_FORMAT_BOTH;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool parse_coord_invalid_policy(const std::string &name, coord_invalid_policy_t &policy) {
+	if(name=="no-quadkey") {
+		policy=COORD_INVALID_NO_QUADKEY;
+	} else if(name=="drop") {
+		policy=COORD_INVALID_DROP;
+	} else if(name=="dead-letter") {
+		policy=COORD_INVALID_DEAD_LETTER;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool parse_spatial_keys(const std::string &list, unsigned int &keys) {
+	size_t start=0;
+
+	keys=0;
+
+	while(start<=list.size()) {
+		size_t comma_pos=list.find(',',start);
+
+		if(comma_pos==std::string::npos) {
+			comma_pos=list.size();
+		}
+
+		std::string name=list.substr(start,comma_pos-start);
+
+		if(name=="quadkey") {
+			keys|=SPATIAL_KEYS_QUADKEY;
+		} else if(name=="geohash") {
+			keys|=SPATIAL_KEYS_GEOHASH;
+		} else if(name=="morton") {
+			keys|=SPATIAL_KEYS_MORTON;
+		} else {
+			return false;
+		}
+
+		start=comma_pos+1;
+	}
+
+	return true;
+}
+
+void pipeline_opts_init(pipeline_opts_t &opts) {
+	opts.name="default";
+	opts.amqp_args.m_broker_address="";
+	opts.amqp_args.m_queue_name="";
+	opts.bind_ip="0.0.0.0";
+	opts.listen_port=49900;
+	opts.minimum_msg_size=0;
+	opts.quadk_enable=false;
+	opts.quadk_level=18;
+	opts.quadk_format=QUADKEY_FORMAT_STRING;
+	opts.quadk_cache_slots=0;
+	opts.quadk_nbr_level=0;
+	opts.spatial_keys=SPATIAL_KEYS_QUADKEY;
+	opts.geohash_precision=9;
+	opts.station_index_path="";
+	opts.station_max_age_ms=60000;
+	opts.adaptive_lod_min_level=0;
+	opts.adaptive_lod_split_rate=100;
+	opts.adaptive_lod_interval_ms=10000;
+	opts.adaptive_lod_map_path="";
+	opts.heatmap_path="";
+	opts.heatmap_level=0;
+	opts.heatmap_interval_ms=60000;
+	opts.heatmap_format=HEATMAP_FORMAT_CSV;
+	opts.heatmap_slots=HEATMAP_DEFAULT_SLOTS;
+	opts.coord_format.type=COORD_INT32;
+	opts.coord_format.big_endian=true;
+	opts.coord_format.offset=0;
+	opts.coord_format.scale=0;
+	opts.coord_format.strip=true;
+	opts.coord_invalid=COORD_INVALID_NO_QUADKEY;
+	opts.coord_dead_letter_queue="";
+	opts.src_props=SRC_PROPS_NONE;
+	opts.conflate_interval_ms=0;
+	opts.conflate_key=CONFLATE_BY_STATION;
+	opts.conflate_slots=CONFLATION_DEFAULT_SLOTS;
+	opts.dedup_window_ms=0;
+	opts.dedup_slots=DEDUP_DEFAULT_SLOTS;
+	opts.rate_limit=0;
+	opts.rate_burst=0;
+	opts.rate_key=RATELIMIT_BY_IP;
+	opts.rate_slots=RATELIMIT_DEFAULT_SLOTS;
+	opts.shed_watermark=0;
+	opts.priority_lanes=1;
+	opts.lane_weights.clear();
+	opts.lane_queue_size=LANES_DEFAULT_QUEUE_SIZE;
+	opts.lane_rules.clear();
+	opts.max_msg_size=RX_MAX_UDP_PAYLOAD;
+	opts.drop_truncated=false;
+	opts.udp_gro=false;
+
+	opts.amqp_username="";
+	opts.amqp_password="";
+	opts.amqp_reconnect=false;
+	opts.amqp_allow_sasl=false;
+	opts.amqp_allow_plain=false;
+	opts.amqp_idle_timeout_ms=-1;
+	opts.amqp_connections=1;
+}
+
+bool pipeline_opts_same_connection(const pipeline_opts_t &a, const pipeline_opts_t &b) {
+	return a.amqp_args.m_broker_address==b.amqp_args.m_broker_address &&
+		a.amqp_username==b.amqp_username &&
+		a.amqp_password==b.amqp_password &&
+		a.amqp_reconnect==b.amqp_reconnect &&
+		a.amqp_allow_sasl==b.amqp_allow_sasl &&
+		a.amqp_allow_plain==b.amqp_allow_plain &&
+		a.amqp_idle_timeout_ms==b.amqp_idle_timeout_ms &&
+		a.amqp_connections==b.amqp_connections &&
+		a.priority_lanes==b.priority_lanes &&
+		a.lane_weights==b.lane_weights &&
+		a.lane_queue_size==b.lane_queue_size;
+}
+
+// Spatial key encoders: each one attaches its key(s) to the message, using the projection shared by all of them
+
+static void encode_quadkey(const spatial_point_t &point, const pipeline_opts_t &opts, proton::message &msg) {
+	if(opts.quadk_format!=QUADKEY_FORMAT_ULONG) {
+		char qk_str[QUADKEY_MAX_LEVEL+1];
+		size_t len=quadkey_ulong_to_string(quadkey_ulong_encode(point.tile_x,point.tile_y,point.tile_level),qk_str);
+
+		msg.properties().put("quadkeys", std::string(qk_str,len));
+	}
+	if(opts.quadk_format!=QUADKEY_FORMAT_STRING) {
+		msg.properties().put("quadkey", quadkey_ulong_encode(point.tile_x,point.tile_y,point.tile_level));
+	}
+
+	if(opts.quadk_nbr_level<=0) {
+		return;
+	}
+
+	// Tile at the level of the neighbors (which is never finer than the level of the quadkeys)
+	int shift=point.tile_level-opts.quadk_nbr_level;
+	uint64_t tiles[QUADKEY_NEIGHBORS_MAX];
+	size_t ntiles=quadkey_ulong_neighbors(point.tile_x >> shift,point.tile_y >> shift,opts.quadk_nbr_level,tiles);
+
+	if(opts.quadk_format!=QUADKEY_FORMAT_ULONG) {
+		// Fixed-length quadkeys separated by commas: a consumer can look for a tile with a single LIKE '%<quadkey>%'
+		char nbr_str[QUADKEY_NEIGHBORS_MAX*(QUADKEY_MAX_LEVEL+1)];
+		size_t len=0;
+
+		for(size_t i=0;i<ntiles;i++) {
+			if(i>0) {
+				nbr_str[len++]=',';
+			}
+			len+=quadkey_ulong_to_string(tiles[i],nbr_str+len);
+		}
+
+		msg.properties().put("quadkeys_nbr", std::string(nbr_str,len));
+	}
+
+	if(opts.quadk_format!=QUADKEY_FORMAT_STRING) {
+		static const char *nbr_names[QUADKEY_NEIGHBORS_MAX]={"quadkey_nbr0","quadkey_nbr1","quadkey_nbr2","quadkey_nbr3","quadkey_nbr4",
+			"quadkey_nbr5","quadkey_nbr6","quadkey_nbr7","quadkey_nbr8"};
+
+		for(size_t i=0;i<ntiles;i++) {
+			msg.properties().put(nbr_names[i], tiles[i]);
+		}
+	}
+}
+
+static void encode_geohash(const spatial_point_t &point, const pipeline_opts_t &opts, proton::message &msg) {
+	char geohash[SPATIAL_GEOHASH_MAX_PRECISION+1];
+	size_t len=spatial_geohash(point.morton,opts.geohash_precision,geohash);
+
+	msg.properties().put("geohash", std::string(geohash,len));
+}
+
+static void encode_morton(const spatial_point_t &point, const pipeline_opts_t &opts, proton::message &msg) {
+	msg.properties().put("morton", point.morton);
+}
+
+relayerPipeline::relayerPipeline(const pipeline_opts_t &opts) :
+	m_opts(opts), m_conflation(NULL), m_conflation_timer(NULL), m_dedup(NULL), m_dedup_timer(NULL), m_ratelimiter(NULL), m_tile_cache(NULL), m_station_index(NULL), m_station_timer(NULL), m_adaptive_lod(NULL), m_adaptive_lod_timer(NULL), m_heatmap(NULL), m_heatmap_timer(NULL) {
+	memset(&m_stats,0,sizeof(m_stats));
+	m_tilesys.setLevelOfDetail(m_opts.quadk_level);
+
+	if(m_opts.coord_format.scale==0) {
+		m_opts.coord_format.scale=coord_default_scale(m_opts.coord_format.type);
+	}
+	m_coord_decoder=coord_select_decoder(m_opts.coord_format);
+	// The ETSI "unavailable" values are in 1e-7 degrees (the ETSI decoder already returns them as NaN)
+	m_coord_sentinels=m_opts.coord_format.type==COORD_INT32 && m_opts.coord_format.scale==1e7;
+
+	if(m_opts.coord_invalid==COORD_INVALID_DEAD_LETTER && m_opts.coord_dead_letter_queue.empty()) {
+		std::cerr << "[" << m_opts.name << "] Warning: no dead-letter queue/topic has been specified. The packets with invalid coordinates will be relayed without quadkeys." << std::endl;
+		m_opts.coord_invalid=COORD_INVALID_NO_QUADKEY;
+	}
+
+	if(m_opts.conflate_interval_ms>0) {
+		m_conflation=new conflationTable(m_opts.conflate_slots);
+		m_conflation_timer=new Timer(m_opts.conflate_interval_ms);
+
+		if(!m_conflation_timer->start()) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot start the conflation timer. Conflation will be disabled." << std::endl;
+			delete m_conflation_timer;
+			delete m_conflation;
+			m_conflation_timer=NULL;
+			m_conflation=NULL;
+		}
+	}
+
+	if(m_opts.dedup_window_ms>0) {
+		// The oldest generation of payload hashes is forgotten every window/(DEDUP_GENERATIONS-1) ms
+		int rotate_ms=m_opts.dedup_window_ms/(DEDUP_GENERATIONS-1);
+
+		m_dedup=new dedupFilter(m_opts.dedup_slots);
+		m_dedup_timer=new Timer(rotate_ms>0 ? rotate_ms : 1);
+
+		if(!m_dedup_timer->start()) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot start the duplicate suppression timer. Duplicate suppression will be disabled." << std::endl;
+			delete m_dedup_timer;
+			delete m_dedup;
+			m_dedup_timer=NULL;
+			m_dedup=NULL;
+		}
+	}
+
+	if(m_opts.adaptive_lod_min_level>0 && (m_opts.adaptive_lod_min_level>=m_tilesys.getLevelOfDetail() || !(m_opts.spatial_keys & SPATIAL_KEYS_QUADKEY))) {
+		std::cerr << "[" << m_opts.name << "] Warning: the adaptive level of detail requires quadkeys with a level greater than its minimum level (" <<
+			m_opts.adaptive_lod_min_level << "). It will be disabled." << std::endl;
+		m_opts.adaptive_lod_min_level=0;
+	}
+
+	// The neighbors are computed from the tile of the quadkeys, so their level cannot be finer
+	if(m_opts.quadk_nbr_level>m_tilesys.getLevelOfDetail()) {
+		std::cerr << "[" << m_opts.name << "] Warning: the level of the neighbor tiles cannot be greater than the level of the quadkeys. Level " <<
+			m_tilesys.getLevelOfDetail() << " will be used instead." << std::endl;
+		m_opts.quadk_nbr_level=m_tilesys.getLevelOfDetail();
+	}
+
+	// With the adaptive level of detail, the quadkeys can be as coarse as the minimum level
+	if(m_opts.adaptive_lod_min_level>0 && m_opts.quadk_nbr_level>m_opts.adaptive_lod_min_level) {
+		std::cerr << "[" << m_opts.name << "] Warning: the level of the neighbor tiles cannot be greater than the minimum adaptive level. Level " <<
+			m_opts.adaptive_lod_min_level << " will be used instead." << std::endl;
+		m_opts.quadk_nbr_level=m_opts.adaptive_lod_min_level;
+	}
+
+	if(m_opts.spatial_keys & SPATIAL_KEYS_QUADKEY) {
+		m_key_encoders.push_back(&encode_quadkey);
+	}
+	if(m_opts.spatial_keys & SPATIAL_KEYS_GEOHASH) {
+		m_key_encoders.push_back(&encode_geohash);
+	}
+	if(m_opts.spatial_keys & SPATIAL_KEYS_MORTON) {
+		m_key_encoders.push_back(&encode_morton);
+	}
+
+	// The tile cache is keyed by the integer coordinates, as received
+	if(m_opts.quadk_enable==true && m_opts.quadk_cache_slots>0) {
+		if(m_opts.coord_format.type==COORD_INT32 || m_opts.coord_format.type==COORD_ETSI) {
+			m_tile_cache=new tileCache(m_opts.coord_format.type==COORD_ETSI ? 1e7 : m_opts.coord_format.scale,m_tilesys.getLevelOfDetail(),m_opts.quadk_cache_slots);
+		} else {
+			std::cerr << "[" << m_opts.name << "] Warning: the tile cache requires integer coordinates. It will be disabled." << std::endl;
+		}
+	}
+
+	if(m_opts.quadk_enable==true && !m_opts.station_index_path.empty()) {
+		std::string error;
+
+		m_station_index=new stationIndex(m_opts.station_max_age_ms,m_tilesys.getLevelOfDetail());
+		// Stations are expired every second, or more often with shorter maximum ages
+		m_station_timer=new Timer(std::min(m_opts.station_max_age_ms,1000));
+
+		if(!m_station_index->openSocket(m_opts.station_index_path,error) || !m_station_timer->start()) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot start the station index (" << (error.empty() ? "cannot start the expiration timer" : error) <<
+				"). The station index will be disabled." << std::endl;
+			delete m_station_timer;
+			delete m_station_index;
+			m_station_timer=NULL;
+			m_station_index=NULL;
+		} else {
+			std::cout << "[" << m_opts.name << "] Answering station index queries on " << m_opts.station_index_path << std::endl;
+		}
+	}
+
+	if(m_opts.quadk_enable==true && m_opts.adaptive_lod_min_level>0) {
+		m_adaptive_lod=new adaptiveLod(m_opts.adaptive_lod_min_level,m_tilesys.getLevelOfDetail(),m_opts.adaptive_lod_split_rate,m_opts.adaptive_lod_interval_ms);
+		m_adaptive_lod_timer=new Timer(m_opts.adaptive_lod_interval_ms);
+
+		if(!m_adaptive_lod_timer->start()) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot start the adaptive level of detail timer. The adaptive level of detail will be disabled." << std::endl;
+			delete m_adaptive_lod_timer;
+			delete m_adaptive_lod;
+			m_adaptive_lod_timer=NULL;
+			m_adaptive_lod=NULL;
+		} else {
+			// Initial partition: all the tiles of the minimum level
+			publishPartition();
+		}
+	}
+
+	if(m_opts.quadk_enable==true && !m_opts.heatmap_path.empty()) {
+		struct timespec now;
+		int level=m_opts.heatmap_level>0 ? m_opts.heatmap_level : m_tilesys.getLevelOfDetail();
+
+		// The heatmap tiles are computed from the tile of the quadkeys, so their level cannot be finer
+		if(level>m_tilesys.getLevelOfDetail()) {
+			std::cerr << "[" << m_opts.name << "] Warning: the level of the heatmap cannot be greater than the level of the quadkeys. Level " <<
+				m_tilesys.getLevelOfDetail() << " will be used instead." << std::endl;
+			level=m_tilesys.getLevelOfDetail();
+		}
+
+		clock_gettime(CLOCK_REALTIME,&now);
+		m_heatmap=new tileHeatmap(level,m_tilesys.getLevelOfDetail(),(uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec,m_opts.heatmap_slots);
+		m_heatmap_timer=new Timer(m_opts.heatmap_interval_ms);
+
+		if(!m_heatmap_timer->start()) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot start the heatmap timer. The heatmap will be disabled." << std::endl;
+			delete m_heatmap_timer;
+			delete m_heatmap;
+			m_heatmap_timer=NULL;
+			m_heatmap=NULL;
+		}
+	}
+
+	// By default, DENMs are relayed through the highest priority lane, and any other packet through the lowest priority one
+	if(m_opts.priority_lanes>1 && m_opts.lane_rules.empty()) {
+		lane_rule_t denm_rule;
+		std::string error;
+
+		parse_lane_rule("0:msgid=" + std::to_string(ETSI_MSGID_DENM),denm_rule,error);
+		m_opts.lane_rules.push_back(denm_rule);
+	}
+
+	for(lane_rule_t &rule : m_opts.lane_rules) {
+		if(rule.lane>=m_opts.priority_lanes) {
+			std::cerr << "[" << m_opts.name << "] Warning: lane " << rule.lane << " does not exist. The lowest priority lane will be used instead." << std::endl;
+			rule.lane=m_opts.priority_lanes>1 ? m_opts.priority_lanes-1 : 0;
+		}
+	}
+
+	// The per-source table is used also to count the packets dropped by the overload shedder
+	if(m_opts.rate_limit>0 || m_opts.shed_watermark>0) {
+		m_ratelimiter=new sourceRateLimiter(m_opts.rate_limit,m_opts.rate_burst>0 ? m_opts.rate_burst : m_opts.rate_limit,m_opts.rate_slots,m_opts.rate_key);
+	}
+
+	// Legacy single endpoint (--bindto and --listen-port), when no endpoint has been explicitly specified
+	if(m_opts.listen_endpoints.empty()) {
+		listen_endpoint_t endpoint;
+		std::string error;
+
+		if(!make_listen_endpoint(m_opts.bind_ip,m_opts.listen_port,endpoint,error)) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot set an IP address to bind to (" << error << ")." << std::endl;
+		} else {
+			m_opts.listen_endpoints.push_back(endpoint);
+		}
+	}
+
+	for(const listen_endpoint_t &endpoint : m_opts.listen_endpoints) {
+		pipeline_endpoint_t pipeline_ep;
+
+		pipeline_ep.ep=endpoint;
+		pipeline_ep.sfd=-1;
+		pipeline_ep.shm=NULL;
+		pipeline_ep.gro_enabled=false;
+		pipeline_ep.dst_port=0;
+
+		if(endpoint.type==LISTEN_UDP) {
+			pipeline_ep.dst_port=ntohs(endpoint.addr.ss_family==AF_INET6 ? ((const struct sockaddr_in6 *) &endpoint.addr)->sin6_port :
+				((const struct sockaddr_in *) &endpoint.addr)->sin_port);
+		}
+
+		m_endpoints.push_back(pipeline_ep);
+	}
+}
+
+relayerPipeline::~relayerPipeline() {
+	closeSockets();
+
+	delete m_conflation_timer;
+	delete m_conflation;
+	delete m_dedup_timer;
+	delete m_dedup;
+	delete m_ratelimiter;
+	delete m_tile_cache;
+	delete m_station_timer;
+	delete m_station_index;
+	delete m_adaptive_lod_timer;
+	delete m_adaptive_lod;
+	delete m_heatmap_timer;
+	delete m_heatmap;
+}
+
+void relayerPipeline::addRelayer(msgrelayerAMQP *relayer) {
+	m_relayers.push_back(relayer);
+
+	for(pipeline_endpoint_t &endpoint : m_endpoints) {
+		endpoint.sender_idx.push_back(relayer->addQueue(endpoint.ep.queue.empty() ? m_opts.amqp_args.m_queue_name : endpoint.ep.queue));
+	}
+
+	if(m_opts.quadk_enable==true && m_opts.coord_invalid==COORD_INVALID_DEAD_LETTER) {
+		m_dead_letter_idx.push_back(relayer->addQueue(m_opts.coord_dead_letter_queue));
+	}
+}
+
+bool relayerPipeline::openSockets(void) {
+	if(m_endpoints.empty()) {
+		std::cerr << "[" << m_opts.name << "] Error: no valid endpoint to listen on." << std::endl;
+		return false;
+	}
+
+	for(pipeline_endpoint_t &endpoint : m_endpoints) {
+		std::string error;
+
+		if(endpoint.ep.type==LISTEN_SHM_RING) {
+			endpoint.shm=new shmRingIngest(endpoint.ep.path,endpoint.ep.ring_size);
+
+			if(!endpoint.shm->open(error)) {
+				std::cerr << "[" << m_opts.name << "] Error: cannot listen on " << endpoint.ep.spec << ". Details: " << error << std::endl;
+				closeSockets();
+				return false;
+			}
+
+			std::cout << "[" << m_opts.name << "] Relaying shared-memory producers of " << endpoint.ep.spec << " to " <<
+				m_opts.amqp_args.m_broker_address << "/" << (endpoint.ep.queue.empty() ? m_opts.amqp_args.m_queue_name : endpoint.ep.queue) << std::endl;
+			continue;
+		}
+
+		// Create and bind the UDP (or AF_UNIX datagram) socket
+		endpoint.sfd=open_listen_socket(endpoint.ep,error);
+
+		if(endpoint.sfd<0) {
+			std::cerr << "[" << m_opts.name << "] Error: cannot listen on " << endpoint.ep.spec << ". Details: " << error << std::endl;
+			closeSockets();
+			return false;
+		}
+
+		// Ask the kernel to provide the receive timestamp of each packet, if it should be relayed as AMQP property
+		if(m_opts.src_props!=SRC_PROPS_NONE) {
+			int enable_ts=1;
+
+			if(setsockopt(endpoint.sfd,SOL_SOCKET,SO_TIMESTAMPNS,&enable_ts,sizeof(enable_ts))<0) {
+				std::cerr << "[" << m_opts.name << "] Warning: cannot enable kernel receive timestamps. The relayer timestamps will be used instead." << std::endl;
+			}
+		}
+
+		// Let the kernel coalesce bursts of same-sized packets into a single buffer (split again in user space by udpRxBatch)
+		// If UDP GRO is not supported (Linux < 5.0), the packets are simply received one by one
+		if(m_opts.udp_gro==true && endpoint.ep.type==LISTEN_UDP) {
+			int enable_gro=1;
+
+			if(setsockopt(endpoint.sfd,SOL_UDP,UDP_GRO,&enable_gro,sizeof(enable_gro))<0) {
+				std::cerr << "[" << m_opts.name << "] Warning: UDP GRO is not supported by this kernel (" << std::string(strerror(errno)) << "). "
+					"Packets will be received without GRO." << std::endl;
+			} else {
+				endpoint.gro_enabled=true;
+			}
+		}
+
+		std::cout << "[" << m_opts.name << "] Relaying " << (endpoint.ep.type==LISTEN_UDP ? "UDP" : "AF_UNIX") << " endpoint " << endpoint.ep.spec << " to " <<
+			m_opts.amqp_args.m_broker_address << "/" << (endpoint.ep.queue.empty() ? m_opts.amqp_args.m_queue_name : endpoint.ep.queue) << std::endl;
+	}
+
+	return true;
+}
+
+void relayerPipeline::closeSockets(void) {
+	for(pipeline_endpoint_t &endpoint : m_endpoints) {
+		if(endpoint.sfd>=0) {
+			close(endpoint.sfd);
+			endpoint.sfd=-1;
+
+			if(endpoint.ep.type==LISTEN_UNIX_DGRAM) {
+				unlink(endpoint.ep.path.c_str());
+			}
+		}
+
+		if(endpoint.shm!=NULL) {
+			delete endpoint.shm;
+			endpoint.shm=NULL;
+		}
+	}
+}
+
+void relayerPipeline::getPollDescriptors(size_t ep_idx, std::vector<int> &fds) {
+	pipeline_endpoint_t &endpoint=m_endpoints[ep_idx];
+
+	if(endpoint.shm!=NULL) {
+		endpoint.shm->getPollDescriptors(fds);
+	} else if(endpoint.sfd>=0) {
+		fds.push_back(endpoint.sfd);
+	}
+}
+
+bool relayerPipeline::handleEvent(udpRxBatch &rx_batch, size_t ep_idx, int fd) {
+	pipeline_endpoint_t &endpoint=m_endpoints[ep_idx];
+
+	if(endpoint.shm==NULL) {
+		receiveAndRelay(rx_batch,ep_idx);
+		return false;
+	}
+
+	bool changed=endpoint.shm->handleEvent(fd);
+
+	if(endpoint.shm->hasPending()) {
+		relayShmRecords(endpoint);
+	}
+
+	return changed;
+}
+
+bool relayerPipeline::hasPendingRecords(void) {
+	for(pipeline_endpoint_t &endpoint : m_endpoints) {
+		if(endpoint.shm!=NULL && endpoint.shm->hasPending()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void relayerPipeline::relayPendingRecords(void) {
+	for(pipeline_endpoint_t &endpoint : m_endpoints) {
+		if(endpoint.shm!=NULL && endpoint.shm->hasPending()) {
+			relayShmRecords(endpoint);
+		}
+	}
+}
+
+void relayerPipeline::getTimerDescriptors(std::vector<int> &fds) {
+	if(m_conflation_timer!=NULL) {
+		fds.push_back(m_conflation_timer->getFd());
+	}
+
+	if(m_dedup_timer!=NULL) {
+		fds.push_back(m_dedup_timer->getFd());
+	}
+
+	if(m_station_index!=NULL) {
+		fds.push_back(m_station_timer->getFd());
+		fds.push_back(m_station_index->getFd());
+	}
+
+	if(m_adaptive_lod_timer!=NULL) {
+		fds.push_back(m_adaptive_lod_timer->getFd());
+	}
+
+	if(m_heatmap_timer!=NULL) {
+		fds.push_back(m_heatmap_timer->getFd());
+	}
+}
+
+void relayerPipeline::handleTimer(int fd) {
+	if(m_conflation_timer!=NULL && fd==m_conflation_timer->getFd()) {
+		m_conflation_timer->waitForExpiration();
+		flushConflated();
+	} else if(m_dedup_timer!=NULL && fd==m_dedup_timer->getFd()) {
+		m_dedup_timer->waitForExpiration();
+		m_dedup->rotate();
+	} else if(m_station_index!=NULL && fd==m_station_timer->getFd()) {
+		struct timespec now;
+
+		m_station_timer->waitForExpiration();
+		clock_gettime(CLOCK_REALTIME,&now);
+		m_station_index->expire((uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec);
+	} else if(m_station_index!=NULL && fd==m_station_index->getFd()) {
+		m_station_index->handleQuery();
+	} else if(m_adaptive_lod_timer!=NULL && fd==m_adaptive_lod_timer->getFd()) {
+		m_adaptive_lod_timer->waitForExpiration();
+		if(m_adaptive_lod->rebalance()) {
+			publishPartition();
+		}
+	} else if(m_heatmap_timer!=NULL && fd==m_heatmap_timer->getFd()) {
+		m_heatmap_timer->waitForExpiration();
+		flushHeatmap();
+	}
+}
+
+void relayerPipeline::publishPartition(void) {
+	std::string error;
+
+	if(m_opts.adaptive_lod_map_path.empty()) {
+		return;
+	}
+
+	if(!m_adaptive_lod->writeMap(m_opts.adaptive_lod_map_path,error)) {
+		std::cerr << "[" << m_opts.name << "] Error: cannot write the adaptive quadkey partition (" << error << ")." << std::endl;
+	}
+}
+
+void relayerPipeline::flushConflated(void) {
+	if(m_conflation==NULL) {
+		return;
+	}
+
+	m_conflation->flush([this](proton::message &msg, size_t conn_idx, int sender_idx, int lane) {
+		sendMessage(msg,conn_idx,sender_idx,lane);
+	});
+}
+
+void relayerPipeline::flushHeatmap(void) {
+	struct timespec now;
+	std::string error;
+
+	if(m_heatmap==NULL) {
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME,&now);
+	if(!m_heatmap->rotate((uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec,m_opts.heatmap_path,m_opts.heatmap_format,error)) {
+		std::cerr << "[" << m_opts.name << "] Error: cannot write the heatmap snapshot (" << error << ")." << std::endl;
+	}
+}
+
+void relayerPipeline::sendMessage(const proton::message &msg, size_t conn_idx, int sender_idx, int lane) {
+	if(m_opts.priority_lanes<=1) {
+		if(m_relayers[conn_idx]->sendMessage_AMQP(msg,sender_idx)) {
+			m_stats.relayed++;
+		} else {
+			m_stats.send_failed++;
+		}
+	} else if(m_relayers[conn_idx]->sendMessage_AMQP(msg,sender_idx,lane)) {
+		m_stats.relayed++;
+		m_stats.lane_relayed[lane]++;
+	} else {
+		m_stats.lane_full++;
+	}
+}
+
+bool relayerPipeline::conflateMessage(proton::message &msg, const rx_datagram_t &dgram, size_t conn_idx, int sender_idx, int lane) {
+	conflation_key_t key;
+
+	if(m_opts.conflate_key==CONFLATE_BY_STATION) {
+		etsi_position_t pos;
+
+		// Only CAMs and DENMs are conflated by station
+		if(!etsi_extract_position_auto(dgram.data,dgram.len,pos)) {
+			return false;
+		}
+		conflation_key_station(pos.station_id,pos.message_id,key);
+	} else {
+		conflation_key_source(dgram.src_addr,key);
+	}
+
+	int ret=m_conflation->store(key,msg,conn_idx,sender_idx,lane);
+
+	if(ret<0) {
+		m_stats.conflation_full++;
+		return false;
+	}
+
+	if(ret>0) {
+		m_stats.conflated++;
+	}
+
+	return true;
+}
+
+// Overload shedding priority of a packet: DENMs are dropped last, then CAMs, while any other packet is dropped first
+static int shed_priority(const uint8_t *buf, size_t len) {
+	etsi_position_t pos;
+
+	if(!etsi_extract_position_auto(buf,len,pos)) {
+		return 0;
+	}
+
+	return pos.message_id==ETSI_MSGID_DENM ? 2 : 1;
+}
+
+bool relayerPipeline::shedPacket(const rx_datagram_t &dgram) {
+	struct timespec now;
+	uint64_t now_ns;
+
+	// The coarse clock is enough for the token buckets, and much cheaper to read
+	clock_gettime(CLOCK_MONOTONIC_COARSE,&now);
+	now_ns=(uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec;
+
+	if(m_opts.rate_limit>0 && !m_ratelimiter->allow(dgram.src_addr,now_ns)) {
+		m_stats.rate_limited++;
+		return true;
+	}
+
+	if(m_opts.shed_watermark>0) {
+		uint64_t backlog=0;
+
+		for(msgrelayerAMQP *relayer : m_relayers) {
+			backlog+=relayer->getBacklog();
+		}
+
+		// Tiered shedding: priority 0 packets are dropped above the watermark, priority 1 above twice the watermark,
+		// and priority 2 above four times the watermark
+		if(backlog>=(uint64_t) m_opts.shed_watermark && backlog>=((uint64_t) m_opts.shed_watermark << shed_priority(dgram.data,dgram.len))) {
+			m_ratelimiter->countOverloadShed(dgram.src_addr,now_ns);
+			m_stats.overload_shed++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Passed to relayDatagram() when quadkeys are disabled
+static const pipeline_geo_t no_geo={};
+
+void relayerPipeline::decodeCoordinates(size_t idx, const rx_datagram_t &dgram) {
+	if(idx>=m_geo.size()) {
+		m_geo.resize(idx+1);
+	}
+
+	pipeline_geo_t &geo=m_geo[idx];
+
+	geo.decoded=m_coord_decoder(dgram.data,dgram.len,m_opts.coord_format,geo.coords);
+	// Unavailable and out of range coordinates are never projected
+	geo.status=geo.decoded ? coord_validate(geo.coords,m_coord_sentinels) : COORD_UNAVAILABLE;
+	geo.valid=geo.decoded && geo.status==COORD_VALID;
+}
+
+void relayerPipeline::computeTiles(size_t count) {
+	size_t npoints=0;
+
+	// Each packet needs at most two points (the corners of its tile cache cell)
+	m_geo_lat.resize(2*count);
+	m_geo_lon.resize(2*count);
+	m_geo_tile_x.resize(2*count);
+	m_geo_tile_y.resize(2*count);
+
+	// Only the packets with valid coordinates, and not found in the tile cache, are passed to the batch computation
+	for(size_t i=0;i<count;i++) {
+		pipeline_geo_t &geo=m_geo[i];
+
+		geo.batch_points=0;
+		if(geo.valid==false) {
+			continue;
+		}
+
+		if(m_tile_cache!=NULL && geo.coords.has_int==true) {
+			tilecache_result_t result=m_tile_cache->lookup(geo.coords.lat_int,geo.coords.lon_int,geo.tile_x,geo.tile_y);
+
+			if(result==TILECACHE_HIT) {
+				continue;
+			} else if(result==TILECACHE_MISS) {
+				m_tile_cache->getCellCorners(geo.coords.lat_int,geo.coords.lon_int,m_geo_lat[npoints],m_geo_lon[npoints],m_geo_lat[npoints+1],m_geo_lon[npoints+1]);
+				geo.batch_points=2;
+				npoints+=2;
+				continue;
+			}
+		}
+
+		m_geo_lat[npoints]=geo.coords.lat;
+		m_geo_lon[npoints]=geo.coords.lon;
+		geo.batch_points=1;
+		npoints++;
+	}
+
+	m_tilesys.LatLonToTileXYBatch(m_geo_lat.data(),m_geo_lon.data(),npoints,m_geo_tile_x.data(),m_geo_tile_y.data());
+
+	npoints=0;
+	for(size_t i=0;i<count;i++) {
+		pipeline_geo_t &geo=m_geo[i];
+
+		if(geo.batch_points==1) {
+			geo.tile_x=m_geo_tile_x[npoints];
+			geo.tile_y=m_geo_tile_y[npoints];
+		} else if(geo.batch_points==2) {
+			// Cache miss: the tile of the corners is the tile of the whole cell, unless the cell straddles a tile edge
+			// (the tile of the point is then computed on its own)
+			if(m_tile_cache->insert(geo.coords.lat_int,geo.coords.lon_int,m_geo_tile_x[npoints],m_geo_tile_y[npoints],m_geo_tile_x[npoints+1],m_geo_tile_y[npoints+1])) {
+				geo.tile_x=m_geo_tile_x[npoints];
+				geo.tile_y=m_geo_tile_y[npoints];
+			} else {
+				m_tilesys.LatLonToTileXY(geo.coords.lat,geo.coords.lon,geo.tile_x,geo.tile_y);
+			}
+		}
+		npoints+=geo.batch_points;
+	}
+}
+
+void relayerPipeline::relayShmRecords(pipeline_endpoint_t &endpoint) {
+	int nrecords=endpoint.shm->receive(m_opts.max_msg_size);
+
+	if(m_opts.quadk_enable==true && nrecords>0) {
+		for(int i=0;i<nrecords;i++) {
+			decodeCoordinates(i,endpoint.shm->getDatagram(i));
+		}
+		if((m_opts.spatial_keys & SPATIAL_KEYS_QUADKEY) || m_station_index!=NULL || m_heatmap!=NULL) {
+			computeTiles(nrecords);
+		}
+	}
+
+	for(int i=0;i<nrecords;i++) {
+		relayDatagram(endpoint.shm->getDatagram(i),endpoint,m_opts.quadk_enable==true ? m_geo[i] : no_geo);
+	}
+
+	// The records are copied into the AMQP messages by relayDatagram(): their space can be given back to the producers
+	endpoint.shm->release();
+}
+
+void relayerPipeline::addSourceProperties(proton::message &msg, const struct sockaddr_storage &src_addr, uint64_t rx_ts_ns) {
+	if(src_addr.ss_family==AF_UNIX || src_addr.ss_family==AF_UNSPEC) {
+		// Local source: socket path of the sender (empty if unbound) or "pid:<pid>" for shared-memory producers
+		const char *src_path=((const struct sockaddr_un *) &src_addr)->sun_path;
+		size_t src_path_len=src_addr.ss_family==AF_UNIX ? strnlen(src_path,sizeof(((const struct sockaddr_un *) &src_addr)->sun_path)) : 0;
+
+		if(m_opts.src_props==SRC_PROPS_TEXT) {
+			msg.properties().put("src", std::string(src_path,src_path_len));
+		} else {
+			msg.properties().put("src_addr", proton::binary(src_path,src_path+src_path_len));
+		}
+	} else if(m_opts.src_props==SRC_PROPS_TEXT) {
+		char src_str[ADDR_FORMAT_MAXLEN];
+		size_t src_len=addr_format_sockaddr(src_str,(const struct sockaddr *) &src_addr);
+
+		msg.properties().put("src", std::string(src_str,src_len));
+	} else {
+		const uint8_t *addr_bytes;
+		size_t addr_len;
+		uint16_t port;
+
+		if(src_addr.ss_family==AF_INET6) {
+			const struct sockaddr_in6 *src_addr_in6=(const struct sockaddr_in6 *) &src_addr;
+
+			// IPv4 packets received on dual-stack sockets are relayed with their 4 bytes IPv4 address
+			if(addr_is_v4mapped(src_addr_in6)) {
+				addr_bytes=&src_addr_in6->sin6_addr.s6_addr[12];
+				addr_len=4;
+			} else {
+				addr_bytes=src_addr_in6->sin6_addr.s6_addr;
+				addr_len=16;
+			}
+			port=ntohs(src_addr_in6->sin6_port);
+		} else {
+			const struct sockaddr_in *src_addr_in=(const struct sockaddr_in *) &src_addr;
+
+			addr_bytes=(const uint8_t *) &src_addr_in->sin_addr.s_addr;
+			addr_len=4;
+			port=ntohs(src_addr_in->sin_port);
+		}
+
+		msg.properties().put("src_addr", proton::binary(addr_bytes,addr_bytes+addr_len));
+		msg.properties().put("src_port", port);
+	}
+
+	// Fall back to the current time if the kernel did not provide any receive timestamp
+	if(rx_ts_ns==0) {
+		struct timespec rx_ts;
+
+		clock_gettime(CLOCK_REALTIME,&rx_ts);
+		rx_ts_ns=(uint64_t) rx_ts.tv_sec*SEC_TO_NANOSEC+rx_ts.tv_nsec;
+	}
+
+	msg.properties().put("rx_ts_ns", rx_ts_ns);
+}
+
+void relayerPipeline::receiveAndRelay(udpRxBatch &rx_batch, size_t ep_idx) {
+	pipeline_endpoint_t &endpoint=m_endpoints[ep_idx];
+	int nmsgs=rx_batch.receive(endpoint.sfd,m_opts.max_msg_size,endpoint.gro_enabled);
+
+	if(m_opts.quadk_enable==true && nmsgs>0) {
+		for(int i=0;i<nmsgs;i++) {
+			decodeCoordinates(i,rx_batch.getDatagram(i));
+		}
+		if((m_opts.spatial_keys & SPATIAL_KEYS_QUADKEY) || m_station_index!=NULL || m_heatmap!=NULL) {
+			computeTiles(nmsgs);
+		}
+	}
+
+	for(int i=0;i<nmsgs;i++) {
+		relayDatagram(rx_batch.getDatagram(i),endpoint,m_opts.quadk_enable==true ? m_geo[i] : no_geo);
+	}
+}
+
+// Hash of the source address and port of a packet, used to always select the same AMQP connection for the same source
+static uint32_t source_hash(const struct sockaddr_storage &src_addr) {
+	const uint8_t *addr_bytes;
+	size_t addr_len;
+	uint32_t hash=2166136261U;
+
+	if(src_addr.ss_family==AF_INET6) {
+		addr_bytes=(const uint8_t *) &((const struct sockaddr_in6 *) &src_addr)->sin6_addr;
+		addr_len=sizeof(struct in6_addr);
+		hash^=((const struct sockaddr_in6 *) &src_addr)->sin6_port;
+	} else if(src_addr.ss_family==AF_UNIX) {
+		addr_bytes=(const uint8_t *) ((const struct sockaddr_un *) &src_addr)->sun_path;
+		addr_len=strnlen(((const struct sockaddr_un *) &src_addr)->sun_path,sizeof(((const struct sockaddr_un *) &src_addr)->sun_path));
+	} else if(src_addr.ss_family==AF_UNSPEC) {
+		addr_bytes=NULL;
+		addr_len=0;
+	} else {
+		addr_bytes=(const uint8_t *) &((const struct sockaddr_in *) &src_addr)->sin_addr;
+		addr_len=sizeof(struct in_addr);
+		hash^=((const struct sockaddr_in *) &src_addr)->sin_port;
+	}
+
+	// FNV-1a
+	for(size_t i=0;i<addr_len;i++) {
+		hash=(hash^addr_bytes[i])*16777619U;
+	}
+
+	return hash;
+}
+
+void relayerPipeline::relayDatagram(rx_datagram_t &dgram, pipeline_endpoint_t &endpoint, const pipeline_geo_t &geo) {
+	uint8_t *buffer=dgram.data;
+	int recv_bytes=dgram.len;
+
+	m_stats.received++;
+
+	if(dgram.gro_segment==true) {
+		m_stats.gro_segments++;
+	}
+
+	// Packets larger than the maximum message size are either dropped or relayed truncated
+	if(dgram.truncated==true) {
+		m_stats.truncated++;
+
+		if(m_opts.drop_truncated==true) {
+			return;
+		}
+	}
+
+	// Discard all the received messages with a message size smaller than minimum_msg_size bytes
+	if(recv_bytes < m_opts.minimum_msg_size) {
+		m_stats.too_small++;
+		return;
+	}
+
+	if(m_ratelimiter!=NULL && shedPacket(dgram)) {
+		return;
+	}
+
+	// Drop the copies of the same payload received (e.g., through different RSUs) during the dedup window
+	if(m_dedup!=NULL && m_dedup->isDuplicate(buffer,recv_bytes)) {
+		m_stats.duplicates++;
+		return;
+	}
+
+	proton::message msg;
+	bool dead_letter=false;
+
+	if(m_opts.quadk_enable==true) {
+		const coord_decoded_t &coords=geo.coords;
+
+		if(!geo.decoded) {
+			m_stats.too_small++;
+			return;
+		}
+
+		if(geo.valid==false) {
+			if(geo.status==COORD_OUT_OF_RANGE) {
+				m_stats.coord_out_of_range++;
+			} else {
+				m_stats.coord_unavailable++;
+			}
+
+			if(m_opts.coord_invalid==COORD_INVALID_DROP) {
+				m_stats.coord_dropped++;
+				return;
+			}
+
+			if(m_opts.coord_invalid==COORD_INVALID_DEAD_LETTER) {
+				msg.properties().put("coord_error", std::string(geo.status==COORD_OUT_OF_RANGE ? "out_of_range" : "unavailable"));
+				dead_letter=true;
+			} else {
+				m_stats.coord_invalid++;
+			}
+		}
+
+		if(geo.valid==true) {
+			// Single projection of the position, shared by all the encoders
+			spatial_point_t point;
+
+			point.lat=coords.lat;
+			point.lon=coords.lon;
+			point.tile_x=geo.tile_x;
+			point.tile_y=geo.tile_y;
+			point.tile_level=m_tilesys.getLevelOfDetail();
+			if(m_adaptive_lod!=NULL) {
+				// Tile of the adaptive partition containing the position
+				unsigned int level=m_adaptive_lod->classify(geo.tile_x,geo.tile_y);
+
+				point.tile_x>>=point.tile_level-level;
+				point.tile_y>>=point.tile_level-level;
+				point.tile_level=level;
+			}
+			point.morton=(m_opts.spatial_keys & (SPATIAL_KEYS_GEOHASH | SPATIAL_KEYS_MORTON)) ? spatial_morton(coords.lat,coords.lon) : 0;
+
+			for(spatial_key_encoder_fn encoder : m_key_encoders) {
+				encoder(point,m_opts,msg);
+			}
+
+			// The heatmap counts the received traffic (after the rate limiting and the deduplication), including the
+			// messages later replaced by the conflation or dropped as their priority lane is full
+			if(m_heatmap!=NULL) {
+				m_heatmap->add(geo.tile_x,geo.tile_y,recv_bytes);
+			}
+
+			if(m_station_index!=NULL && coords.has_ids==true) {
+				uint64_t ts_ns=dgram.rx_ts_ns;
+
+				if(ts_ns==0) {
+					struct timespec now;
+
+					clock_gettime(CLOCK_REALTIME_COARSE,&now);
+					ts_ns=(uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec;
+				}
+				m_station_index->update(coords.station_id,coords.lat,coords.lon,geo.tile_x,geo.tile_y,ts_ns);
+			}
+		}
+
+		if(coords.has_ids==true) {
+			msg.properties().put("station_id", coords.station_id);
+			msg.properties().put("message_id", coords.message_id);
+		}
+
+		if(coords.strip_len==0) {
+			msg.body(proton::binary(buffer,buffer+recv_bytes));
+		} else if(coords.strip_offset==0) {
+			msg.body(proton::binary(buffer+coords.strip_len,buffer+recv_bytes));
+		} else {
+			// Coordinates in the middle of the payload: relay what comes before and after them
+			proton::binary body;
+
+			body.reserve(recv_bytes-coords.strip_len);
+			body.insert(body.end(),buffer,buffer+coords.strip_offset);
+			body.insert(body.end(),buffer+coords.strip_offset+coords.strip_len,buffer+recv_bytes);
+			msg.body(body);
+		}
+	} else {
+		msg.body(proton::binary(buffer,buffer+recv_bytes));
+	}
+
+	if(m_opts.src_props!=SRC_PROPS_NONE) {
+		addSourceProperties(msg,dgram.src_addr,dgram.rx_ts_ns);
+	}
+
+	if(!endpoint.ep.tag.empty()) {
+		msg.properties().put("listen_tag", endpoint.ep.tag);
+	}
+
+	// Select the AMQP connection depending on the source address and port (the same source is always relayed over the same connection)
+	size_t conn_idx=0;
+
+	if(m_relayers.size()>1) {
+		conn_idx=source_hash(dgram.src_addr) % m_relayers.size();
+	}
+
+	// Select the priority lane (the last one, i.e., the lowest priority, if no rule matches)
+	int lane=0;
+
+	if(m_opts.priority_lanes>1) {
+		lane=lane_classify(m_opts.lane_rules,m_opts.priority_lanes-1,dgram.data,dgram.len,dgram.src_addr,endpoint.dst_port);
+	}
+
+	// Dead letters are never conflated, so that all of them can be inspected
+	if(dead_letter==true) {
+		m_stats.coord_dead_letter++;
+		sendMessage(msg,conn_idx,m_dead_letter_idx[conn_idx],lane);
+		return;
+	}
+
+	// With conflation, only the newest message of each key is relayed at the end of the conflation interval
+	if(m_conflation!=NULL && conflateMessage(msg,dgram,conn_idx,endpoint.sender_idx[conn_idx],lane)) {
+		return;
+	}
+
+	sendMessage(msg,conn_idx,endpoint.sender_idx[conn_idx],lane);
+}
+
+void relayerPipeline::printStats(void) {
+	std::cout << "[" << m_opts.name << "] Received packets: " << m_stats.received << " - Relayed: " << m_stats.relayed <<
+		" - Larger than " << m_opts.max_msg_size << " bytes: " << m_stats.truncated << (m_opts.drop_truncated ? " (dropped)" : " (relayed truncated)") <<
+		" - Too small: " << m_stats.too_small << " - Not queued by the AMQP client: " << m_stats.send_failed;
+
+	if(m_opts.udp_gro==true) {
+		std::cout << " - Split from GRO buffers: " << m_stats.gro_segments;
+	}
+
+	if(m_opts.quadk_enable==true) {
+		std::cout << " - Coordinates not available: " << m_stats.coord_unavailable << " - Out of range: " << m_stats.coord_out_of_range <<
+			" (relayed without quadkeys: " << m_stats.coord_invalid << ", dropped: " << m_stats.coord_dropped << ", dead-lettered: " << m_stats.coord_dead_letter << ")";
+	}
+
+	if(m_station_index!=NULL) {
+		std::cout << " - Indexed stations: " << m_station_index->getCount() << " (queries: " << m_station_index->getQueries() << ")";
+	}
+
+	if(m_heatmap!=NULL) {
+		std::cout << " - Heatmap: " << m_heatmap->getTiles() << " tiles of level " << m_heatmap->getLevel() << " in the current interval (untracked messages: " <<
+			m_heatmap->getUntracked() << ", snapshots written: " << m_heatmap->getSnapshots() << ", memory: " << m_heatmap->getMemoryUsage()/1024 << " KiB)";
+	}
+
+	if(m_adaptive_lod!=NULL) {
+		std::cout << " - Adaptive quadkeys: " << m_adaptive_lod->getSplitTiles() << " split tiles (splits: " << m_adaptive_lod->getSplits() <<
+			", merges: " << m_adaptive_lod->getMerges() << ", refused as partition full: " << m_adaptive_lod->getRefused() << ")";
+	}
+
+	if(m_tile_cache!=NULL) {
+		uint64_t lookups=m_tile_cache->getLookups();
+
+		std::cout << " - Tile cache hit ratio: " << (lookups>0 ? 100.0*m_tile_cache->getHits()/lookups : 0.0) << "% (lookups: " << lookups <<
+			", straddling cells: " << m_tile_cache->getStraddles() << ", cell size: " << m_tile_cache->getCellSize() << " units, memory: " <<
+			m_tile_cache->getMemoryUsage()/1024 << " KiB)";
+	}
+
+	if(m_conflation!=NULL) {
+		std::cout << " - Conflated: " << m_stats.conflated << " (conflation table full: " << m_stats.conflation_full << ")";
+	}
+
+	if(m_dedup!=NULL) {
+		uint64_t lookups=m_dedup->getLookups();
+
+		std::cout << " - Duplicates dropped: " << m_stats.duplicates << " (hit ratio: " << (lookups>0 ? 100.0*m_dedup->getHits()/lookups : 0.0) <<
+			"%, dedup set full: " << m_dedup->getFull() << ", memory: " << m_dedup->getMemoryUsage()/1024 << " KiB)";
+	}
+
+	if(m_opts.priority_lanes>1) {
+		std::cout << " - Relayed per priority lane:";
+		for(int lane=0;lane<m_opts.priority_lanes;lane++) {
+			std::cout << (lane>0 ? " /" : "") << " " << m_stats.lane_relayed[lane];
+		}
+		std::cout << " (dropped as lane full: " << m_stats.lane_full << ")";
+	}
+
+	if(m_ratelimiter!=NULL) {
+		std::vector<ratelimit_source_report_t> top_sources;
+
+		std::cout << " - Rate limited: " << m_stats.rate_limited << " - Shed on overload: " << m_stats.overload_shed <<
+			" (untracked sources: " << m_ratelimiter->getUntracked() << ")";
+
+		m_ratelimiter->getTopShed(10,top_sources);
+		for(const ratelimit_source_report_t &report : top_sources) {
+			std::cout << std::endl << "[" << m_opts.name << "]   Source " << report.source << ": accepted " << report.passed <<
+				" - rate limited " << report.shed_rate << " - shed on overload " << report.shed_overload;
+		}
+	}
+
+	std::cout << std::endl;
+}
@@ -0,0 +1,307 @@
+#include <cmath>
+#include <cstring>
+#include "quadkey_ts_simple.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define QUADKEY_BATCH_X86 1
+
+// The kernel template below is always inlined into functions compiled for AVX2 or AVX-512, so no vector is ever
+// passed with the non-AVX ABI
+#pragma GCC diagnostic ignored "-Wpsabi"
+// Some versions of GCC report false positives inside the AVX-512 intrinsics (built on top of _mm512_undefined_pd())
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Batch (vectorized) computation of the tile coordinates of arrays of latitude/longitude pairs
+// The longitude path uses exactly the same IEEE 754 operations as LatLonToTileXY(), while the latitude path (the
+// Mercator projection, i.e., a sin() and a log()) uses polynomial approximations with an absolute error on the
+// projected y well below 1e-14: any tile Y coordinate falling within QUADKEY_BATCH_EDGE_EPS tiles of a tile edge, or
+// in the first/last tile row (where LatLonToTileXY() clips the coordinates), is recomputed with LatLonToTileXYExact(), so
+// that the results are always identical to the scalar ones
+
+// Number of coordinates processed by each call to the vectorized kernels
+#define QUADKEY_BATCH_CHUNK 256
+// Distance from a tile edge (in tiles) below which the exact scalar computation is used
+#define QUADKEY_BATCH_EDGE_EPS 1e-7
+// Latitudes beyond this value (in absolute value) always use the scalar computation
+#define QUADKEY_BATCH_MAX_LAT 85.1
+
+namespace QuadKeys
+{
+#ifdef QUADKEY_BATCH_X86
+	// Coefficients of the Taylor series of sin(x) (odd powers, from x^3 to x^23), accurate to better than 1e-18 for |x| <= 1.5
+	static const double sin_coeffs[]={
+		-1.0/6,1.0/120,-1.0/5040,1.0/362880,-1.0/39916800,1.0/6227020800.0,-1.0/1307674368000.0,
+		1.0/355687428096000.0,-1.0/121645100408832000.0,1.0/51090942171709440000.0,-1.0/25852016738884976640000.0
+	};
+	static const int sin_ncoeffs=sizeof(sin_coeffs)/sizeof(sin_coeffs[0]);
+
+	// ln(2), split in a high part (with the lower bits set to zero, so that e*ln2_hi is exact) and a low part
+	static const double ln2_hi=6.93147180369123816490e-01;
+	static const double ln2_lo=1.90821492927058770002e-10;
+
+	// Kernel common to AVX2 and AVX-512: "V" wraps the vector type and operations of the instruction set
+	template<typename V>
+	__attribute__((always_inline)) static inline void tile_xy_kernel(const double *lat, const double *lon, size_t n, int level, uint32_t *tileX, uint32_t *tileY, uint8_t *fallback) {
+		typedef typename V::vec vec;
+		const double mapSize=(double) ((unsigned int) 256 << level);
+		const double tiles=(double) (1U << level);
+
+		for(size_t i=0;i<n;i+=V::width) {
+			vec vlat=V::load(lat+i);
+			vec vlon=V::load(lon+i);
+
+			// x: same operations as LatLonToTileXY() (x*mapSize is exact, so the result does not change even if a
+			// multiply-add is used)
+			vec x=V::div(V::add(vlon,V::set(180)),V::set(360));
+			vec px=V::add(V::mul(x,V::set(mapSize)),V::set(0.5));
+			px=V::min(V::max(px,V::set(0)),V::set(mapSize-1));
+			vec tx=V::floor(V::mul(px,V::set(1.0/256)));
+
+			// sin(latitude*pi/180), with the argument computed as in LatLonToTileXY()
+			vec a=V::div(V::mul(vlat,V::set(M_PI)),V::set(180));
+			vec a2=V::mul(a,a);
+			vec p=V::set(sin_coeffs[sin_ncoeffs-1]);
+			for(int c=sin_ncoeffs-2;c>=0;c--) {
+				p=V::fmadd(p,a2,V::set(sin_coeffs[c]));
+			}
+			vec s=V::fmadd(V::mul(p,a2),a,a);
+
+			// log(q) = e*ln(2) + 2*atanh((m-1)/(m+1)), with q = m*2^e and sqrt(2)/2 <= m < sqrt(2)
+			vec q=V::div(V::add(V::set(1),s),V::sub(V::set(1),s));
+			vec e, m;
+			V::frexp(q,m,e);
+			vec big=V::gt(m,V::set(M_SQRT2));
+			m=V::blend(m,V::mul(m,V::set(0.5)),big);
+			e=V::blend(e,V::add(e,V::set(1)),big);
+
+			vec f=V::div(V::sub(m,V::set(1)),V::add(m,V::set(1)));
+			vec f2=V::mul(f,f);
+			vec t=V::set(1.0/23);
+			for(int k=21;k>=1;k-=2) {
+				t=V::fmadd(t,f2,V::set(1.0/k));
+			}
+			vec logm=V::mul(V::mul(V::set(2),f),t);
+			vec logq=V::add(V::mul(e,V::set(ln2_hi)),V::add(V::mul(e,V::set(ln2_lo)),logm));
+
+			vec y=V::sub(V::set(0.5),V::div(logq,V::set(4*M_PI)));
+			vec ty=V::mul(V::add(V::mul(y,V::set(mapSize)),V::set(0.5)),V::set(1.0/256));
+			vec fty=V::floor(ty);
+			vec frac=V::sub(ty,fty);
+
+			// Lanes for which the approximation may give a different tile: close to a tile edge, first/last tile row
+			// (clipping), latitudes out of range (including NaN) and non-finite longitudes (including NaN)
+			vec unsafe=V::lt(frac,V::set(QUADKEY_BATCH_EDGE_EPS));
+			unsafe=V::orv(unsafe,V::gt(frac,V::set(1-QUADKEY_BATCH_EDGE_EPS)));
+			unsafe=V::orv(unsafe,V::lt(fty,V::set(1)));
+			unsafe=V::orv(unsafe,V::ge(fty,V::set(tiles-1)));
+			unsafe=V::orv(unsafe,V::notle(V::abs(vlat),V::set(QUADKEY_BATCH_MAX_LAT)));
+			unsafe=V::orv(unsafe,V::notle(V::abs(vlon),V::set(1e300)));
+
+			V::store_u32(tileX+i,tx);
+			V::store_u32(tileY+i,V::blend(fty,V::set(0),unsafe));
+			V::store_mask(fallback+i,unsafe);
+		}
+	}
+
+	struct avx2_ops {
+		typedef __m256d vec;
+		static const size_t width=4;
+
+		static inline __attribute__((target("avx2,fma"))) vec load(const double *p) {return _mm256_loadu_pd(p);}
+		static inline __attribute__((target("avx2,fma"))) vec set(double v) {return _mm256_set1_pd(v);}
+		static inline __attribute__((target("avx2,fma"))) vec add(vec a, vec b) {return _mm256_add_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec sub(vec a, vec b) {return _mm256_sub_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec mul(vec a, vec b) {return _mm256_mul_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec div(vec a, vec b) {return _mm256_div_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec fmadd(vec a, vec b, vec c) {return _mm256_fmadd_pd(a,b,c);}
+		static inline __attribute__((target("avx2,fma"))) vec min(vec a, vec b) {return _mm256_min_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec max(vec a, vec b) {return _mm256_max_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec floor(vec a) {return _mm256_floor_pd(a);}
+		static inline __attribute__((target("avx2,fma"))) vec abs(vec a) {return _mm256_andnot_pd(_mm256_set1_pd(-0.0),a);}
+		// Comparisons return all-ones/all-zeros lanes
+		static inline __attribute__((target("avx2,fma"))) vec lt(vec a, vec b) {return _mm256_cmp_pd(a,b,_CMP_LT_OQ);}
+		static inline __attribute__((target("avx2,fma"))) vec gt(vec a, vec b) {return _mm256_cmp_pd(a,b,_CMP_GT_OQ);}
+		static inline __attribute__((target("avx2,fma"))) vec ge(vec a, vec b) {return _mm256_cmp_pd(a,b,_CMP_GE_OQ);}
+		static inline __attribute__((target("avx2,fma"))) vec notle(vec a, vec b) {return _mm256_cmp_pd(a,b,_CMP_NLE_UQ);}
+		static inline __attribute__((target("avx2,fma"))) vec orv(vec a, vec b) {return _mm256_or_pd(a,b);}
+		static inline __attribute__((target("avx2,fma"))) vec blend(vec a, vec b, vec mask) {return _mm256_blendv_pd(a,b,mask);}
+
+		// Split a (positive, normal) value into mantissa in [1,2) and exponent
+		static inline __attribute__((target("avx2,fma"))) void frexp(vec q, vec &m, vec &e) {
+			__m256i bits=_mm256_castpd_si256(q);
+			__m256i exp_bits=_mm256_srli_epi64(bits,52);
+
+			m=_mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits,_mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),_mm256_set1_epi64x(0x3FF0000000000000LL)));
+			// Exponent bits to double, through the 2^52 trick
+			e=_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(exp_bits,_mm256_set1_epi64x(0x4330000000000000LL))),_mm256_set1_pd(4503599627370496.0+1023));
+		}
+
+		static inline __attribute__((target("avx2,fma"))) void store_u32(uint32_t *p, vec v) {
+			_mm_storeu_si128((__m128i *) p,_mm256_cvttpd_epi32(v));
+		}
+
+		static inline __attribute__((target("avx2,fma"))) void store_mask(uint8_t *p, vec mask) {
+			int bits=_mm256_movemask_pd(mask);
+
+			for(size_t i=0;i<width;i++) {
+				p[i]=(bits >> i) & 1;
+			}
+		}
+	};
+
+	struct avx512_ops {
+		typedef __m512d vec;
+		static const size_t width=8;
+
+		static inline __attribute__((target("avx512f,avx512dq"))) vec load(const double *p) {return _mm512_loadu_pd(p);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec set(double v) {return _mm512_set1_pd(v);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec add(vec a, vec b) {return _mm512_add_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec sub(vec a, vec b) {return _mm512_sub_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec mul(vec a, vec b) {return _mm512_mul_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec div(vec a, vec b) {return _mm512_div_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec fmadd(vec a, vec b, vec c) {return _mm512_fmadd_pd(a,b,c);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec min(vec a, vec b) {return _mm512_min_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec max(vec a, vec b) {return _mm512_max_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec floor(vec a) {return _mm512_roundscale_pd(a,_MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec abs(vec a) {return _mm512_abs_pd(a);}
+		// Comparisons return all-ones/all-zeros lanes, to share the kernel with AVX2
+		static inline __attribute__((target("avx512f,avx512dq"))) vec fromMask(__mmask8 k) {return _mm512_castsi512_pd(_mm512_movm_epi64(k));}
+		static inline __attribute__((target("avx512f,avx512dq"))) __mmask8 toMask(vec a) {return _mm512_movepi64_mask(_mm512_castpd_si512(a));}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec lt(vec a, vec b) {return fromMask(_mm512_cmp_pd_mask(a,b,_CMP_LT_OQ));}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec gt(vec a, vec b) {return fromMask(_mm512_cmp_pd_mask(a,b,_CMP_GT_OQ));}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec ge(vec a, vec b) {return fromMask(_mm512_cmp_pd_mask(a,b,_CMP_GE_OQ));}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec notle(vec a, vec b) {return fromMask(_mm512_cmp_pd_mask(a,b,_CMP_NLE_UQ));}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec orv(vec a, vec b) {return _mm512_or_pd(a,b);}
+		static inline __attribute__((target("avx512f,avx512dq"))) vec blend(vec a, vec b, vec mask) {return _mm512_mask_blend_pd(toMask(mask),a,b);}
+
+		static inline __attribute__((target("avx512f,avx512dq"))) void frexp(vec q, vec &m, vec &e) {
+			m=_mm512_getmant_pd(q,_MM_MANT_NORM_1_2,_MM_MANT_SIGN_zero);
+			e=_mm512_getexp_pd(q);
+		}
+
+		static inline __attribute__((target("avx512f,avx512dq"))) void store_u32(uint32_t *p, vec v) {
+			_mm256_storeu_si256((__m256i *) p,_mm512_cvttpd_epi32(v));
+		}
+
+		static inline __attribute__((target("avx512f,avx512dq"))) void store_mask(uint8_t *p, vec mask) {
+			__mmask8 bits=toMask(mask);
+
+			for(size_t i=0;i<width;i++) {
+				p[i]=(bits >> i) & 1;
+			}
+		}
+	};
+
+	__attribute__((target("avx2,fma")))
+	static void tile_xy_avx2(const double *lat, const double *lon, size_t n, int level, uint32_t *tileX, uint32_t *tileY, uint8_t *fallback) {
+		tile_xy_kernel<avx2_ops>(lat,lon,n,level,tileX,tileY,fallback);
+	}
+
+	__attribute__((target("avx512f,avx512dq")))
+	static void tile_xy_avx512(const double *lat, const double *lon, size_t n, int level, uint32_t *tileX, uint32_t *tileY, uint8_t *fallback) {
+		tile_xy_kernel<avx512_ops>(lat,lon,n,level,tileX,tileY,fallback);
+	}
+#endif
+
+	typedef void (*tile_xy_kernel_fn)(const double *, const double *, size_t, int, uint32_t *, uint32_t *, uint8_t *);
+
+	typedef struct _batch_kernel {
+		tile_xy_kernel_fn fn;                // NULL = scalar only
+		const char *name;
+	} batch_kernel_t;
+
+	// Kernel of the instruction set "name", returning false if it is not supported by the CPU
+	static bool find_kernel(const char *name, batch_kernel_t &kernel) {
+		if(strcmp(name,"scalar")==0) {
+			kernel.fn=NULL;
+			kernel.name="scalar";
+			return true;
+		}
+
+#ifdef QUADKEY_BATCH_X86
+		__builtin_cpu_init();
+
+		if(strcmp(name,"avx512")==0 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+			kernel.fn=tile_xy_avx512;
+			kernel.name="avx512";
+			return true;
+		}
+
+		if(strcmp(name,"avx2")==0 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+			kernel.fn=tile_xy_avx2;
+			kernel.name="avx2";
+			return true;
+		}
+#endif
+
+		return false;
+	}
+
+	// Select the kernel once, depending on the instruction sets supported by the CPU
+	static batch_kernel_t select_kernel(void) {
+		batch_kernel_t kernel;
+
+		if(!find_kernel("avx512",kernel) && !find_kernel("avx2",kernel)) {
+			find_kernel("scalar",kernel);
+		}
+
+		return kernel;
+	}
+
+	static batch_kernel_t &current_kernel(void) {
+		static batch_kernel_t kernel=select_kernel();
+
+		return kernel;
+	}
+
+	const char *
+	QuadKeyTSSimple::getBatchImplementation(void) {
+		return current_kernel().name;
+	}
+
+	bool
+	QuadKeyTSSimple::setBatchImplementation(const char *name) {
+		return find_kernel(name,current_kernel());
+	}
+
+	void
+	QuadKeyTSSimple::LatLonToTileXYBatch(const double *lat, const double *lon, size_t n, uint32_t *tileX, uint32_t *tileY) {
+		tile_xy_kernel_fn kernel=current_kernel().fn;
+		// The kernels process whole vectors (of 4 or 8 elements): the remaining elements are computed by the scalar code
+		size_t nvec=kernel!=NULL ? n & ~(size_t) 7 : 0;
+		uint8_t fallback[QUADKEY_BATCH_CHUNK];
+
+		for(size_t i=0;i<nvec;i+=QUADKEY_BATCH_CHUNK) {
+			size_t chunk=std::min((size_t) QUADKEY_BATCH_CHUNK,nvec-i);
+
+			kernel(lat+i,lon+i,chunk,m_levelOfDetail,tileX+i,tileY+i,fallback);
+
+			for(size_t j=0;j<chunk;j++) {
+				if(fallback[j]) {
+					LatLonToTileXYExact(lat[i+j],lon[i+j],tileX[i+j],tileY[i+j]);
+				}
+			}
+		}
+
+		for(size_t i=nvec;i<n;i++) {
+			LatLonToTileXY(lat[i],lon[i],tileX[i],tileY[i]);
+		}
+	}
+
+	void
+	QuadKeyTSSimple::LatLonToQuadKeyULongBatch(const double *lat, const double *lon, size_t n, uint64_t *quadKeys) {
+		uint32_t tileX[QUADKEY_BATCH_CHUNK], tileY[QUADKEY_BATCH_CHUNK];
+
+		for(size_t i=0;i<n;i+=QUADKEY_BATCH_CHUNK) {
+			size_t chunk=std::min((size_t) QUADKEY_BATCH_CHUNK,n-i);
+
+			LatLonToTileXYBatch(lat+i,lon+i,chunk,tileX,tileY);
+
+			for(size_t j=0;j<chunk;j++) {
+				quadKeys[i+j]=quadkey_ulong_encode(tileX[j],tileY[j],m_levelOfDetail);
+			}
+		}
+	}
+}
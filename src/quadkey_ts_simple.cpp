@@ -6,6 +6,17 @@
 #include <numeric>
 #include "quadkey_ts_simple.h"
 
+// Fast Mercator projection: the projected y of each latitude is obtained by cubic Hermite interpolation over a table
+// with a node every 1/MERCATOR_NODES_PER_DEGREE degrees, and each cell of the table stores a bound of the
+// interpolation error; when the interpolated y falls within the error bound of a tile edge, the exact formula is used,
+// so that the resulting tile is always the same as the one of LatLonToTileXYExact()
+#define MERCATOR_NODES_PER_DEGREE 8
+// Latitudes beyond this value (in absolute value) always use the exact formula
+#define MERCATOR_MAX_LAT 85
+#define MERCATOR_CELLS (2 * MERCATOR_MAX_LAT * MERCATOR_NODES_PER_DEGREE)
+// Absolute error on y covering the rounding errors of both the exact formula and the interpolation
+#define MERCATOR_ROUNDING_SLACK 1e-13
+
 namespace QuadKeys
 {
 	QuadKeyTSSimple::QuadKeyTSSimple() {
@@ -35,24 +46,113 @@ namespace QuadKeys
 		}
 	}
 
-	std::string
-	QuadKeyTSSimple::LatLonToQuadKey(double latitude, double longitude) {
-		std::stringstream quadKey;
-		// int levelOfDetail = ...; // The value of the desired zoom is obtained directly from the private attribute
+	typedef struct _mercator_cell {
+		double c[4];                         // y = c[0] + c[1]*t + c[2]*t^2 + c[3]*t^3, with t in [0,1] inside the cell
+		double err;                          // Bound of |interpolated y - exact y| inside the cell
+	} mercator_cell_t;
 
-		double x = (longitude + 180) / 360;
+	static double mercator_y(double latitude) {
 		double sinLatitude = sin(latitude * M_PI / 180);
-		double y = 0.5 - log((1 + sinLatitude) / (1 - sinLatitude)) / (4 * M_PI);
+		return 0.5 - log((1 + sinLatitude) / (1 - sinLatitude)) / (4 * M_PI);
+	}
+
+	static const mercator_cell_t *mercator_table(void) {
+		static mercator_cell_t cells[MERCATOR_CELLS];
+		static bool ready = [] {
+			const double h = 1.0 / MERCATOR_NODES_PER_DEGREE;
+			const double h_rad = h * M_PI / 180;
+
+			for (int i = 0; i < MERCATOR_CELLS; i++) {
+				double lat0 = -MERCATOR_MAX_LAT + i * h;
+				double lat1 = lat0 + h;
+				double y0 = mercator_y(lat0), y1 = mercator_y(lat1);
+				// dy/dlatitude = -sec(latitude)/360, scaled to the cell width
+				double d0 = -h / (360 * cos(lat0 * M_PI / 180));
+				double d1 = -h / (360 * cos(lat1 * M_PI / 180));
+
+				cells[i].c[0] = y0;
+				cells[i].c[1] = d0;
+				cells[i].c[2] = 3 * (y1 - y0) - 2 * d0 - d1;
+				cells[i].c[3] = 2 * (y0 - y1) + d0 + d1;
+
+				// Hermite interpolation error: h^4/384 * max|y|, with y = -sec*tan*(6*sec^2-1)/(2*pi) (per radian),
+				// whose absolute value grows with the absolute value of the latitude
+				double phi = std::max(fabs(lat0), fabs(lat1)) * M_PI / 180;
+				double sec = 1 / cos(phi);
+				double d4 = sec * tan(phi) * (6 * sec * sec - 1) / (2 * M_PI);
+				cells[i].err = 2 * (pow(h_rad, 4) / 384 * d4) + MERCATOR_ROUNDING_SLACK;
+			}
+
+			return true;
+		}();
+
+		(void) ready;
+		return cells;
+	}
+
+	void
+	QuadKeyTSSimple::LatLonToTileXY(double latitude, double longitude, uint32_t &tileX, uint32_t &tileY) {
+		// Also false for NaN latitudes
+		if (!(fabs(latitude) < MERCATOR_MAX_LAT)) {
+			LatLonToTileXYExact(latitude, longitude, tileX, tileY);
+			return;
+		}
+
+		double x = (longitude + 180) / 360;
+		double cellPos = (latitude + MERCATOR_MAX_LAT) * MERCATOR_NODES_PER_DEGREE;
+		int cellIdx = std::min((int) cellPos, MERCATOR_CELLS - 1);
+		const mercator_cell_t &cell = mercator_table()[cellIdx];
+		double t = cellPos - cellIdx;
+		double y = cell.c[0] + t * (cell.c[1] + t * (cell.c[2] + t * cell.c[3]));
+
+		uint mapSize = MapSize(m_levelOfDetail);
+		uint32_t tiles = 1U << m_levelOfDetail;
+		double ty = (y * mapSize + 0.5) / 256;
+		// y is always between 0 and 1 here: truncating the positive ty is the same as flooring it (without a call to floor())
+		uint32_t row = (uint32_t) ty;
+		double frac = ty - row;
+		double margin = cell.err * tiles;
+
+		// Close to a tile edge, or in the first/last tile row (where the pixel coordinates may be clipped)
+		if (frac < margin || frac > 1 - margin || row < 1 || row >= tiles - 1) {
+			LatLonToTileXYExact(latitude, longitude, tileX, tileY);
+			return;
+		}
+
+		int pixelX = (int) Clip(x * mapSize + 0.5, 0, mapSize - 1);
+		tileX = pixelX / 256;
+		tileY = row;
+	}
+
+	void
+	QuadKeyTSSimple::LatLonToTileXYExact(double latitude, double longitude, uint32_t &tileX, uint32_t &tileY) {
+		double x = (longitude + 180) / 360;
+		double y = mercator_y(latitude);
 
 		uint mapSize = MapSize(m_levelOfDetail);
 		int pixelX = (int) Clip(x * mapSize + 0.5, 0, mapSize - 1);
 		int pixelY = (int) Clip(y * mapSize + 0.5, 0, mapSize - 1);
-		int tileX =  pixelX / 256;
-		int tileY =  pixelY / 256;
+		tileX =  pixelX / 256;
+		tileY =  pixelY / 256;
+	}
+
+	std::string
+	QuadKeyTSSimple::LatLonToQuadKey(double latitude, double longitude) {
+		uint32_t tileX, tileY;
+		// int levelOfDetail = ...; // The value of the desired zoom is obtained directly from the private attribute
+
+		LatLonToTileXY(latitude, longitude, tileX, tileY);
+
+		return TileXYToQuadKey(tileX, tileY);
+	}
+
+	std::string
+	QuadKeyTSSimple::TileXYToQuadKey(uint32_t tileX, uint32_t tileY) {
+		char quadKey[QUADKEY_MAX_LEVEL + 1];
 
 		for (int i = m_levelOfDetail; i > 0; i--) {
 			char digit = '0';
-			int mask = 1 << (i - 1);
+			uint32_t mask = 1 << (i - 1);
 			if ((tileX & mask) != 0)
 			{
 				digit++;
@@ -62,10 +162,19 @@ namespace QuadKeys
 				digit++;
 				digit++;
 			}
-			quadKey << digit;
+			quadKey[m_levelOfDetail - i] = digit;
 		}
 
-		return quadKey.str();
+		return std::string(quadKey, m_levelOfDetail);
+	}
+
+	uint64_t
+	QuadKeyTSSimple::LatLonToQuadKeyULong(double latitude, double longitude) {
+		uint32_t tileX, tileY;
+
+		LatLonToTileXY(latitude, longitude, tileX, tileY);
+
+		return quadkey_ulong_encode(tileX, tileY, m_levelOfDetail);
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstring>
+#include <sys/un.h>
+
+#include "ratelimit.h"
+#include "addr_format.h"
+#include "timers.h"
+
+bool parse_ratelimit_key_mode(const std::string &name, ratelimit_key_mode_t &mode) {
+	if(name=="ip") {
+		mode=RATELIMIT_BY_IP;
+	} else if(name=="ip-port") {
+		mode=RATELIMIT_BY_IP_PORT;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+sourceRateLimiter::sourceRateLimiter(double rate, double burst, size_t slots, ratelimit_key_mode_t key_mode) :
+	m_used(0), m_key_mode(key_mode), m_untracked(0), m_last_expire_ns(0) {
+	size_t size=hashtable_size(slots);
+
+	m_slots.resize(size);
+	for(ratelimit_slot_t &slot : m_slots) {
+		slot.used=false;
+	}
+
+	m_mask=size-1;
+	m_max_used=hashtable_max_used(size);
+
+	m_rate=rate/1e9;
+	m_burst=burst>=1.0 ? burst : 1.0;
+}
+
+// Merge the reports of the same source and sort them in decreasing order of dropped packets, keeping at most "max" of them
+static void merge_reports(std::vector<ratelimit_source_report_t> &reports, size_t max) {
+	std::sort(reports.begin(),reports.end(),[](const ratelimit_source_report_t &a, const ratelimit_source_report_t &b) {
+		return a.source<b.source;
+	});
+
+	size_t merged=0;
+
+	for(size_t i=0;i<reports.size();i++) {
+		if(merged>0 && reports[merged-1].source==reports[i].source) {
+			reports[merged-1].passed+=reports[i].passed;
+			reports[merged-1].shed_rate+=reports[i].shed_rate;
+			reports[merged-1].shed_overload+=reports[i].shed_overload;
+		} else {
+			reports[merged++]=reports[i];
+		}
+	}
+	reports.resize(merged);
+
+	std::sort(reports.begin(),reports.end(),[](const ratelimit_source_report_t &a, const ratelimit_source_report_t &b) {
+		return a.shed_rate+a.shed_overload>b.shed_rate+b.shed_overload;
+	});
+
+	if(reports.size()>max) {
+		reports.resize(max);
+	}
+}
+
+// Idleness depends only on the activity of the source, not on what it dropped in the past (otherwise a source which
+// was shed even once would pin its slot forever)
+bool sourceRateLimiter::isIdle(const ratelimit_slot_t &slot, uint64_t now_ns) {
+	return now_ns-slot.seen_ns>=(uint64_t) RATELIMIT_IDLE_SEC*SEC_TO_NANOSEC && (m_rate==0 || slot.tokens+(now_ns-slot.last_ns)*m_rate>=m_burst);
+}
+
+void sourceRateLimiter::expireIdle(uint64_t now_ns) {
+	std::vector<ratelimit_slot_t> kept;
+
+	// Rebuild the table with the non-idle sources only (the slots cannot simply be emptied, as that would break the probe sequences)
+	for(const ratelimit_slot_t &slot : m_slots) {
+		if(!slot.used) {
+			continue;
+		}
+
+		if(!isIdle(slot,now_ns)) {
+			kept.push_back(slot);
+		} else if(slot.shed_rate>0 || slot.shed_overload>0) {
+			m_expired_shed.push_back(makeReport(slot));
+		}
+	}
+
+	merge_reports(m_expired_shed,RATELIMIT_EXPIRED_REPORTS);
+
+	for(ratelimit_slot_t &slot : m_slots) {
+		slot.used=false;
+	}
+
+	for(const ratelimit_slot_t &slot : kept) {
+		size_t idx=conflation_key_hash(slot.key) & m_mask;
+
+		while(m_slots[idx].used) {
+			idx=(idx+1) & m_mask;
+		}
+		m_slots[idx]=slot;
+	}
+
+	m_used=kept.size();
+	m_last_expire_ns=now_ns;
+}
+
+sourceRateLimiter::ratelimit_slot_t *sourceRateLimiter::lookup(const struct sockaddr_storage &src_addr, uint64_t now_ns) {
+	conflation_key_t key;
+
+	// Same key as the source conflation, without the port if the sources are identified by address only
+	conflation_key_source(src_addr,key);
+	if(m_key_mode==RATELIMIT_BY_IP) {
+		key.extra&=0xFFFF0000;
+	}
+
+	uint64_t hash=conflation_key_hash(key);
+	size_t idx=hash & m_mask;
+
+	while(m_slots[idx].used) {
+		if(conflation_key_equal(m_slots[idx].key,key)) {
+			return &m_slots[idx];
+		}
+
+		idx=(idx+1) & m_mask;
+	}
+
+	// New source with a full table: forget the idle sources (at most once per second, as it requires a scan of the whole table)
+	if(m_used>=m_max_used) {
+		if(now_ns-m_last_expire_ns<SEC_TO_NANOSEC) {
+			return NULL;
+		}
+
+		expireIdle(now_ns);
+
+		if(m_used>=m_max_used) {
+			return NULL;
+		}
+
+		for(idx=hash & m_mask;m_slots[idx].used;idx=(idx+1) & m_mask);
+	}
+
+	ratelimit_slot_t &slot=m_slots[idx];
+
+	slot.used=true;
+	slot.key=key;
+	memset(&slot.addr,0,sizeof(slot.addr));
+	if(src_addr.ss_family==AF_INET6) {
+		memcpy(&slot.addr,&src_addr,sizeof(struct sockaddr_in6));
+	} else if(src_addr.ss_family==AF_INET) {
+		memcpy(&slot.addr,&src_addr,sizeof(struct sockaddr_in));
+	} else {
+		slot.addr.sin6_family=src_addr.ss_family;
+	}
+	slot.tokens=m_burst;
+	slot.last_ns=now_ns;
+	slot.seen_ns=now_ns;
+	slot.passed=0;
+	slot.shed_rate=0;
+	slot.shed_overload=0;
+	m_used++;
+
+	return &slot;
+}
+
+bool sourceRateLimiter::allow(const struct sockaddr_storage &src_addr, uint64_t now_ns) {
+	ratelimit_slot_t *slot=lookup(src_addr,now_ns);
+
+	if(slot==NULL) {
+		m_untracked++;
+		return true;
+	}
+
+	slot->seen_ns=now_ns;
+
+	if(m_rate>0) {
+		// Lazy refill, depending on the time elapsed since the last packet of the same source
+		if(now_ns>slot->last_ns) {
+			slot->tokens=std::min(m_burst,slot->tokens+(now_ns-slot->last_ns)*m_rate);
+			slot->last_ns=now_ns;
+		}
+
+		if(slot->tokens<1.0) {
+			slot->shed_rate++;
+			return false;
+		}
+
+		slot->tokens-=1.0;
+	}
+
+	slot->passed++;
+
+	return true;
+}
+
+void sourceRateLimiter::countOverloadShed(const struct sockaddr_storage &src_addr, uint64_t now_ns) {
+	ratelimit_slot_t *slot=lookup(src_addr,now_ns);
+
+	if(slot==NULL) {
+		m_untracked++;
+		return;
+	}
+
+	slot->seen_ns=now_ns;
+	slot->shed_overload++;
+}
+
+ratelimit_source_report_t sourceRateLimiter::makeReport(const ratelimit_slot_t &slot) {
+	ratelimit_source_report_t report;
+
+	if(slot.addr.sin6_family==AF_INET || slot.addr.sin6_family==AF_INET6) {
+		char src_str[ADDR_FORMAT_MAXLEN];
+		size_t src_len=addr_format_sockaddr(src_str,(const struct sockaddr *) &slot.addr);
+
+		report.source=std::string(src_str,src_len);
+
+		// Sources identified by address only: remove the port
+		if(m_key_mode==RATELIMIT_BY_IP && src_len>0) {
+			report.source.erase(report.source.rfind(':'));
+		}
+	} else {
+		report.source="local";
+	}
+
+	report.passed=slot.passed;
+	report.shed_rate=slot.shed_rate;
+	report.shed_overload=slot.shed_overload;
+
+	return report;
+}
+
+void sourceRateLimiter::getTopShed(size_t max, std::vector<ratelimit_source_report_t> &out) {
+	// Sources which are still tracked, and sources forgotten after dropping packets (possibly tracked again since then)
+	out=m_expired_shed;
+
+	for(const ratelimit_slot_t &slot : m_slots) {
+		if(slot.used && (slot.shed_rate>0 || slot.shed_overload>0)) {
+			out.push_back(makeReport(slot));
+		}
+	}
+
+	merge_reports(out,max);
+}
@@ -8,7 +8,10 @@
 #include <poll.h>
 #include <pthread.h>
 #include <arpa/inet.h>
+#include <signal.h>
 #include <cstring>
+#include <cstdint>
+#include <chrono>
 
 #include <proton/connection.hpp>
 #include <proton/delivery.hpp>
@@ -24,6 +27,10 @@
 
 // Internal headers
 #include "messagerelayeramqp.h"
+#include "pipeline.h"
+#include "configfile.h"
+
+#include <vector>
 
 // Value for an infinite timeout for poll()
 // Any negative value disables timeout and makes poll() waiting indefinitely for new events 
@@ -33,19 +40,39 @@
 // Global atomic flag to terminate the whole program in case of errors
 std::atomic<bool> terminatorFlag;
 
+// Global atomic flag set when a graceful (draining) termination has been requested via SIGTERM or SIGINT
+std::atomic<bool> drainFlag;
+
+// Write descriptor of the "unlock pipe", used by the signal handler to unlock poll()
+int unlock_pd_wr_sig=-1;
+
 double retry_interval_seconds=0.0;
 
+// SIGTERM/SIGINT handler: stop the ingest loop and let main() drain the pending messages
+// Only async-signal-safe operations are performed here (lock-free atomic stores and write())
+void termination_signal_handler(int signum) {
+	drainFlag = true;
+	terminatorFlag = true;
+
+	if(unlock_pd_wr_sig>0 && write(unlock_pd_wr_sig,"\0",1)<0) {
+		// Nothing else can be done inside a signal handler
+	}
+}
+
 // Thread callback function
 void *msgrelayer_callback(void *arg) {
-	msgrelayerAMQP *cr_AMQP_class_ptr=static_cast<msgrelayerAMQP *>(arg);
-	int unlock_pd_wr=cr_AMQP_class_ptr->getUnlockPipeDescriptorWrite();
+	msgrelayerContainerHandler *cont_handler_ptr=static_cast<msgrelayerContainerHandler *>(arg);
 
 	// Checking this just as a matter of additional safety
-	if(cr_AMQP_class_ptr!=NULL) {
+	if(cont_handler_ptr!=NULL) {
+		int unlock_pd_wr=cont_handler_ptr->getUnlockPipeDescriptorWrite();
+
 		while(terminatorFlag==false) {
 			try {
 				// Create a new Qpid Proton container and run it to start the AMQP 1.0 event loop
-				proton::container(*cr_AMQP_class_ptr).run();
+				// All the AMQP connections (one for each broker/set of connection options) share the same container,
+				// which is run by a small pool of threads
+				proton::container(*cont_handler_ptr).run(cont_handler_ptr->getThreads());
 
 				pthread_exit(NULL);
 			} catch (const std::exception& e) {
@@ -67,7 +94,7 @@ void *msgrelayer_callback(void *arg) {
 	} else {
 		std::cerr << "Error. NULL CAMrelayerAMQP object. Cannot start the AMQP client." << std::endl;
 		terminatorFlag = true;
-		if(unlock_pd_wr<=0 || write(unlock_pd_wr,"\0",1)<0) {
+		if(unlock_pd_wr_sig<=0 || write(unlock_pd_wr_sig,"\0",1)<0) {
 			fprintf(stderr,"Warning: could not gracefully terminate the AMQP client thread.\n"
 				"Its termination will be forced.\n");
 			exit(EXIT_FAILURE);
@@ -80,46 +107,211 @@ void *msgrelayer_callback(void *arg) {
 }
 
 int main(int argc, char *argv[]) {
-	// Create thread structure to pass the needed arguments to the thread callback
-	pthread_camrelayer_args_t cam_args;
-	int listen_port = 49900;
-	std::string bind_ip = "0.0.0.0";
-	int minimum_msg_size = 0;
-	bool quadk_enable = false;
-
-	std::string amqp_username="";
-	std::string amqp_password="";
-	bool amqp_reconnect=false;
-	bool amqp_allow_sasl=false;
-	bool amqp_allow_plain=false;
-	long amqp_idle_timeout_ms=-1;
+	// Options of the pipeline defined via the command line (used also as default options when a configuration file is specified)
+	pipeline_opts_t cli_opts;
+	// Options of all the pipelines to be started
+	std::vector<pipeline_opts_t> pipelines_opts;
+	config_global_opts_t global_opts;
+	std::string config_filename="";
+
+	long drain_timeout_ms=5000;
+
+	pipeline_opts_init(cli_opts);
+	global_opts.amqp_threads=0;
 
 	// Parse the command line options with the TCLAP library
 	try {
 		TCLAP::CmdLine cmd("UDP->AMQP 1.0 relayer", ' ', "1.1");
 
 		// Arguments: short option, long option, description, is it mandatory?, default value, type indication (just a string to help the user)
-		TCLAP::ValueArg<std::string> urlArg("U","url","Broker URL (with port)",true,"127.0.0.1:5672","string");
+		// --url and --queue are mandatory, unless a configuration file is specified with --config
+		TCLAP::ValueArg<std::string> urlArg("U","url","Broker URL (with port). Mandatory if --config is not specified.",false,"127.0.0.1:5672","string");
 		cmd.add(urlArg);
 
-		TCLAP::ValueArg<std::string> queueArg("Q","queue","Broker queue or topic",true,"topic://5gcarmen.examples","string");
+		TCLAP::ValueArg<std::string> queueArg("Q","queue","Broker queue or topic. Mandatory if --config is not specified.",false,"topic://5gcarmen.examples","string");
 		cmd.add(queueArg);
 
 		TCLAP::ValueArg<int> portArg("P","listen-port","Port for the UDP communication with ms-van3t",false,49900,"int");
 		cmd.add(portArg);
 
-		TCLAP::ValueArg<std::string> interfaceArg("b","bindto","IP address of the interface to bind to. If set to '0.0.0.0' no specific interface will be used to bind the UDP socker",false,"0.0.0.0","string");
+		TCLAP::ValueArg<std::string> interfaceArg("b","bindto","IP address (IPv4 or IPv6) of the interface to bind to. If set to '0.0.0.0' no specific interface will be used to bind the UDP socker",false,"0.0.0.0","string");
 		cmd.add(interfaceArg);
 
+		TCLAP::MultiArg<std::string> listenArg("l","listen","UDP endpoint to listen on, as <address>:<port>[,option...], where <address> can be an IPv4 address, an IPv6 address between square brackets "
+			"(dual-stack, unless the 'v6only' option is specified) or '*' (any IPv6 and IPv4 address). Available options: 'dev=<interface>' (bind to a specific interface), 'v6only', "
+			"'queue=<queue or topic>' (relay to a different queue/topic), 'tag=<string>' (attach a \"listen_tag\" property to each message) and 'mcast-if=<interface>' (interface on which a multicast group <address> is joined, "
+			"it can be repeated). Local producers can use 'unix:<path>' (AF_UNIX datagram socket) and 'shm:<path>[,ring-size=<bytes>]' (shared-memory rings, see shmring.h) endpoints. "
+			"It can be specified multiple times, to listen on several endpoints. When specified, --listen-port and --bindto are ignored.",false,"string");
+		cmd.add(listenArg);
+
 		TCLAP::ValueArg<int> minsizeArg("s","min-msg-size","Set a minimum message size. All UDP messages with a smaller payload size will be discarded.",false,0,"int");
 		cmd.add(minsizeArg);
 
+		TCLAP::ValueArg<int> maxsizeArg("m","max-msg-size","Set a maximum message size (up to 65535 bytes, i.e., the maximum UDP payload size). All UDP messages with a larger payload size will be truncated, "
+			"or discarded if --drop-truncated is specified.",false,RX_MAX_UDP_PAYLOAD,"int");
+		cmd.add(maxsizeArg);
+
+		TCLAP::SwitchArg droptruncArg("d","drop-truncated","Discard, instead of relaying them truncated, all the UDP messages larger than the maximum message size.");
+		cmd.add(droptruncArg);
+
+		TCLAP::SwitchArg udpGroArg("g","udp-gro","Enable UDP Generic Receive Offload (Linux >= 5.0): bursts of same-sized UDP packets are received by the relayer as a single buffer, "
+			"which is then split into the original packets. If not supported by the kernel, packets are received as usual.");
+		cmd.add(udpGroArg);
+
 		// To quickly test the transmission of quadkeys, you can use, with nc, --> echo -e "\x1b\x74\xeb\xfc\x06\xa6\xac\x38hello" >/dev/udp/localhost/49900
 		// This command will relay a message with content "echo" and coordinates corresponding to a point near Trento, Italy (46.0647420,11.1586360)
 		TCLAP::SwitchArg quadkeysArg("q","enable-quadkeys","When specified, the relayer expects each UDP packet to include, in the first 64 bits, a value of latitude (32 bits) followed by a value of longitude (32 bits)."
-			"These values should be specified as degrees*1e7, in network byte order, when sending UDP packets to the relayer. Do not specify this option if you don't plan to add any geographical information at the beginning of each of your packets!");
+			"These values should be specified as degrees*1e7, in network byte order, when sending UDP packets to the relayer (a different format can be set with --coord-format, --coord-offset and --coord-scale). Do not specify this option if you don't plan to add any geographical information at the beginning of each of your packets!");
 		cmd.add(quadkeysArg);
 
+		TCLAP::ValueArg<int> quadkeysLevelArg("L","quadkeys-level","Level of detail of the quadkeys computed when --enable-quadkeys is specified (from 14 to 18).",false,18,"int");
+		cmd.add(quadkeysLevelArg);
+
+		TCLAP::ValueArg<std::string> quadkeyFormatArg("","quadkey-format","Form of the quadkey attached to each message: 'string' (default: \"quadkeys\" string property), "
+			"'ulong' (\"quadkey\" ulong property, containing the Morton code of the tile and the level, see include/quadkey_morton.h) or 'both'.",false,"string","string");
+		cmd.add(quadkeyFormatArg);
+
+		TCLAP::ValueArg<std::string> spatialKeysArg("","spatial-keys","Comma-separated list of the spatial keys attached to each message when --enable-quadkeys is specified: "
+			"'quadkey' (default, see --quadkey-format), 'geohash' (\"geohash\" string property) and 'morton' (\"morton\" ulong property, 64 bits Morton code of the coordinates, "
+			"in the geohash bit order, see include/spatial_keys.h). All the keys are computed from the same decoded position.",false,"quadkey","list");
+		cmd.add(spatialKeysArg);
+
+		TCLAP::ValueArg<int> geohashPrecisionArg("","geohash-precision","Number of characters of the \"geohash\" property (from 1 to 12, default: 9, i.e., cells of about 5 m).",false,9,"int");
+		cmd.add(geohashPrecisionArg);
+
+		TCLAP::ValueArg<int> quadkeyNeighborsArg("","quadkey-neighbors","Attach to each message its tile and its eight neighbors at the given level (not greater than "
+			"--quadkeys-level), as a \"quadkeys_nbr\" comma-separated string and/or \"quadkey_nbr0\"...\"quadkey_nbr8\" ulong properties (depending on --quadkey-format), "
+			"so that the messages around a tile can be selected by looking for that tile only. 0 (default) disables the neighbors.",false,0,"level");
+		cmd.add(quadkeyNeighborsArg);
+
+		TCLAP::ValueArg<std::string> stationIndexArg("","station-index","Keep an in-memory index of the latest position of each station (ETSI messages only, "
+			"requires --enable-quadkeys), answering bounding box and tile queries on an AF_UNIX datagram socket at the given path (see include/stationindex.h).",false,"","path");
+		cmd.add(stationIndexArg);
+
+		TCLAP::ValueArg<int> stationMaxAgeArg("","station-max-age","Stations are removed from the station index when their latest position is older than the given value (default: 60000 ms).",
+			false,60000,"ms");
+		cmd.add(stationMaxAgeArg);
+
+		TCLAP::ValueArg<int> adaptiveLodArg("","adaptive-lod","Adaptive level of detail of the quadkeys: the map is partitioned into tiles from the given (coarsest) level "
+			"up to --quadkeys-level, splitting the tiles exceeding --adaptive-lod-rate and merging back the sparse ones, and each message gets the quadkey of the tile "
+			"of the partition containing it (see include/adaptivelod.h). 0 (default) disables the adaptive level of detail.",false,0,"level");
+		cmd.add(adaptiveLodArg);
+
+		TCLAP::ValueArg<double> adaptiveLodRateArg("","adaptive-lod-rate","Rate, in messages per second, above which a tile of the adaptive partition is split into its four children "
+			"(default: 100). The children are merged back when, together, they receive less than a fourth of this rate.",false,100,"msg/s");
+		cmd.add(adaptiveLodRateArg);
+
+		TCLAP::ValueArg<int> adaptiveLodIntervalArg("","adaptive-lod-interval","Interval at which the message rates are measured and the adaptive partition is updated (default: 10000 ms).",
+			false,10000,"ms");
+		cmd.add(adaptiveLodIntervalArg);
+
+		TCLAP::ValueArg<std::string> adaptiveLodMapArg("","adaptive-lod-map","File where the current adaptive partition (the quadkeys of the tiles finer than --adaptive-lod) "
+			"is written, atomically replacing it at each change, so that consumers can subscribe to the right tiles.",false,"","path");
+		cmd.add(adaptiveLodMapArg);
+
+		TCLAP::ValueArg<std::string> heatmapArg("","heatmap","Count the messages and bytes received inside each tile (requires --enable-quadkeys), writing a snapshot of "
+			"the counters to the given file (atomically replaced) at the end of each --heatmap-interval (see include/tileheatmap.h).",false,"","path");
+		cmd.add(heatmapArg);
+
+		TCLAP::ValueArg<int> heatmapLevelArg("","heatmap-level","Level of the tiles of the heatmap (not greater than --quadkeys-level, default: the level of the quadkeys).",false,0,"level");
+		cmd.add(heatmapLevelArg);
+
+		TCLAP::ValueArg<int> heatmapIntervalArg("","heatmap-interval","Interval over which the heatmap counters are accumulated (default: 60000 ms).",false,60000,"ms");
+		cmd.add(heatmapIntervalArg);
+
+		TCLAP::ValueArg<std::string> heatmapFormatArg("","heatmap-format","Format of the heatmap snapshots: 'csv' (default) or 'binary' (header and fixed-size records, "
+			"in host byte order, see include/tileheatmap.h).",false,"csv","string");
+		cmd.add(heatmapFormatArg);
+
+		TCLAP::ValueArg<int> heatmapSlotsArg("","heatmap-slots","Number of slots of the heatmap tables (rounded up to a power of 2): up to 3/4 of them can be used by distinct tiles "
+			"in each interval, and the messages of further tiles are counted as untracked (default: 65536).",false,HEATMAP_DEFAULT_SLOTS,"int");
+		cmd.add(heatmapSlotsArg);
+
+		TCLAP::ValueArg<int> quadkeyCacheArg("","quadkey-cache","Number of cells of the tile cache (rounded up to a power of 2), storing the tile of small cells of the coordinate grid, "
+			"so that the quadkeys of repeated positions (e.g., of slow or stopped vehicles) are not computed again. Only integer coordinates (i32 and etsi formats) are cached. "
+			"0 (default) disables the cache.",false,0,"int");
+		cmd.add(quadkeyCacheArg);
+
+		TCLAP::ValueArg<std::string> coordFormatArg("F","coord-format","Type and byte order of the latitude and longitude values used by --enable-quadkeys: 'i32be' (default), 'i32le', "
+			"'f32be', 'f32le', 'f64be' or 'f64le' (i32: signed 32 bits integers, f32/f64: IEEE 754 single/double precision; be: big endian, le: little endian), "
+			"or 'etsi' (reference position of UPER-encoded ETSI CAMs/DENMs, possibly behind the GeoNetworking and BTP headers, also relaying their \"station_id\" and \"message_id\").",false,"i32be","string");
+		cmd.add(coordFormatArg);
+
+		TCLAP::ValueArg<long> coordOffsetArg("O","coord-offset","Offset, in bytes from the beginning of each packet, of the latitude value (immediately followed by the longitude).",false,0,"bytes");
+		cmd.add(coordOffsetArg);
+
+		TCLAP::ValueArg<double> coordScaleArg("K","coord-scale","Units per degree of the latitude and longitude values (default: 1e7 for i32 values, 1 for f32/f64 values).",false,0,"number");
+		cmd.add(coordScaleArg);
+
+		TCLAP::SwitchArg coordKeepArg("k","coord-keep","Relay the latitude and longitude values as part of the message payload, instead of removing them.");
+		cmd.add(coordKeepArg);
+
+		TCLAP::ValueArg<std::string> coordInvalidArg("","coord-invalid","Handling of the packets whose coordinates are not available (e.g., ETSI \"unavailable\" values, "
+			"or ETSI packets which are not CAMs/DENMs) or out of range: 'no-quadkey' (default: relay them without spatial keys), 'drop', or 'dead-letter' (relay them to "
+			"--coord-dead-letter-queue, with a \"coord_error\" property set to \"unavailable\" or \"out_of_range\"). Such coordinates are never projected.",false,"no-quadkey","string");
+		cmd.add(coordInvalidArg);
+
+		TCLAP::ValueArg<std::string> coordDeadLetterArg("","coord-dead-letter-queue","Queue or topic of the packets with invalid coordinates, when --coord-invalid is 'dead-letter'.",false,"","string");
+		cmd.add(coordDeadLetterArg);
+
+		TCLAP::ValueArg<std::string> srcPropsArg("A","source-properties","Attach to each message the source IP address and port, and the kernel receive timestamp, as AMQP properties. "
+			"Allowed values: 'none' (default), 'text' (\"src\" string property, as \"address:port\") or 'binary' (\"src_addr\" binary and \"src_port\" ushort properties). "
+			"In both 'text' and 'binary' modes, the receive timestamp is relayed as \"rx_ts_ns\" (ulong, nanoseconds since the epoch).",false,"none","string");
+		cmd.add(srcPropsArg);
+
+		TCLAP::ValueArg<int> conflateIntervalArg("w","conflate-interval","Enable latest-value conflation: during each interval of the given duration (in ms), only the newest message "
+			"for each key (see --conflate-key) is kept, and relayed at the end of the interval. 0 (default) disables conflation.",false,0,"ms");
+		cmd.add(conflateIntervalArg);
+
+		TCLAP::ValueArg<std::string> conflateKeyArg("W","conflate-key","Conflation key: 'station' (default: ETSI station ID and message ID; packets which are not CAMs/DENMs are not conflated) "
+			"or 'source' (source address and port).",false,"station","string");
+		cmd.add(conflateKeyArg);
+
+		TCLAP::ValueArg<int> conflateSlotsArg("","conflate-slots","Maximum number of distinct conflation keys per interval (default: 65536). Messages with new keys exceeding it are relayed immediately.",
+			false,CONFLATION_DEFAULT_SLOTS,"int");
+		cmd.add(conflateSlotsArg);
+
+		TCLAP::ValueArg<int> dedupWindowArg("e","dedup-window","Enable duplicate suppression: packets with the same payload as a packet received during the given window (in ms) "
+			"are dropped (e.g., CAMs from the same vehicle received through several RSUs). 0 (default) disables duplicate suppression.",false,0,"ms");
+		cmd.add(dedupWindowArg);
+
+		TCLAP::ValueArg<int> dedupSlotsArg("","dedup-slots","Size of the duplicate suppression set: maximum number of payloads remembered for each third of the window (default: 65536, "
+			"rounded up to a power of 2). Payloads exceeding it are relayed without being remembered.",false,DEDUP_DEFAULT_SLOTS,"int");
+		cmd.add(dedupSlotsArg);
+
+		TCLAP::ValueArg<double> rateLimitArg("x","rate-limit","Maximum rate, in packets per second, of each source (see --rate-key). Packets exceeding it are dropped. "
+			"0 (default) disables rate limiting.",false,0,"double");
+		cmd.add(rateLimitArg);
+
+		TCLAP::ValueArg<double> rateBurstArg("","rate-burst","Maximum burst of packets accepted from each source (token bucket size). 0 (default) means one second worth of packets.",false,0,"double");
+		cmd.add(rateBurstArg);
+
+		TCLAP::ValueArg<std::string> rateKeyArg("","rate-key","Rate limiting key: 'ip' (default: source address) or 'ip-port' (source address and port).",false,"ip","string");
+		cmd.add(rateKeyArg);
+
+		TCLAP::ValueArg<int> rateSlotsArg("","rate-slots","Maximum number of sources tracked by the rate limiter (default: 16384). Packets from further sources are not rate limited.",
+			false,RATELIMIT_DEFAULT_SLOTS,"int");
+		cmd.add(rateSlotsArg);
+
+		TCLAP::ValueArg<long> shedWatermarkArg("X","shed-watermark","Enable overload shedding: when the number of messages not yet settled by the broker reaches this value, "
+			"packets which are not CAMs or DENMs are dropped; CAMs are dropped above twice this value, and DENMs above four times this value. 0 (default) disables shedding.",false,0,"messages");
+		cmd.add(shedWatermarkArg);
+
+		TCLAP::ValueArg<int> priorityLanesArg("y","priority-lanes","Number of priority lanes (up to 8): each lane has its own bounded queue and its own AMQP link, and lane 0 has the highest priority "
+			"(also set as AMQP message priority). 1 (default) disables priority lanes.",false,1,"int");
+		cmd.add(priorityLanesArg);
+
+		TCLAP::MultiArg<std::string> laneRuleArg("","lane-rule","Lane classification rule, as <lane>:msgid=<ETSI message ID>, <lane>:port=<listen port> or <lane>:src=<address>[/<prefix length>]. "
+			"It can be repeated: the first matching rule wins, and packets not matching any rule go to the last lane. Default: 0:msgid=1 (DENMs in lane 0).",false,"string");
+		cmd.add(laneRuleArg);
+
+		TCLAP::ValueArg<std::string> laneWeightsArg("","lane-weights","Comma-separated weights of the lanes (e.g., 8,2,1), to serve them with weighted round-robin scheduling. "
+			"If not specified, the lanes are served with strict priority.",false,"","string");
+		cmd.add(laneWeightsArg);
+
+		TCLAP::ValueArg<int> laneQueueSizeArg("","lane-queue-size","Maximum number of messages waiting in each priority lane (default: 10000). Messages exceeding it are dropped.",false,LANES_DEFAULT_QUEUE_SIZE,"int");
+		cmd.add(laneQueueSizeArg);
+
 		TCLAP::ValueArg<std::string> amqp_usernameArg("u","amqp-username","Username for the AMQP connection (if required)",false,"","string");
 		cmd.add(amqp_usernameArg);
 
@@ -141,27 +333,252 @@ int main(int argc, char *argv[]) {
 		TCLAP::ValueArg<double> retryIntervalArg("R","retry-interval","Setting this option will make the relayer periodically retry connecting to the broker, if a connection is not possible, or if it gets disconnected. A retry interval in seconds should be specified. A value equal to 0 will make the relayer terminate with an error in case of disconnection.",false,0.0,"double");
 		cmd.add(retryIntervalArg);
 
+		TCLAP::ValueArg<long> drainTimeoutArg("D","drain-timeout","Maximum time, in milliseconds, the relayer will wait, after receiving SIGTERM or SIGINT, for the messages still pending to be sent and settled by the broker, before closing the AMQP connection.",false,5000,"long");
+		cmd.add(drainTimeoutArg);
+
+		TCLAP::ValueArg<std::string> configArg("c","config","Configuration file defining one or more pipelines (i.e., UDP port -> AMQP queue/topic relays) to be run in the same process. "
+			"The other command line options are used as default values for all the pipelines defined in the file.",false,"","string");
+		cmd.add(configArg);
+
+		TCLAP::ValueArg<int> amqpThreadsArg("T","amqp-threads","Number of threads running the Qpid Proton container, shared by all the AMQP connections. "
+			"If set to 0, one thread for each AMQP connection is used (up to the number of available cores).",false,0,"int");
+		cmd.add(amqpThreadsArg);
+
+		TCLAP::ValueArg<int> amqpConnectionsArg("C","amqp-connections","Number of parallel AMQP connections used to relay the messages of each pipeline. "
+			"The messages coming from the same source are always relayed over the same connection.",false,1,"int");
+		cmd.add(amqpConnectionsArg);
+
 		cmd.parse(argc,argv);
 
-		cam_args.m_broker_address=urlArg.getValue();
-		cam_args.m_queue_name=queueArg.getValue();
-		listen_port=portArg.getValue();
-		bind_ip=interfaceArg.getValue();
-		minimum_msg_size=minsizeArg.getValue();
-		quadk_enable=quadkeysArg.getValue();
+		cli_opts.amqp_args.m_broker_address=urlArg.isSet() ? urlArg.getValue() : "";
+		cli_opts.amqp_args.m_queue_name=queueArg.isSet() ? queueArg.getValue() : "";
+		cli_opts.listen_port=portArg.getValue();
+		cli_opts.bind_ip=interfaceArg.getValue();
+
+		for(const std::string &listen_spec : listenArg.getValue()) {
+			listen_endpoint_t endpoint;
+			std::string error;
+
+			if(!parse_listen_endpoint(listen_spec,endpoint,error)) {
+				std::cerr << "Error: invalid value for --listen: " << error << std::endl;
+				exit(EXIT_FAILURE);
+			}
+
+			cli_opts.listen_endpoints.push_back(endpoint);
+		}
+		cli_opts.minimum_msg_size=minsizeArg.getValue();
+		cli_opts.max_msg_size=maxsizeArg.getValue();
+		cli_opts.drop_truncated=droptruncArg.getValue();
+		cli_opts.udp_gro=udpGroArg.getValue();
+
+		if(cli_opts.max_msg_size<=0 || cli_opts.max_msg_size>RX_MAX_UDP_PAYLOAD) {
+			std::cerr << "Error: invalid value for --max-msg-size: " << cli_opts.max_msg_size << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		cli_opts.quadk_enable=quadkeysArg.getValue();
+		cli_opts.quadk_level=quadkeysLevelArg.getValue();
+
+		if(cli_opts.quadk_level<14 || cli_opts.quadk_level>18) {
+			std::cerr << "Error: invalid value for --quadkeys-level: " << cli_opts.quadk_level << " (it must be between 14 and 18)" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(!parse_quadkey_format(quadkeyFormatArg.getValue(),cli_opts.quadk_format)) {
+			std::cerr << "Error: invalid value for --quadkey-format: " << quadkeyFormatArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(!parse_spatial_keys(spatialKeysArg.getValue(),cli_opts.spatial_keys)) {
+			std::cerr << "Error: invalid value for --spatial-keys: " << spatialKeysArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.geohash_precision=geohashPrecisionArg.getValue();
+
+		if(cli_opts.geohash_precision<1 || cli_opts.geohash_precision>SPATIAL_GEOHASH_MAX_PRECISION) {
+			std::cerr << "Error: invalid value for --geohash-precision: " << cli_opts.geohash_precision << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.quadk_nbr_level=quadkeyNeighborsArg.getValue();
+
+		if(cli_opts.quadk_nbr_level<0 || cli_opts.quadk_nbr_level>QUADKEY_MAX_LEVEL) {
+			std::cerr << "Error: invalid value for --quadkey-neighbors: " << cli_opts.quadk_nbr_level << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.station_index_path=stationIndexArg.getValue();
+		cli_opts.station_max_age_ms=stationMaxAgeArg.getValue();
+
+		if(cli_opts.station_max_age_ms<=0) {
+			std::cerr << "Error: invalid value for --station-max-age: " << cli_opts.station_max_age_ms << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.adaptive_lod_min_level=adaptiveLodArg.getValue();
+		cli_opts.adaptive_lod_split_rate=adaptiveLodRateArg.getValue();
+		cli_opts.adaptive_lod_interval_ms=adaptiveLodIntervalArg.getValue();
+		cli_opts.adaptive_lod_map_path=adaptiveLodMapArg.getValue();
+
+		if(cli_opts.adaptive_lod_min_level<0 || cli_opts.adaptive_lod_min_level>QUADKEY_MAX_LEVEL) {
+			std::cerr << "Error: invalid value for --adaptive-lod: " << cli_opts.adaptive_lod_min_level << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(cli_opts.adaptive_lod_split_rate<=0) {
+			std::cerr << "Error: invalid value for --adaptive-lod-rate: " << cli_opts.adaptive_lod_split_rate << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(cli_opts.adaptive_lod_interval_ms<=0) {
+			std::cerr << "Error: invalid value for --adaptive-lod-interval: " << cli_opts.adaptive_lod_interval_ms << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.heatmap_path=heatmapArg.getValue();
+		cli_opts.heatmap_level=heatmapLevelArg.getValue();
+		cli_opts.heatmap_interval_ms=heatmapIntervalArg.getValue();
+		cli_opts.heatmap_slots=heatmapSlotsArg.getValue();
+
+		if(cli_opts.heatmap_level<0 || cli_opts.heatmap_level>QUADKEY_MAX_LEVEL) {
+			std::cerr << "Error: invalid value for --heatmap-level: " << cli_opts.heatmap_level << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(cli_opts.heatmap_interval_ms<=0) {
+			std::cerr << "Error: invalid value for --heatmap-interval: " << cli_opts.heatmap_interval_ms << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(!parse_heatmap_format(heatmapFormatArg.getValue(),cli_opts.heatmap_format)) {
+			std::cerr << "Error: invalid value for --heatmap-format: " << heatmapFormatArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(cli_opts.heatmap_slots<=0 || cli_opts.heatmap_slots>(1<<24)) {
+			std::cerr << "Error: invalid value for --heatmap-slots: " << cli_opts.heatmap_slots << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.quadk_cache_slots=quadkeyCacheArg.getValue();
+
+		if(cli_opts.quadk_cache_slots<0 || cli_opts.quadk_cache_slots>(1<<24)) {
+			std::cerr << "Error: invalid value for --quadkey-cache: " << cli_opts.quadk_cache_slots << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(!coord_parse_format_name(coordFormatArg.getValue(),cli_opts.coord_format)) {
+			std::cerr << "Error: invalid value for --coord-format: " << coordFormatArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if(coordOffsetArg.getValue()<0 || coordOffsetArg.getValue()>RX_MAX_UDP_PAYLOAD || coordScaleArg.getValue()<0) {
+			std::cerr << "Error: invalid value for --coord-offset or --coord-scale." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		cli_opts.coord_format.offset=coordOffsetArg.getValue();
+		cli_opts.coord_format.scale=coordScaleArg.getValue();
+		cli_opts.coord_format.strip=!coordKeepArg.getValue();
+
+		if(!parse_coord_invalid_policy(coordInvalidArg.getValue(),cli_opts.coord_invalid)) {
+			std::cerr << "Error: invalid value for --coord-invalid: " << coordInvalidArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		cli_opts.coord_dead_letter_queue=coordDeadLetterArg.getValue();
+
+		if(!parse_src_props_mode(srcPropsArg.getValue(),cli_opts.src_props)) {
+			std::cerr << "Error: invalid value for --source-properties: " << srcPropsArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.conflate_interval_ms=conflateIntervalArg.getValue();
+		cli_opts.conflate_slots=conflateSlotsArg.getValue();
+
+		if(!parse_conflation_key_mode(conflateKeyArg.getValue(),cli_opts.conflate_key)) {
+			std::cerr << "Error: invalid value for --conflate-key: " << conflateKeyArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if(cli_opts.conflate_interval_ms<0 || cli_opts.conflate_slots<=0 || cli_opts.conflate_slots>(1<<24)) {
+			std::cerr << "Error: invalid value for --conflate-interval or --conflate-slots." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.dedup_window_ms=dedupWindowArg.getValue();
+		cli_opts.dedup_slots=dedupSlotsArg.getValue();
+
+		if(cli_opts.dedup_window_ms<0 || cli_opts.dedup_slots<=0 || cli_opts.dedup_slots>(1<<24)) {
+			std::cerr << "Error: invalid value for --dedup-window or --dedup-slots." << std::endl;
+			exit(EXIT_FAILURE);
+		}
 
-		amqp_username=amqp_usernameArg.getValue();
-		amqp_password=amqp_passwordArg.getValue();
-		amqp_reconnect=amqp_reconnectArg.getValue();
-		amqp_allow_sasl=amqp_allow_saslArg.getValue();
-		amqp_allow_plain=amqp_allow_plainArg.getValue();
-		amqp_idle_timeout_ms=amqp_idle_timeout_msArg.getValue();
+		cli_opts.rate_limit=rateLimitArg.getValue();
+		cli_opts.rate_burst=rateBurstArg.getValue();
+		cli_opts.rate_slots=rateSlotsArg.getValue();
+		cli_opts.shed_watermark=shedWatermarkArg.getValue();
+
+		if(!parse_ratelimit_key_mode(rateKeyArg.getValue(),cli_opts.rate_key)) {
+			std::cerr << "Error: invalid value for --rate-key: " << rateKeyArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if(cli_opts.rate_limit<0 || cli_opts.rate_burst<0 || cli_opts.rate_slots<=0 || cli_opts.rate_slots>(1<<24) || cli_opts.shed_watermark<0) {
+			std::cerr << "Error: invalid value for --rate-limit, --rate-burst, --rate-slots or --shed-watermark." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		cli_opts.priority_lanes=priorityLanesArg.getValue();
+		cli_opts.lane_queue_size=laneQueueSizeArg.getValue();
+
+		if(cli_opts.priority_lanes<1 || cli_opts.priority_lanes>LANES_MAX || cli_opts.lane_queue_size<=0) {
+			std::cerr << "Error: invalid value for --priority-lanes or --lane-queue-size." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if(laneWeightsArg.isSet() && !parse_lane_weights(laneWeightsArg.getValue(),cli_opts.lane_weights)) {
+			std::cerr << "Error: invalid value for --lane-weights: " << laneWeightsArg.getValue() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		for(const std::string &rule_spec : laneRuleArg.getValue()) {
+			lane_rule_t rule;
+			std::string error;
+
+			if(!parse_lane_rule(rule_spec,rule,error)) {
+				std::cerr << "Error: invalid value for --lane-rule: " << error << std::endl;
+				exit(EXIT_FAILURE);
+			}
+
+			cli_opts.lane_rules.push_back(rule);
+		}
+
+		cli_opts.amqp_username=amqp_usernameArg.getValue();
+		cli_opts.amqp_password=amqp_passwordArg.getValue();
+		cli_opts.amqp_reconnect=amqp_reconnectArg.getValue();
+		cli_opts.amqp_allow_sasl=amqp_allow_saslArg.getValue();
+		cli_opts.amqp_allow_plain=amqp_allow_plainArg.getValue();
+		cli_opts.amqp_idle_timeout_ms=amqp_idle_timeout_msArg.getValue();
 
 		retry_interval_seconds=retryIntervalArg.getValue();
+		drain_timeout_ms=drainTimeoutArg.getValue();
 
-		std::cout << "The relayer will connect to " + cam_args.m_broker_address + "/" + cam_args.m_queue_name << std::endl;
+		config_filename=configArg.getValue();
+		global_opts.amqp_threads=amqpThreadsArg.getValue();
+		cli_opts.amqp_connections=amqpConnectionsArg.getValue()>0 ? amqpConnectionsArg.getValue() : 1;
 	} catch (TCLAP::ArgException &tclape) { 
 		std::cerr << "TCLAP error: " << tclape.error() << " for argument " << tclape.argId() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if(config_filename.empty()) {
+		if(cli_opts.amqp_args.m_broker_address.empty() || cli_opts.amqp_args.m_queue_name.empty()) {
+			std::cerr << "Error: --url and --queue must be specified when no configuration file is used." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		pipelines_opts.push_back(cli_opts);
+	} else if(!parse_config_file(config_filename,cli_opts,pipelines_opts,global_opts)) {
+		exit(EXIT_FAILURE);
+	}
+
+	for(const pipeline_opts_t &opts : pipelines_opts) {
+		std::cout << "The relayer will connect to " + opts.amqp_args.m_broker_address + "/" + opts.amqp_args.m_queue_name << std::endl;
 	}
 
 	// Create a pipe for the graceful termination of the relayer in case of errors
@@ -172,8 +589,74 @@ int main(int argc, char *argv[]) {
 		exit(EXIT_FAILURE);
 	}
 
-	// CAM relayer object
-	msgrelayerAMQP msg_relayer_obj;
+	// Pipelines and AMQP connections (pipelines to the same broker, with the same connection options, share the same connection)
+	std::vector<relayerPipeline *> pipelines;
+	std::vector<msgrelayerAMQP *> relayers;
+	msgrelayerContainerHandler cont_handler;
+
+	for(size_t i=0;i<pipelines_opts.size();i++) {
+		relayerPipeline *pipeline=new relayerPipeline(pipelines_opts[i]);
+		bool shared_connections=false;
+
+		for(size_t j=0;j<i && shared_connections==false;j++) {
+			if(pipeline_opts_same_connection(pipelines_opts[i],pipelines_opts[j])) {
+				for(msgrelayerAMQP *msg_relayer_ptr : pipelines[j]->getRelayers()) {
+					pipeline->addRelayer(msg_relayer_ptr);
+				}
+				shared_connections=true;
+			}
+		}
+
+		for(int conn=0;conn<pipelines_opts[i].amqp_connections && shared_connections==false;conn++) {
+			// CAM relayer object
+			msgrelayerAMQP *msg_relayer_ptr=new msgrelayerAMQP(pipelines_opts[i].amqp_args);
+
+			// Store the "write" pipe descriptor into the msgrelayerAMQP object
+			msg_relayer_ptr->setUnlockPipeDescriptorWrite(unlock_pd[1]);
+
+			// Set username, if specified
+			if(pipelines_opts[i].amqp_username.length()>0) {
+				msg_relayer_ptr->setUsername(pipelines_opts[i].amqp_username);
+			}
+			// Set password, if specified
+			if(pipelines_opts[i].amqp_password.length()>0) {
+				msg_relayer_ptr->setPassword(pipelines_opts[i].amqp_password);
+			}
+			// Set connection options
+			msg_relayer_ptr->setConnectionOptions(pipelines_opts[i].amqp_allow_sasl,pipelines_opts[i].amqp_allow_plain,pipelines_opts[i].amqp_reconnect);
+			msg_relayer_ptr->setIdleTimeout(pipelines_opts[i].amqp_idle_timeout_ms);
+			msg_relayer_ptr->setLanes(pipelines_opts[i].priority_lanes,pipelines_opts[i].lane_weights,pipelines_opts[i].lane_queue_size);
+
+			relayers.push_back(msg_relayer_ptr);
+			cont_handler.addRelayer(msg_relayer_ptr);
+			pipeline->addRelayer(msg_relayer_ptr);
+		}
+
+		pipelines.push_back(pipeline);
+	}
+
+	// By default, use one Proton thread for each AMQP connection (i.e., connection-per-thread egress), up to the number of available cores
+	if(global_opts.amqp_threads<=0) {
+		long ncores=sysconf(_SC_NPROCESSORS_ONLN);
+
+		global_opts.amqp_threads=relayers.size();
+		if(ncores>0 && global_opts.amqp_threads>ncores) {
+			global_opts.amqp_threads=ncores;
+		}
+	}
+
+	std::cout << "Starting " << pipelines.size() << " pipeline(s) over " << relayers.size() << " AMQP connection(s), with " <<
+		global_opts.amqp_threads << " AMQP thread(s)." << std::endl;
+
+	for(relayerPipeline *pipeline : pipelines) {
+		if(pipeline->getOptions().quadk_enable==true) {
+			std::cout << "Quadkeys are computed in batches with the " << QuadKeys::QuadKeyTSSimple::getBatchImplementation() << " implementation." << std::endl;
+			break;
+		}
+	}
+
+	cont_handler.setThreads(global_opts.amqp_threads);
+	cont_handler.setUnlockPipeDescriptorWrite(unlock_pd[1]);
 
 	// Creation of the thread
 	// CAM Relayer Thread attributes
@@ -181,126 +664,215 @@ int main(int argc, char *argv[]) {
 	// CAM Relayer Thread ID
 	pthread_t curr_tid;
 
-	// Store the "write" pipe descriptor into the msgrelayerAMQP object (to enable an easy retrieval in the AMQP client thread)
-	msg_relayer_obj.setUnlockPipeDescriptorWrite(unlock_pd[1]);
-
-	// Set the terminator flag to false
+	// Set the terminator and drain flags to false
 	terminatorFlag = false;
+	drainFlag = false;
 
-	// Set the arguments/parameters of the CAMrelayerAMQP object
-	msg_relayer_obj.set_args(cam_args);
+	// Install the SIGTERM/SIGINT handler for the graceful (draining) termination of the relayer
+	struct sigaction term_action;
+	sigset_t term_sigset, old_sigset;
 
-	// Set username, if specified
-	if(amqp_username.length()>0) {
-		msg_relayer_obj.setUsername(amqp_username);
-	}
-	// Set password, if specified
-	if(amqp_password.length()>0) {
-		msg_relayer_obj.setUsername(amqp_password);
-	}
-	// Set connection options
-	msg_relayer_obj.setConnectionOptions(amqp_allow_sasl,amqp_allow_plain,amqp_reconnect);
-	msg_relayer_obj.setIdleTimeout(amqp_idle_timeout_ms);
+	unlock_pd_wr_sig=unlock_pd[1];
+
+	memset(&term_action,0,sizeof(term_action));
+	term_action.sa_handler=termination_signal_handler;
+	sigemptyset(&term_action.sa_mask);
+	sigaction(SIGTERM,&term_action,NULL);
+	sigaction(SIGINT,&term_action,NULL);
+
+	// Block SIGTERM and SIGINT while creating the AMQP client thread, so that they are always delivered to the main thread
+	sigemptyset(&term_sigset);
+	sigaddset(&term_sigset,SIGTERM);
+	sigaddset(&term_sigset,SIGINT);
+	pthread_sigmask(SIG_BLOCK,&term_sigset,&old_sigset);
 
 	// pthread_attr_init()/pthread_attr_setdetachstate()/pthread_attr_destroy() may probably be removed in the future
 	// If removed, the second argument of pthread_create() should be NULL instead of &tattr
 	pthread_attr_init(&tattr);
 	pthread_attr_setdetachstate(&tattr,PTHREAD_CREATE_DETACHED);
 
-	// Passing as argument, to the thread, a pointer to the CAM_relayer_obj CAMrelayerAMQP object
+	// Passing as argument, to the thread, a pointer to the container handler, which starts all the AMQP connections
 	// pthread_create() actually creates a new (parallel) thread, running the content of the function "CAMrelayer_callback" (which must be a void *(void *) function)
-	pthread_create(&curr_tid,&tattr,msgrelayer_callback,(void *) &(msg_relayer_obj));
+	pthread_create(&curr_tid,&tattr,msgrelayer_callback,(void *) &(cont_handler));
 	pthread_attr_destroy(&tattr);
 
-	// Wait for the sender to be open before moving on (as required and as described inside camrelayeramqp.h)
-	bool sender_ready_status;
-
-	std::cout << "Waiting for the AMQP sender to be ready..." << std::endl;
+	pthread_sigmask(SIG_SETMASK,&old_sigset,NULL);
 
-	sender_ready_status=msg_relayer_obj.wait_sender_ready(&terminatorFlag);
+	// Wait for the senders to be open before moving on (as required and as described inside camrelayeramqp.h)
+	bool sender_ready_status=true;
 
-	std::cout << "Sender should be ready. Status (0 = error, 1 = ok): " << sender_ready_status << std::endl;
+	std::cout << "Waiting for the AMQP senders to be ready..." << std::endl;
 
-	// Create UDP socket
-	int sfd = socket(AF_INET,SOCK_DGRAM,0);
-	
-	if(sfd<=0) {
-		std::cerr << "Error: cannot create socket. Details: " << std::string(strerror(errno)) << std::endl;
-		exit(EXIT_FAILURE);
+	for(msgrelayerAMQP *msg_relayer_ptr : relayers) {
+		sender_ready_status&=msg_relayer_ptr->wait_sender_ready(&terminatorFlag);
 	}
 
-	// Bind UDP socket
-	struct sockaddr_in address;
-	address.sin_family = AF_INET;
+	std::cout << "Senders should be ready. Status (0 = error, 1 = ok): " << sender_ready_status << std::endl;
 
-	if(bind_ip=="0.0.0.0") {
-		address.sin_addr.s_addr = INADDR_ANY;
-	} else {
-		if(inet_pton(AF_INET,bind_ip.c_str(),&address.sin_addr)<1) {
-			std::cerr << "Error: cannot set an IP address to bind to." << std::endl;
-			close(sfd);
+	// Create and bind the UDP sockets (one for each endpoint of each pipeline)
+	for(relayerPipeline *pipeline : pipelines) {
+		if(!pipeline->openSockets()) {
 			exit(EXIT_FAILURE);
 		}
-		std::cout << "Bind IP address: " << inet_ntoa(address.sin_addr) << std::endl;
 	}
 
-	address.sin_port = htons(listen_port);
-	socklen_t addrlen = sizeof(struct sockaddr_in);
+	// Receive buffers, able to store packets up to the largest maximum message size among all the pipelines
+	// The same buffers are used by all the pipelines, as all of them are served by the same event loop
+	int max_msg_size = 0;
 
-	// Reciving up to the maximum allowed by a MTU of 1500, when using UDP
-	uint8_t buffer[1460];
-	int buf_length = sizeof(buffer);
+	for(relayerPipeline *pipeline : pipelines) {
+		if(pipeline->getOptions().max_msg_size>max_msg_size) {
+			max_msg_size=pipeline->getOptions().max_msg_size;
+		}
 
-	if(bind(sfd,(struct sockaddr*) &address,addrlen)<0) {
-		std::cerr << "Error: cannot bind socket. Details: " << std::string(strerror(errno)) << std::endl;
-		close(sfd);
-		exit(EXIT_FAILURE);
+		// Buffers coalesced by UDP GRO can be as large as the maximum UDP payload
+		if(pipeline->getOptions().udp_gro==true) {
+			max_msg_size=RX_MAX_UDP_PAYLOAD;
+		}
 	}
 
-	int recv_bytes;
-	struct pollfd rxMon[2];
+	udpRxBatch rx_batch(max_msg_size);
 
-	rxMon[0].fd=sfd;
-	rxMon[0].revents=0;
-	rxMon[0].events=POLLIN;
-
-	rxMon[1].fd=unlock_pd[0];
-	rxMon[1].revents=0;
-	rxMon[1].events=POLLIN;
+	// One pollfd for each socket, plus the "unlock pipe" (as last element)
+	// rxSockets stores, for each socket, the corresponding pipeline and endpoint index
+	// The set is rebuilt whenever a shared-memory producer connects or disconnects
+	std::vector<struct pollfd> rxMon;
+	std::vector<std::pair<relayerPipeline *,size_t>> rxSockets;
+	bool rebuild_rxmon=true;
+	size_t unlock_idx=0;
 
 	while(terminatorFlag==false) {
-		if(poll(rxMon,2,INDEFINITE_BLOCK)>0) {
-			// Poll unlocked via received message: parse and relay the received data
-			if(rxMon[0].revents>0) {
-				recv_bytes = recvfrom(sfd, buffer, buf_length, 0, NULL, NULL);
-
-				// Discard all the received messages with a message size smaller than minimum_msg_size bytes
-				if(recv_bytes < minimum_msg_size) {
-					continue;
+		if(rebuild_rxmon==true) {
+			std::vector<int> ep_fds;
+
+			rxMon.clear();
+			rxSockets.clear();
+
+			for(relayerPipeline *pipeline : pipelines) {
+				for(size_t ep_idx=0;ep_idx<pipeline->getEndpointsCount();ep_idx++) {
+					ep_fds.clear();
+					pipeline->getPollDescriptors(ep_idx,ep_fds);
+
+					for(int fd : ep_fds) {
+						struct pollfd sockMon;
+
+						sockMon.fd=fd;
+						sockMon.revents=0;
+						sockMon.events=POLLIN;
+
+						rxMon.push_back(sockMon);
+						rxSockets.push_back(std::make_pair(pipeline,ep_idx));
+					}
 				}
+			}
 
-				if(quadk_enable==true) {
-					latlon_t curr_coordinates;
-					memcpy(&curr_coordinates,(void *) buffer, sizeof(latlon_t));
-					double lat = (double)((int) ntohl(curr_coordinates.lat))/1e7;
-					double lon = (double)((int) ntohl(curr_coordinates.lon))/1e7;
+			// Pipeline timers are stored with an endpoint index equal to SIZE_MAX
+			for(relayerPipeline *pipeline : pipelines) {
+				ep_fds.clear();
+				pipeline->getTimerDescriptors(ep_fds);
 
-					msg_relayer_obj.sendMessage_AMQP(((uint8_t*)buffer)+sizeof(latlon_t),((int)recv_bytes)-sizeof(latlon_t),lat,lon,18);
-				} else {
-					msg_relayer_obj.sendMessage_AMQP(((uint8_t*)buffer),((int)recv_bytes));
+				for(int fd : ep_fds) {
+					struct pollfd timerMon;
+
+					timerMon.fd=fd;
+					timerMon.revents=0;
+					timerMon.events=POLLIN;
+
+					rxMon.push_back(timerMon);
+					rxSockets.push_back(std::make_pair(pipeline,SIZE_MAX));
+				}
+			}
+
+			struct pollfd unlockMon;
+
+			unlock_idx=rxMon.size();
+			unlockMon.fd=unlock_pd[0];
+			unlockMon.revents=0;
+			unlockMon.events=POLLIN;
+			rxMon.push_back(unlockMon);
+
+			rebuild_rxmon=false;
+		}
+
+		// Shared-memory records still waiting in the rings are relayed without waiting for the doorbell
+		bool pending_records=false;
+
+		for(relayerPipeline *pipeline : pipelines) {
+			pending_records|=pipeline->hasPendingRecords();
+		}
+
+		if(poll(rxMon.data(),rxMon.size(),pending_records ? 0 : INDEFINITE_BLOCK)>0) {
+			if(rxMon[unlock_idx].revents>0) {
+				if(drainFlag==false) {
+					std::cerr << "The UDP-AMQP relayer has terminated due to an error." << std::endl;
 				}
-			} else if(rxMon[1].revents>0) {
-				std::cerr << "The UDP-AMQP relayer has terminated due to an error." << std::endl;
 				// Poll unlocked via pipe: just break out of the loop
 				break;
 			}
+
+			// Poll unlocked via received message(s): parse and relay the received data
+			for(size_t i=0;i<rxSockets.size();i++) {
+				if(rxMon[i].revents>0) {
+					if(rxSockets[i].second==SIZE_MAX) {
+						rxSockets[i].first->handleTimer(rxMon[i].fd);
+					} else {
+						rebuild_rxmon|=rxSockets[i].first->handleEvent(rx_batch,rxSockets[i].second,rxMon[i].fd);
+					}
+				}
+			}
 		}
+
+		if(pending_records==true) {
+			for(relayerPipeline *pipeline : pipelines) {
+				pipeline->relayPendingRecords();
+			}
+		}
+	}
+
+	// Stop the ingest before draining, relaying the messages still held by the conflation stage and writing the snapshot
+	// of the last heatmap interval
+	for(relayerPipeline *pipeline : pipelines) {
+		pipeline->closeSockets();
+		pipeline->flushConflated();
+		pipeline->flushHeatmap();
+	}
+
+	if(drainFlag==true) {
+		uint64_t flushed_msgs=0, abandoned_msgs=0;
+		std::chrono::steady_clock::time_point drain_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(drain_timeout_ms>0 ? drain_timeout_ms : 0);
+
+		std::cout << "Termination requested. Draining the pending messages (deadline: " << drain_timeout_ms << " ms)..." << std::endl;
+
+		// The settled counters of all the connections are snapshotted before waiting for any of them, so that the messages
+		// settled by a connection while the previous ones are drained are still counted as flushed
+		std::vector<uint64_t> settled_before;
+
+		for(msgrelayerAMQP *msg_relayer_ptr : relayers) {
+			settled_before.push_back(msg_relayer_ptr->getSettled());
+		}
+
+		// All the connections are drained in parallel by the Proton threads: each drain() call gets only the time left before the common deadline
+		for(size_t i=0;i<relayers.size();i++) {
+			uint64_t flushed_conn, abandoned_conn;
+			long remaining_ms=std::chrono::duration_cast<std::chrono::milliseconds>(drain_deadline-std::chrono::steady_clock::now()).count();
+
+			relayers[i]->drain(remaining_ms>0 ? remaining_ms : 0,settled_before[i],flushed_conn,abandoned_conn);
+
+			flushed_msgs+=flushed_conn;
+			abandoned_msgs+=abandoned_conn;
+		}
+
+		std::cout << "Drain completed. Flushed messages: " << flushed_msgs << " - Abandoned messages: " << abandoned_msgs << std::endl;
 	}
 
-	close(sfd);
 	close(unlock_pd[0]);
 	close(unlock_pd[1]);
 
+	for(relayerPipeline *pipeline : pipelines) {
+		pipeline->printStats();
+		delete pipeline;
+	}
+
 	return 0;
 
-}
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <time.h>
+
+#include "rxbatch.h"
+#include "timers.h"
+
+udpRxBatch::udpRxBatch(size_t max_msg_size) :
+	m_gro_buffers(0) {
+	if(max_msg_size>RX_MAX_UDP_PAYLOAD) {
+		max_msg_size=RX_MAX_UDP_PAYLOAD;
+	}
+
+	m_large_buf_size=max_msg_size>RX_SMALL_BUF_SIZE ? max_msg_size : 0;
+
+	// malloc() is used on purpose (instead of, e.g., std::vector), as it does not initialize (i.e., touch) the memory
+	m_small_slab=static_cast<uint8_t *>(malloc(RX_BATCH_SIZE*RX_SMALL_BUF_SIZE));
+	m_large_slab=m_large_buf_size>0 ? static_cast<uint8_t *>(malloc(RX_BATCH_SIZE*m_large_buf_size)) : NULL;
+
+	if(m_small_slab==NULL || (m_large_buf_size>0 && m_large_slab==NULL)) {
+		free(m_small_slab);
+		free(m_large_slab);
+		throw std::bad_alloc();
+	}
+
+	m_datagrams.reserve(RX_BATCH_SIZE);
+}
+
+udpRxBatch::~udpRxBatch() {
+	free(m_small_slab);
+	free(m_large_slab);
+}
+
+int udpRxBatch::receive(int sfd, size_t max_msg_size, bool gro) {
+	// With UDP GRO, max_msg_size applies to the single packets, while each buffer can contain up to RX_MAX_UDP_PAYLOAD bytes
+	size_t rx_size=gro ? RX_MAX_UDP_PAYLOAD : max_msg_size;
+	size_t small_len=rx_size<RX_SMALL_BUF_SIZE ? rx_size : RX_SMALL_BUF_SIZE;
+	size_t large_len=0;
+
+	if(m_large_buf_size>0 && rx_size>RX_SMALL_BUF_SIZE) {
+		large_len=(rx_size<m_large_buf_size ? rx_size : m_large_buf_size)-RX_SMALL_BUF_SIZE;
+	}
+
+	for(int i=0;i<RX_BATCH_SIZE;i++) {
+		m_iov[i][0].iov_base=m_small_slab+i*RX_SMALL_BUF_SIZE;
+		m_iov[i][0].iov_len=small_len;
+		// The first RX_SMALL_BUF_SIZE bytes of each large buffer are left free to make the payload contiguous
+		m_iov[i][1].iov_base=large_len>0 ? m_large_slab+i*m_large_buf_size+RX_SMALL_BUF_SIZE : NULL;
+		m_iov[i][1].iov_len=large_len;
+
+		memset(&m_mmsg[i].msg_hdr,0,sizeof(struct msghdr));
+		m_mmsg[i].msg_hdr.msg_name=&m_src_addr[i];
+		m_mmsg[i].msg_hdr.msg_namelen=sizeof(struct sockaddr_storage);
+		m_mmsg[i].msg_hdr.msg_iov=m_iov[i];
+		m_mmsg[i].msg_hdr.msg_iovlen=large_len>0 ? 2 : 1;
+		m_mmsg[i].msg_hdr.msg_control=m_ctrl[i];
+		m_mmsg[i].msg_hdr.msg_controllen=sizeof(m_ctrl[i]);
+	}
+
+	// MSG_TRUNC makes the kernel report the real size of the UDP payload, even when larger than the provided buffers
+	int nmsgs=recvmmsg(sfd,m_mmsg,RX_BATCH_SIZE,MSG_DONTWAIT | MSG_TRUNC,NULL);
+
+	m_datagrams.clear();
+
+	for(int i=0;i<nmsgs;i++) {
+		rx_datagram_t dgram;
+		size_t capacity=small_len+large_len;
+		size_t gso_size=0;
+
+		dgram.orig_len=m_mmsg[i].msg_len;
+		dgram.truncated=(m_mmsg[i].msg_hdr.msg_flags & MSG_TRUNC) || dgram.orig_len>capacity;
+		dgram.len=dgram.orig_len<capacity ? dgram.orig_len : capacity;
+
+		if(dgram.len>small_len) {
+			// Rare case: large packet, scattered over the two buffers of the slot -> make it contiguous
+			dgram.data=m_large_slab+i*m_large_buf_size;
+			memcpy(dgram.data,m_iov[i][0].iov_base,small_len);
+		} else {
+			dgram.data=static_cast<uint8_t *>(m_iov[i][0].iov_base);
+		}
+
+		dgram.src_addr=m_src_addr[i];
+
+		// The kernel writes only msg_namelen bytes of the source address: AF_UNIX paths are not NUL-terminated, and
+		// nothing at all is written for unbound AF_UNIX senders
+		if(m_mmsg[i].msg_hdr.msg_namelen<sizeof(sa_family_t)) {
+			memset(&dgram.src_addr,0,sizeof(dgram.src_addr));
+			dgram.src_addr.ss_family=AF_UNSPEC;
+		} else if(dgram.src_addr.ss_family==AF_UNIX) {
+			memset((uint8_t *) &dgram.src_addr+m_mmsg[i].msg_hdr.msg_namelen,0,sizeof(dgram.src_addr)-m_mmsg[i].msg_hdr.msg_namelen);
+		}
+
+		dgram.rx_ts_ns=0;
+		dgram.gro_segment=false;
+
+		for(struct cmsghdr *cmsg=CMSG_FIRSTHDR(&m_mmsg[i].msg_hdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&m_mmsg[i].msg_hdr,cmsg)) {
+			if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS) {
+				struct timespec rx_ts;
+
+				memcpy(&rx_ts,CMSG_DATA(cmsg),sizeof(rx_ts));
+				dgram.rx_ts_ns=(uint64_t) rx_ts.tv_sec*SEC_TO_NANOSEC+rx_ts.tv_nsec;
+			} else if(cmsg->cmsg_level==SOL_UDP && cmsg->cmsg_type==UDP_GRO) {
+				int gso_size_int;
+
+				memcpy(&gso_size_int,CMSG_DATA(cmsg),sizeof(gso_size_int));
+				gso_size=gso_size_int>0 ? gso_size_int : 0;
+			}
+		}
+
+		if(gso_size==0 || gso_size>=dgram.len) {
+			// Single packet (no coalescing, or GRO not enabled/not supported)
+			if(gro==true && dgram.len>max_msg_size) {
+				dgram.truncated=true;
+				dgram.len=max_msg_size;
+			}
+
+			m_datagrams.push_back(dgram);
+		} else {
+			// Coalesced buffer: all the packets have a size equal to gso_size, except for the last one, which can be shorter
+			uint8_t *buf_start=dgram.data;
+			size_t buf_len=dgram.len;
+
+			m_gro_buffers++;
+
+			for(size_t offset=0;offset<buf_len;offset+=gso_size) {
+				dgram.data=buf_start+offset;
+				dgram.orig_len=buf_len-offset<gso_size ? buf_len-offset : gso_size;
+				dgram.truncated=dgram.orig_len>max_msg_size;
+				dgram.len=dgram.truncated ? max_msg_size : dgram.orig_len;
+				dgram.gro_segment=true;
+
+				m_datagrams.push_back(dgram);
+			}
+		}
+	}
+
+	return nmsgs<0 ? -1 : (int) m_datagrams.size();
+}
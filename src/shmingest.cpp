@@ -0,0 +1,360 @@
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "shmingest.h"
+#include "endpoint.h"
+
+// Size reserved for the ring header, at the beginning of the shared memory (the ring data starts on a new page)
+#define SHM_RING_HDR_SPACE 4096
+
+// Minimum size of the ring data
+#define SHM_RING_MIN_SIZE 4096
+
+shmRingIngest::shmRingIngest(const std::string &path, size_t ring_size) :
+	m_path(path), m_listen_fd(-1), m_doorbell_fd(-1), m_pending(false) {
+	// Round the ring size up to a power of 2
+	m_ring_size=SHM_RING_MIN_SIZE;
+	while(m_ring_size<ring_size) {
+		m_ring_size<<=1;
+	}
+
+	m_datagrams.reserve(SHM_RX_BATCH_SIZE);
+}
+
+shmRingIngest::~shmRingIngest() {
+	close();
+}
+
+bool shmRingIngest::open(std::string &error) {
+	struct sockaddr_un addr;
+
+	if(m_path.size()>=sizeof(addr.sun_path)) {
+		error="control socket path too long";
+		return false;
+	}
+
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	memcpy(addr.sun_path,m_path.c_str(),m_path.size());
+
+	m_listen_fd=socket(AF_UNIX,SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+	if(m_listen_fd<0) {
+		error="cannot create the control socket: "+std::string(strerror(errno));
+		return false;
+	}
+
+	// Remove any stale control socket left by a previous run
+	unlink_stale_socket(m_path);
+
+	if(bind(m_listen_fd,(const struct sockaddr *) &addr,sizeof(addr))<0 || listen(m_listen_fd,16)<0) {
+		error="cannot bind the control socket: "+std::string(strerror(errno));
+		close();
+		return false;
+	}
+
+	m_doorbell_fd=eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+	if(m_doorbell_fd<0) {
+		error="cannot create the doorbell eventfd: "+std::string(strerror(errno));
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void shmRingIngest::close(void) {
+	while(!m_producers.empty()) {
+		removeProducer(m_producers.size()-1);
+	}
+
+	if(m_listen_fd>=0) {
+		::close(m_listen_fd);
+		m_listen_fd=-1;
+		unlink(m_path.c_str());
+	}
+
+	if(m_doorbell_fd>=0) {
+		::close(m_doorbell_fd);
+		m_doorbell_fd=-1;
+	}
+
+	m_pending=false;
+}
+
+void shmRingIngest::getPollDescriptors(std::vector<int> &fds) {
+	fds.push_back(m_listen_fd);
+	fds.push_back(m_doorbell_fd);
+
+	for(const shm_producer_t &prod : m_producers) {
+		if(prod.conn_fd>=0) {
+			fds.push_back(prod.conn_fd);
+		}
+	}
+}
+
+bool shmRingIngest::acceptProducer(void) {
+	int conn_fd=accept4(m_listen_fd,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+	if(conn_fd<0) {
+		return false;
+	}
+
+	shm_producer_t prod;
+	struct ucred cred;
+	socklen_t cred_len=sizeof(cred);
+	size_t map_size=SHM_RING_HDR_SPACE+m_ring_size;
+	void *map;
+
+	memset(&prod,0,sizeof(prod));
+	prod.conn_fd=conn_fd;
+
+	// The ring is sealed against resizing, as a producer shrinking it would crash the relayer
+	int memfd=memfd_create("udpamqp-shmring",MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+	if(memfd<0 || ftruncate(memfd,map_size)<0 ||
+		fcntl(memfd,F_ADD_SEALS,F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)<0 ||
+		(map=mmap(NULL,map_size,PROT_READ | PROT_WRITE,MAP_SHARED,memfd,0))==MAP_FAILED) {
+		std::cerr << "Error: cannot allocate the shared-memory ring for a new producer on " << m_path << ": " << strerror(errno) << std::endl;
+		if(memfd>=0) {
+			::close(memfd);
+		}
+		::close(conn_fd);
+		return false;
+	}
+
+	prod.hdr=(shmring_hdr_t *) map;
+	prod.data=(uint8_t *) map+SHM_RING_HDR_SPACE;
+	prod.map_size=map_size;
+	prod.ring_size=m_ring_size;
+	prod.max_record_size=m_ring_size/2-SHMRING_REC_ALIGN<RX_MAX_UDP_PAYLOAD ? m_ring_size/2-SHMRING_REC_ALIGN : RX_MAX_UDP_PAYLOAD;
+
+	prod.hdr->magic=SHMRING_MAGIC;
+	prod.hdr->version=SHMRING_VERSION;
+	prod.hdr->data_size=m_ring_size;
+	prod.hdr->max_record_size=prod.max_record_size;
+	prod.hdr->data_offset=SHM_RING_HDR_SPACE;
+	prod.hdr->tail=0;
+	prod.hdr->head=0;
+	// The ring is empty: the first record must ring the doorbell
+	prod.hdr->consumer_waiting=1;
+
+	// The producer PID is used as source of its records
+	struct sockaddr_un *src_un=(struct sockaddr_un *) &prod.src_addr;
+
+	src_un->sun_family=AF_UNIX;
+	if(getsockopt(conn_fd,SOL_SOCKET,SO_PEERCRED,&cred,&cred_len)==0) {
+		snprintf(src_un->sun_path,sizeof(src_un->sun_path),"pid:%d",(int) cred.pid);
+	}
+
+	// Send the protocol version, the memfd and the doorbell to the producer
+	uint32_t version=SHMRING_VERSION;
+	int fds[2]={memfd,m_doorbell_fd};
+	char ctrl[CMSG_SPACE(sizeof(fds))] __attribute__((aligned(sizeof(size_t))));
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+
+	memset(&msg,0,sizeof(msg));
+	memset(ctrl,0,sizeof(ctrl));
+	iov.iov_base=&version;
+	iov.iov_len=sizeof(version);
+	msg.msg_iov=&iov;
+	msg.msg_iovlen=1;
+	msg.msg_control=ctrl;
+	msg.msg_controllen=sizeof(ctrl);
+
+	cmsg=CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level=SOL_SOCKET;
+	cmsg->cmsg_type=SCM_RIGHTS;
+	cmsg->cmsg_len=CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg),fds,sizeof(fds));
+
+	ssize_t sent=sendmsg(conn_fd,&msg,MSG_NOSIGNAL);
+
+	// The relayer keeps only the mapping: the memory is released when both sides have unmapped it
+	::close(memfd);
+
+	if(sent!=(ssize_t) sizeof(version)) {
+		std::cerr << "Error: cannot hand the shared-memory ring to a new producer on " << m_path << ": " << strerror(errno) << std::endl;
+		munmap(map,map_size);
+		::close(conn_fd);
+		return false;
+	}
+
+	m_producers.push_back(prod);
+
+	std::cout << "New shared-memory producer (" << src_un->sun_path << ") connected on " << m_path << std::endl;
+
+	return true;
+}
+
+void shmRingIngest::removeProducer(size_t idx) {
+	shm_producer_t &prod=m_producers[idx];
+
+	if(prod.conn_fd>=0) {
+		::close(prod.conn_fd);
+	}
+	munmap(prod.hdr,prod.map_size);
+
+	m_producers.erase(m_producers.begin()+idx);
+}
+
+bool shmRingIngest::handleEvent(int fd) {
+	if(fd==m_listen_fd) {
+		bool accepted=false;
+
+		while(acceptProducer()) {
+			accepted=true;
+		}
+
+		return accepted;
+	}
+
+	if(fd==m_doorbell_fd) {
+		uint64_t count;
+
+		// Reset the doorbell: the rings are then consumed until they are empty
+		if(read(m_doorbell_fd,&count,sizeof(count))<0) {
+			// EAGAIN: spurious wake-up
+		}
+		m_pending=true;
+
+		return false;
+	}
+
+	for(shm_producer_t &prod : m_producers) {
+		if(prod.conn_fd==fd) {
+			char discard[64];
+			ssize_t ret=recv(fd,discard,sizeof(discard),MSG_DONTWAIT);
+
+			if(ret==0 || (ret<0 && errno!=EAGAIN && errno!=EWOULDBLOCK)) {
+				// Producer disconnected: its ring is released by release(), once all its records have been relayed
+				std::cout << "Shared-memory producer (" << ((struct sockaddr_un *) &prod.src_addr)->sun_path << ") disconnected from " << m_path << std::endl;
+				::close(prod.conn_fd);
+				prod.conn_fd=-1;
+				m_pending=true;
+
+				return true;
+			}
+
+			return false;
+		}
+	}
+
+	return false;
+}
+
+int shmRingIngest::receive(size_t max_msg_size) {
+	m_datagrams.clear();
+
+	for(shm_producer_t &prod : m_producers) {
+		if(prod.failed==true) {
+			continue;
+		}
+
+		uint64_t size=prod.ring_size;
+		uint64_t tail=__atomic_load_n(&prod.hdr->tail,__ATOMIC_ACQUIRE);
+
+		while(prod.head!=tail && m_datagrams.size()<SHM_RX_BATCH_SIZE) {
+			uint64_t pos=prod.head & (size-1);
+			uint32_t len;
+
+			memcpy(&len,prod.data+pos,sizeof(len));
+
+			// The producer is not trusted to write a consistent ring: stop consuming a corrupted one (the checks use the
+			// geometry stored at the connection, as the producer may also have rewritten data_size and max_record_size)
+			// Each record (or the padding up to the end of the data area) must lie between head and tail, so that the
+			// head can never skip past the tail
+			bool corrupted;
+
+			if(len==SHMRING_REC_PAD) {
+				corrupted=tail-prod.head<size-pos || tail-prod.head>size;
+			} else {
+				corrupted=len>prod.max_record_size || pos+SHMRING_REC_SIZE(len)>size || tail-prod.head<SHMRING_REC_SIZE(len) || tail-prod.head>size;
+			}
+
+			if(corrupted) {
+				std::cerr << "Error: corrupted shared-memory ring (producer " << ((struct sockaddr_un *) &prod.src_addr)->sun_path <<
+					"): disconnecting it." << std::endl;
+				prod.failed=true;
+				if(prod.conn_fd>=0) {
+					shutdown(prod.conn_fd,SHUT_RDWR);
+				}
+				break;
+			}
+
+			if(len==SHMRING_REC_PAD) {
+				prod.head+=size-pos;
+				continue;
+			}
+
+			rx_datagram_t dgram;
+
+			dgram.data=prod.data+pos+4;
+			dgram.orig_len=len;
+			dgram.truncated=len>max_msg_size;
+			dgram.len=dgram.truncated ? max_msg_size : len;
+			dgram.src_addr=prod.src_addr;
+			dgram.rx_ts_ns=0;
+			dgram.gro_segment=false;
+
+			m_datagrams.push_back(dgram);
+
+			prod.head+=SHMRING_REC_SIZE(len);
+		}
+	}
+
+	return m_datagrams.size();
+}
+
+void shmRingIngest::release(void) {
+	m_pending=false;
+
+	for(size_t i=m_producers.size();i-->0;) {
+		shm_producer_t &prod=m_producers[i];
+
+		if(prod.failed==true) {
+			// Corrupted ring: it is released as soon as the producer is disconnected
+			if(prod.conn_fd<0) {
+				removeProducer(i);
+			}
+			continue;
+		}
+
+		__atomic_store_n(&prod.hdr->head,prod.head,__ATOMIC_RELEASE);
+
+		if(prod.head!=__atomic_load_n(&prod.hdr->tail,__ATOMIC_ACQUIRE)) {
+			m_pending=true;
+		} else if(prod.conn_fd<0) {
+			// Disconnected producer, with all its records relayed
+			removeProducer(i);
+		}
+	}
+
+	if(m_pending==true) {
+		return;
+	}
+
+	// All the rings are empty: ask the producers to ring the doorbell, then check again (after a full barrier, pairing with
+	// the one of the producers) that no record has been appended in the meantime
+	for(shm_producer_t &prod : m_producers) {
+		__atomic_store_n(&prod.hdr->consumer_waiting,1,__ATOMIC_RELAXED);
+	}
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for(shm_producer_t &prod : m_producers) {
+		if(prod.failed==false && prod.head!=__atomic_load_n(&prod.hdr->tail,__ATOMIC_ACQUIRE)) {
+			m_pending=true;
+			break;
+		}
+	}
+}
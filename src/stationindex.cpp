@@ -0,0 +1,295 @@
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "stationindex.h"
+#include "spatial_keys.h"
+#include "endpoint.h"
+#include "timers.h"
+
+// Bits of each quantized coordinate dropped in the cells
+#define CELL_COORD_SHIFT (STATIONINDEX_CELL_SHIFT/2)
+#define CELL_COORD_BITS (32-CELL_COORD_SHIFT)
+
+static uint64_t position_cell(double lat, double lon) {
+	return spatial_morton(lat,lon) >> STATIONINDEX_CELL_SHIFT;
+}
+
+// Latitude of the projected y (between 0 and 1) of the Web Mercator projection
+static double mercator_lat(double y) {
+	return atan(sinh(M_PI*(1-2*y)))*180/M_PI;
+}
+
+stationIndex::stationIndex(uint64_t max_age_ms, int tile_level) :
+	m_max_age_ns(max_age_ms*MILLISEC_TO_NANOSEC), m_tile_level(tile_level), m_sfd(-1), m_updates(0), m_queries(0) {
+}
+
+stationIndex::~stationIndex() {
+	closeSocket();
+}
+
+bool stationIndex::openSocket(const std::string &path, std::string &error) {
+	struct sockaddr_un addr;
+
+	if(path.empty() || path.size()>=sizeof(addr.sun_path)) {
+		error="invalid socket path '"+path+"'";
+		return false;
+	}
+
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	memcpy(addr.sun_path,path.c_str(),path.size());
+
+	m_sfd=socket(AF_UNIX,SOCK_DGRAM | SOCK_NONBLOCK,0);
+	if(m_sfd<0) {
+		error="cannot create socket: "+std::string(strerror(errno));
+		return false;
+	}
+
+	unlink_stale_socket(path);
+
+	if(bind(m_sfd,(const struct sockaddr *) &addr,sizeof(addr))<0) {
+		error="cannot bind socket to "+path+": "+std::string(strerror(errno));
+		close(m_sfd);
+		m_sfd=-1;
+		return false;
+	}
+
+	m_path=path;
+
+	return true;
+}
+
+void stationIndex::closeSocket(void) {
+	if(m_sfd>=0) {
+		close(m_sfd);
+		unlink(m_path.c_str());
+		m_sfd=-1;
+	}
+}
+
+void stationIndex::update(uint32_t station_id, double lat, double lon, uint32_t tile_x, uint32_t tile_y, uint64_t ts_ns) {
+	uint64_t cell=position_cell(lat,lon);
+	auto result=m_stations.emplace(station_id,station_entry_t());
+	station_entry_t &entry=result.first->second;
+
+	// The ordered index is updated only when the station enters a different cell
+	if(result.second==true) {
+		m_order.emplace(cell,station_id);
+	} else if(entry.cell!=cell) {
+		m_order.erase(std::make_pair(entry.cell,station_id));
+		m_order.emplace(cell,station_id);
+	}
+
+	entry.lat=lat;
+	entry.lon=lon;
+	entry.cell=cell;
+	entry.ts_ns=ts_ns;
+	entry.tile_x=tile_x;
+	entry.tile_y=tile_y;
+	m_updates++;
+}
+
+void stationIndex::expire(uint64_t now_ns) {
+	for(auto it=m_stations.begin();it!=m_stations.end();) {
+		if(now_ns>it->second.ts_ns+m_max_age_ns) {
+			m_order.erase(std::make_pair(it->second.cell,it->first));
+			it=m_stations.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+bool stationIndex::query(double lat_min, double lon_min, double lat_max, double lon_max, int tile_level, uint32_t tile_x, uint32_t tile_y,
+	uint64_t now_ns, std::vector<std::pair<uint32_t,const station_entry_t *>> &out) {
+	uint32_t q_lat_min, q_lon_min, q_lat_max, q_lon_max;
+	std::vector<std::pair<uint64_t,uint64_t>> ranges;
+
+	// Box in cell coordinates (the quantization is monotonic, so all the positions inside the box are in these cells)
+	spatial_quantize(lat_min,lon_min,&q_lat_min,&q_lon_min);
+	spatial_quantize(lat_max,lon_max,&q_lat_max,&q_lon_max);
+	q_lat_min>>=CELL_COORD_SHIFT;
+	q_lon_min>>=CELL_COORD_SHIFT;
+	q_lat_max>>=CELL_COORD_SHIFT;
+	q_lon_max>>=CELL_COORD_SHIFT;
+
+	// The box is covered by aligned squares of 2^bits x 2^bits cells, each one being a single range of Morton codes:
+	// the smallest squares giving at most STATIONINDEX_MAX_RANGES ranges are used
+	int bits=0;
+
+	while(bits<CELL_COORD_BITS &&
+		(uint64_t) ((q_lat_max >> bits)-(q_lat_min >> bits)+1)*((q_lon_max >> bits)-(q_lon_min >> bits)+1)>STATIONINDEX_MAX_RANGES) {
+		bits++;
+	}
+
+	for(uint32_t sq_lat=q_lat_min >> bits;sq_lat<=(q_lat_max >> bits);sq_lat++) {
+		for(uint32_t sq_lon=q_lon_min >> bits;sq_lon<=(q_lon_max >> bits);sq_lon++) {
+			uint64_t lo=quadkey_morton_encode(sq_lat,sq_lon) << (2*bits);
+
+			ranges.push_back(std::make_pair(lo,lo+((uint64_t) 1 << (2*bits))));
+		}
+	}
+
+	// Merge the contiguous ranges, so that each part of the index is scanned once
+	std::sort(ranges.begin(),ranges.end());
+
+	size_t nmerged=0;
+
+	for(size_t i=0;i<ranges.size();i++) {
+		if(nmerged>0 && ranges[nmerged-1].second==ranges[i].first) {
+			ranges[nmerged-1].second=ranges[i].second;
+		} else {
+			ranges[nmerged++]=ranges[i];
+		}
+	}
+	ranges.resize(nmerged);
+
+	for(const std::pair<uint64_t,uint64_t> &range : ranges) {
+		for(auto it=m_order.lower_bound(std::make_pair(range.first,(uint32_t) 0));it!=m_order.end() && it->first<range.second;++it) {
+			const station_entry_t &entry=m_stations[it->second];
+
+			if(now_ns>entry.ts_ns+m_max_age_ns || entry.lat<lat_min || entry.lat>lat_max || entry.lon<lon_min || entry.lon>lon_max) {
+				continue;
+			}
+
+			if(tile_level>0 && ((entry.tile_x >> (m_tile_level-tile_level))!=tile_x || (entry.tile_y >> (m_tile_level-tile_level))!=tile_y)) {
+				continue;
+			}
+
+			// One more result than the maximum is looked for, to tell whether the answer is truncated
+			if(out.size()>STATIONINDEX_MAX_RESULTS) {
+				return true;
+			}
+			out.push_back(std::make_pair(it->second,&entry));
+		}
+	}
+
+	return out.size()>STATIONINDEX_MAX_RESULTS;
+}
+
+void stationIndex::answer(const char *request, std::string &reply) {
+	std::vector<std::pair<uint32_t,const station_entry_t *>> results;
+	struct timespec now;
+	char cmd[16], arg[64];
+	double lat_min, lon_min, lat_max, lon_max;
+	bool truncated=false;
+
+	clock_gettime(CLOCK_REALTIME,&now);
+	uint64_t now_ns=(uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec;
+
+	if(sscanf(request,"%15s",cmd)!=1) {
+		reply="error empty query\n";
+		return;
+	}
+
+	if(strcmp(cmd,"box")==0) {
+		if(sscanf(request,"%*s %lf %lf %lf %lf",&lat_min,&lon_min,&lat_max,&lon_max)!=4 || !(lat_min<=lat_max) || !(lon_min<=lon_max)) {
+			reply="error expected box <lat_min> <lon_min> <lat_max> <lon_max>\n";
+			return;
+		}
+		truncated=query(lat_min,lon_min,lat_max,lon_max,0,0,0,now_ns,results);
+	} else if(strcmp(cmd,"tile")==0) {
+		uint64_t qk;
+		uint32_t tile_x, tile_y;
+
+		if(sscanf(request,"%*s %63s",arg)!=1 || (qk=quadkey_string_to_ulong(arg,strlen(arg)))==0) {
+			reply="error expected tile <quadkey>\n";
+			return;
+		}
+
+		int level=quadkey_ulong_level(qk);
+
+		if(level>m_tile_level) {
+			reply="error the quadkey cannot be longer than "+std::to_string(m_tile_level)+" digits\n";
+			return;
+		}
+		quadkey_morton_decode(quadkey_ulong_morton(qk),&tile_x,&tile_y);
+
+		// Box of the tile, widened by one pixel at the level of the index, as the tiles of the relayed quadkeys are
+		// computed with rounded pixel coordinates: the results are then filtered by their tile
+		int shift=m_tile_level-level;
+		double map_size=256.0*(1U << m_tile_level);
+		double x_min=(double) (tile_x << shift)*256/map_size-1/map_size;
+		double x_max=(double) ((tile_x+1) << shift)*256/map_size+1/map_size;
+		double y_min=(double) (tile_y << shift)*256/map_size-1/map_size;
+		double y_max=(double) ((tile_y+1) << shift)*256/map_size+1/map_size;
+
+		// The positions beyond the map edges are clipped into the first/last row and column
+		lon_min=tile_x==0 ? -180 : x_min*360-180;
+		lon_max=tile_x==(1U << level)-1 ? 180 : x_max*360-180;
+		lat_max=tile_y==0 ? 90 : mercator_lat(y_min);
+		lat_min=tile_y==(1U << level)-1 ? -90 : mercator_lat(y_max);
+
+		truncated=query(lat_min,lon_min,lat_max,lon_max,level,tile_x,tile_y,now_ns,results);
+	} else if(strcmp(cmd,"station")==0) {
+		unsigned long long station_id=0;
+		char *end=arg;
+
+		// Station IDs are 32 bits unsigned integers: larger or negative values must not wrap around to another station
+		errno=0;
+		if(sscanf(request,"%*s %63s",arg)==1 && arg[0]>='0' && arg[0]<='9') {
+			station_id=strtoull(arg,&end,10);
+		}
+
+		if(end==arg || *end!='\0' || errno==ERANGE || station_id>UINT32_MAX) {
+			reply="error expected station <id> (between 0 and "+std::to_string(UINT32_MAX)+")\n";
+			return;
+		}
+
+		auto it=m_stations.find((uint32_t) station_id);
+
+		if(it!=m_stations.end() && now_ns<=it->second.ts_ns+m_max_age_ns) {
+			results.push_back(std::make_pair(it->first,&it->second));
+		}
+	} else if(strcmp(cmd,"stats")==0) {
+		reply="ok 0 stations="+std::to_string(m_stations.size())+" updates="+std::to_string(m_updates)+" queries="+std::to_string(m_queries)+"\n";
+		return;
+	} else {
+		reply="error unknown query '"+std::string(cmd)+"' (expected box, tile, station or stats)\n";
+		return;
+	}
+
+	if(truncated==true) {
+		results.resize(STATIONINDEX_MAX_RESULTS);
+	}
+
+	reply="ok "+std::to_string(results.size())+(truncated ? " truncated\n" : "\n");
+
+	for(const std::pair<uint32_t,const station_entry_t *> &result : results) {
+		char line[96];
+		uint64_t age_ms=now_ns>result.second->ts_ns ? (now_ns-result.second->ts_ns)/MILLISEC_TO_NANOSEC : 0;
+
+		snprintf(line,sizeof(line),"%" PRIu32 " %.7f %.7f %" PRIu64 "\n",result.first,result.second->lat,result.second->lon,age_ms);
+		reply+=line;
+	}
+}
+
+void stationIndex::handleQuery(void) {
+	char request[STATIONINDEX_MAX_QUERY_SIZE+1];
+	struct sockaddr_un client_addr;
+	socklen_t client_addrlen=sizeof(client_addr);
+	std::string reply;
+
+	ssize_t len=recvfrom(m_sfd,request,STATIONINDEX_MAX_QUERY_SIZE,0,(struct sockaddr *) &client_addr,&client_addrlen);
+
+	if(len<0) {
+		return;
+	}
+	request[len]='\0';
+	m_queries++;
+
+	answer(request,reply);
+
+	// Unbound clients cannot receive any answer
+	if(client_addrlen>sizeof(sa_family_t)) {
+		sendto(m_sfd,reply.data(),reply.size(),0,(const struct sockaddr *) &client_addr,client_addrlen);
+	}
+}
@@ -0,0 +1,85 @@
+#include <cmath>
+
+#include "tilecache.h"
+#include "hashtable.h"
+
+#define TILECACHE_STRADDLING_X UINT32_MAX
+
+tileCache::tileCache(double scale, int level, size_t slots) :
+	m_scale(scale), m_lookups(0), m_hits(0), m_straddles(0) {
+	size_t size=hashtable_size(slots);
+	// Tile width (at the equator, where the tiles are the tallest), in coordinate units
+	double tile_units=360*scale/(double) (1U << level);
+
+	m_mask=size-1;
+	m_entries.assign(size,tilecache_entry_t());
+
+	// The shift is kept between 1 and 30, so that the cell coordinates fit in 31 bits (see cellKey())
+	m_shift=1;
+	while(m_shift<30 && (double) ((int64_t) 1 << (m_shift+1))<=tile_units/TILECACHE_CELLS_PER_TILE) {
+		m_shift++;
+	}
+}
+
+uint64_t tileCache::cellKey(int32_t lat, int32_t lon) {
+	// Arithmetic shifts (rounding towards minus infinity), so that the cells have the same size on both sides of 0
+	uint32_t cell_lat=(uint32_t) (lat >> m_shift) & 0x7FFFFFFF;
+	uint32_t cell_lon=(uint32_t) (lon >> m_shift) & 0x7FFFFFFF;
+
+	// The highest bit is always set, as 0 marks the empty slots
+	return ((uint64_t) 1 << 63) | ((uint64_t) cell_lat << 31) | cell_lon;
+}
+
+tileCache::tilecache_entry_t &tileCache::slot(uint64_t key) {
+	return m_entries[hash_mix64(key) & m_mask];
+}
+
+tilecache_result_t tileCache::lookup(int32_t lat, int32_t lon, uint32_t &tile_x, uint32_t &tile_y) {
+	uint64_t key=cellKey(lat,lon);
+	const tilecache_entry_t &entry=slot(key);
+
+	m_lookups++;
+
+	if(entry.key!=key) {
+		return TILECACHE_MISS;
+	}
+
+	if(entry.tile_x==TILECACHE_STRADDLING_X) {
+		m_straddles++;
+		return TILECACHE_STRADDLE;
+	}
+
+	m_hits++;
+	tile_x=entry.tile_x;
+	tile_y=entry.tile_y;
+
+	return TILECACHE_HIT;
+}
+
+void tileCache::getCellCorners(int32_t lat, int32_t lon, double &lat_min, double &lon_min, double &lat_max, double &lon_max) {
+	int64_t cell_size=(int64_t) 1 << m_shift;
+	int64_t lat0=(int64_t) (lat >> m_shift) << m_shift;
+	int64_t lon0=(int64_t) (lon >> m_shift) << m_shift;
+
+	// Same conversion as the coordinate decoders (the corners are always representable as int32 values)
+	lat_min=(double) (int32_t) lat0/m_scale;
+	lon_min=(double) (int32_t) lon0/m_scale;
+	lat_max=(double) (int32_t) (lat0+cell_size-1)/m_scale;
+	lon_max=(double) (int32_t) (lon0+cell_size-1)/m_scale;
+}
+
+bool tileCache::insert(int32_t lat, int32_t lon, uint32_t min_tile_x, uint32_t min_tile_y, uint32_t max_tile_x, uint32_t max_tile_y) {
+	uint64_t key=cellKey(lat,lon);
+	tilecache_entry_t &entry=slot(key);
+	bool single_tile=min_tile_x==max_tile_x && min_tile_y==max_tile_y;
+
+	entry.key=key;
+	entry.tile_x=single_tile ? min_tile_x : TILECACHE_STRADDLING_X;
+	entry.tile_y=min_tile_y;
+
+	if(!single_tile) {
+		m_straddles++;
+	}
+
+	return single_tile;
+}
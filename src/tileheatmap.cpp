@@ -0,0 +1,161 @@
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+
+#include "tileheatmap.h"
+#include "quadkey_morton.h"
+#include "timers.h"
+#include "hashtable.h"
+
+bool parse_heatmap_format(const std::string &name, heatmap_format_t &format) {
+	if(name=="csv") {
+		format=HEATMAP_FORMAT_CSV;
+	} else if(name=="binary") {
+		format=HEATMAP_FORMAT_BINARY;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+tileHeatmap::tileHeatmap(unsigned int level, unsigned int tile_level, uint64_t start_ns, size_t slots) :
+	m_level(level), m_shift(tile_level-level), m_snapshots(0) {
+	size_t size=hashtable_size(slots);
+
+	m_mask=size-1;
+	// The load factor is limited in each table
+	m_max_used=hashtable_max_used(size);
+
+	for(heatmap_table_t &table : m_tables) {
+		table.slots.assign(size,heatmap_record_t());
+		table.used=0;
+		table.untracked_messages=0;
+		table.untracked_bytes=0;
+		table.start_ns=start_ns;
+	}
+
+	m_active=&m_tables[0];
+	m_standby=&m_tables[1];
+}
+
+void tileHeatmap::add(uint32_t tile_x, uint32_t tile_y, size_t bytes) {
+	uint64_t qk=quadkey_ulong_encode(tile_x >> m_shift,tile_y >> m_shift,m_level);
+	heatmap_table_t &table=*m_active;
+	size_t idx=hash_mix64(qk) & m_mask;
+
+	while(table.slots[idx].quadkey!=qk) {
+		if(table.slots[idx].quadkey==0) {
+			// New tile (if the table is not full)
+			if(table.used>=m_max_used) {
+				table.untracked_messages++;
+				table.untracked_bytes+=bytes;
+				return;
+			}
+			table.slots[idx].quadkey=qk;
+			table.used++;
+			break;
+		}
+		idx=(idx+1) & m_mask;
+	}
+
+	table.slots[idx].messages++;
+	table.slots[idx].bytes+=bytes;
+}
+
+bool tileHeatmap::rotate(uint64_t now_ns, const std::string &path, heatmap_format_t format, std::string &error) {
+	std::vector<heatmap_record_t> records;
+	std::string tmp_path=path + ".tmp";
+	heatmap_table_t *ended=m_active;
+	bool written;
+
+	// The next interval starts on the empty table
+	m_active=m_standby;
+	m_standby=ended;
+	m_active->start_ns=now_ns;
+
+	records.reserve(ended->used);
+	for(const heatmap_record_t &record : ended->slots) {
+		if(record.quadkey!=0) {
+			records.push_back(record);
+		}
+	}
+	// Same order as the quadkey strings (all the tiles have the same level), i.e., nearby tiles are mostly close to each other
+	std::sort(records.begin(),records.end(),[](const heatmap_record_t &a, const heatmap_record_t &b) {
+		return a.quadkey<b.quadkey;
+	});
+
+	if(format==HEATMAP_FORMAT_BINARY) {
+		written=writeBinary(*ended,records,now_ns,tmp_path);
+	} else {
+		written=writeCSV(*ended,records,now_ns,tmp_path);
+	}
+
+	if(ended->used>0) {
+		memset(ended->slots.data(),0,ended->slots.size()*sizeof(heatmap_record_t));
+	}
+	ended->used=0;
+	ended->untracked_messages=0;
+	ended->untracked_bytes=0;
+
+	if(!written) {
+		error="cannot write " + tmp_path + ": " + strerror(errno);
+		return false;
+	}
+
+	// Readers always see a complete snapshot
+	if(rename(tmp_path.c_str(),path.c_str())<0) {
+		error="cannot rename " + tmp_path + " to " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	m_snapshots++;
+
+	return true;
+}
+
+bool tileHeatmap::writeCSV(const heatmap_table_t &table, const std::vector<heatmap_record_t> &records, uint64_t end_ns, const std::string &path) {
+	FILE *fp=fopen(path.c_str(),"w");
+	char qk_str[QUADKEY_MAX_LEVEL+1];
+
+	if(fp==NULL) {
+		return false;
+	}
+
+	fprintf(fp,"interval_start_ms,interval_end_ms,quadkey,messages,bytes\n");
+	for(const heatmap_record_t &record : records) {
+		quadkey_ulong_to_string(record.quadkey,qk_str);
+		fprintf(fp,"%" PRIu64 ",%" PRIu64 ",%s,%" PRIu64 ",%" PRIu64 "\n",table.start_ns/MILLISEC_TO_NANOSEC,end_ns/MILLISEC_TO_NANOSEC,
+			qk_str,record.messages,record.bytes);
+	}
+
+	bool ok=!ferror(fp);
+
+	return fclose(fp)==0 && ok;
+}
+
+bool tileHeatmap::writeBinary(const heatmap_table_t &table, const std::vector<heatmap_record_t> &records, uint64_t end_ns, const std::string &path) {
+	FILE *fp=fopen(path.c_str(),"wb");
+	heatmap_header_t header;
+	bool ok;
+
+	if(fp==NULL) {
+		return false;
+	}
+
+	header.magic=HEATMAP_BINARY_MAGIC;
+	header.level=m_level;
+	header.start_ns=table.start_ns;
+	header.end_ns=end_ns;
+	header.tiles=records.size();
+	header.untracked_messages=table.untracked_messages;
+	header.untracked_bytes=table.untracked_bytes;
+
+	ok=fwrite(&header,sizeof(header),1,fp)==1;
+	if(ok && !records.empty()) {
+		ok=fwrite(records.data(),sizeof(heatmap_record_t),records.size(),fp)==records.size();
+	}
+
+	return fclose(fp)==0 && ok;
+}
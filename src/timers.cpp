@@ -10,6 +10,12 @@
 #define POLL_DEFINE_JUNK_VARIABLE() long int junk
 #define POLL_CLEAR_EVENT(clockFd) junk=read(clockFd,&junk,sizeof(junk))
 
+Timer::~Timer() {
+	if(m_clock_fd>=0) {
+		close(m_clock_fd);
+	}
+}
+
 bool 
 Timer::start() {
 	struct itimerspec new_value;
@@ -42,6 +48,7 @@ Timer::start() {
 	// Start timer
 	if(timerfd_settime(m_clock_fd,NO_FLAGS_TIMER,&new_value,NULL)==-1) {
 		close(m_clock_fd);
+		m_clock_fd=-1;
 		return false;
 	}
 
@@ -82,6 +89,7 @@ Timer::rearm(uint64_t time_ms) {
 	// Rearm timer with the new value
 	if(timerfd_settime(m_clock_fd,NO_FLAGS_TIMER,&new_value,NULL)==-1) {
 		close(m_clock_fd);
+		m_clock_fd=-1;
 		return -2;
 	}
 
@@ -0,0 +1,706 @@
+// Consistency checks of the quadkey computations (run with "make check")
+// - batch: LatLonToTileXYBatch(), with each instruction set supported by the CPU, against the scalar LatLonToTileXY(),
+//   on random points, on latitudes next to the tile edges and on special values (+/-85.05, +/-180, poles, NaN)
+// - quadkey strings: quadkey_string_to_ulong()/quadkey_ulong_to_string() round trip, invalid strings, and
+//   quadkey_ulong_range() against the string prefixes
+// - geohash: spatial_geohash() on reference geohashes and on the map corners, and, on random points, against the
+//   cells obtained by decoding the geohashes
+// - neighbors: quadkey_ulong_neighbors() on known tiles, and on random tiles (including the ones on the north and south
+//   edges of the map and next to 180 degrees of longitude) against their expected coordinates
+// - tile cache: tiles obtained through tileCache (hits, misses and straddling cells) against LatLonToTileXY(), for
+//   vehicles moving by a few meters at each message, random points and points around the tile edges
+// - coordinates validation: coord_validate() on the ETSI "unavailable" values (with and without the sentinels
+//   detection), the +/-90 and +/-180 bounds, the values just beyond them, NaN and infinities, on raw values and on int32
+//   payloads decoded by the relayer decoders
+// - exhaustive: the interpolated LatLonToTileXY() against LatLonToTileXYExact(), for every latitude representable as an
+//   int32 value in 1e-7 degrees (as decoded by the relayer), at levels 14-18
+// The program exits with a non-zero status if any result differs
+// An optional argument sets the step between the latitudes of the exhaustive check (default: 1, i.e., all of them),
+// to get a quicker, partial check
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "quadkey_ts_simple.h"
+#include "quadkey_morton.h"
+#include "tilecache.h"
+#include "spatial_keys.h"
+#include "coord_decoders.h"
+
+#define CHECK_MIN_LEVEL 14
+#define CHECK_MAX_LEVEL 18
+
+// Random points of each level and instruction set (the number is not a multiple of the vector width, so that the
+// scalar remainder of the batch functions is checked too)
+#define CHECK_RANDOM_POINTS 1000003
+// Tile edges of each level, each one checked at the edge latitude and at the next representable values around it
+#define CHECK_EDGES 100000
+
+// Random quadkeys of each level of the string/binary conversions
+#define CHECK_QUADKEYS 100000
+
+// Random points of the geohash check
+#define CHECK_GEOHASH_POINTS 1000000
+
+// Random tiles of each level of the neighbors check
+#define CHECK_NEIGHBOR_TILES 100000
+
+// Positions of each level checked through the tile cache, and number of simulated vehicles
+#define CHECK_CACHE_POINTS 1000000
+#define CHECK_CACHE_VEHICLES 2000
+
+// Range of the int32 latitudes (in 1e-7 degrees) of the exhaustive check
+#define CHECK_LAT_INT_MAX 900000000L
+
+using namespace QuadKeys;
+
+// Latitude of the tile edge above the row "tile_y" (i.e., the latitude at which the pixel Y coordinate of
+// LatLonToTileXY() becomes 256*tile_y)
+static double edge_latitude(uint32_t tile_y, int level) {
+	double map_size=(double) (256U << level);
+	double y=(256.0*tile_y-0.5)/map_size;
+
+	return atan(sinh(M_PI*(1-2*y)))*180/M_PI;
+}
+
+// Compare the batch results with the scalar ones, returning the number of differences
+static unsigned long compare_batch(QuadKeyTSSimple &ts, const std::vector<double> &lat, const std::vector<double> &lon) {
+	std::vector<uint32_t> batch_x(lat.size()), batch_y(lat.size());
+	unsigned long mismatches=0;
+
+	ts.LatLonToTileXYBatch(lat.data(),lon.data(),lat.size(),batch_x.data(),batch_y.data());
+
+	for(size_t i=0;i<lat.size();i++) {
+		uint32_t x, y;
+
+		ts.LatLonToTileXY(lat[i],lon[i],x,y);
+
+		if(x!=batch_x[i] || y!=batch_y[i]) {
+			if(mismatches<10) {
+				std::cout << "  Mismatch at level " << ts.getLevelOfDetail() << ": " << lat[i] << ", " << lon[i] << " -> scalar " <<
+					x << "/" << y << ", batch " << batch_x[i] << "/" << batch_y[i] << std::endl;
+			}
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+static unsigned long check_batch(void) {
+	static const char *implementations[]={"avx512","avx2","scalar"};
+	const char *default_impl=QuadKeyTSSimple::getBatchImplementation();
+	unsigned long total_mismatches=0;
+
+	std::cout.precision(17);
+	std::cout << "Batch tile computation (default implementation: " << default_impl << ")" << std::endl;
+
+	for(const char *impl : implementations) {
+		if(!QuadKeyTSSimple::setBatchImplementation(impl)) {
+			std::cout << " - " << impl << ": not supported by this CPU, skipped" << std::endl;
+			continue;
+		}
+
+		std::mt19937_64 rng(42);
+		unsigned long mismatches=0, points=0;
+
+		for(int level=CHECK_MIN_LEVEL;level<=CHECK_MAX_LEVEL;level++) {
+			QuadKeyTSSimple ts;
+			std::vector<double> lat, lon;
+			std::uniform_real_distribution<double> rand_lat(-90,90), rand_lon(-181,181);
+
+			ts.setLevelOfDetail(level);
+
+			for(int i=0;i<CHECK_RANDOM_POINTS;i++) {
+				lat.push_back(rand_lat(rng));
+				lon.push_back(rand_lon(rng));
+			}
+
+			for(int i=0;i<CHECK_EDGES;i++) {
+				double edge=edge_latitude(rng() % (1U << level),level);
+
+				lat.push_back(edge);
+				lat.push_back(std::nextafter(edge,90.0));
+				lat.push_back(std::nextafter(edge,-90.0));
+				for(int j=0;j<3;j++) {
+					lon.push_back(rand_lon(rng));
+				}
+			}
+
+			// Limits of the Web Mercator projection, antimeridian, poles and NaN
+			static const double special_lat[]={85.05112878,-85.05112878,85.0511287798,-85.0511287798,85.1,-85.1,90,-90,0,NAN};
+			static const double special_lon[]={180,-180,179.9999999,-179.9999999,0,NAN};
+
+			for(double special_la : special_lat) {
+				for(double special_lo : special_lon) {
+					lat.push_back(special_la);
+					lon.push_back(special_lo);
+				}
+			}
+
+			mismatches+=compare_batch(ts,lat,lon);
+			points+=lat.size();
+		}
+
+		std::cout << " - " << impl << ": " << points << " points, " << mismatches << " mismatches" << std::endl;
+		total_mismatches+=mismatches;
+	}
+
+	QuadKeyTSSimple::setBatchImplementation(default_impl);
+
+	return total_mismatches;
+}
+
+// Quadkey string computed digit by digit, as TileXYToQuadKey() (which is limited to levels 14-18)
+static std::string reference_quadkey(uint32_t tile_x, uint32_t tile_y, unsigned int level) {
+	std::string quadkey;
+
+	for(unsigned int i=level;i>0;i--) {
+		quadkey.push_back('0'+(char) (((tile_x >> (i-1)) & 1)+2*((tile_y >> (i-1)) & 1)));
+	}
+
+	return quadkey;
+}
+
+static unsigned long check_quadkey_strings(void) {
+	std::mt19937_64 rng(42);
+	unsigned long mismatches=0, checked=0;
+	char str[QUADKEY_MAX_LEVEL+1], prefix_str[QUADKEY_MAX_LEVEL+1];
+
+	std::cout << "Quadkey string/binary conversions" << std::endl;
+
+	for(unsigned int level=1;level<=QUADKEY_MAX_LEVEL;level++) {
+		uint32_t mask=(uint32_t) ((1ULL << level)-1);
+
+		for(int i=0;i<CHECK_QUADKEYS;i++) {
+			uint32_t tile_x=(uint32_t) rng() & mask, tile_y=(uint32_t) rng() & mask;
+			uint64_t qk=quadkey_ulong_encode(tile_x,tile_y,level);
+			std::string expected=reference_quadkey(tile_x,tile_y,level);
+			size_t len=quadkey_ulong_to_string(qk,str);
+			bool ok=len==level && expected==str && quadkey_string_to_ulong(str,len)==qk;
+
+			// Range of a random prefix: a quadkey is inside it if and only if its string starts with the prefix
+			unsigned int prefix_level=1+rng() % level;
+			uint64_t prefix=quadkey_string_to_ulong(expected.c_str(),prefix_level);
+			uint64_t other=quadkey_ulong_encode((uint32_t) rng() & mask,(uint32_t) rng() & mask,level);
+			uint64_t lo, hi;
+
+			quadkey_ulong_to_string(prefix,prefix_str);
+			quadkey_ulong_to_string(other,str);
+			ok=ok && quadkey_ulong_range(prefix,level,&lo,&hi)==1 && qk>=lo && qk<hi &&
+				(other>=lo && other<hi)==(strncmp(str,prefix_str,prefix_level)==0);
+
+			if(!ok) {
+				if(mismatches<10) {
+					std::cout << "  Mismatch at level " << level << ": tile " << tile_x << "/" << tile_y << " (" << expected << "), prefix " << prefix_str << std::endl;
+				}
+				mismatches++;
+			}
+			checked++;
+		}
+	}
+
+	// Invalid strings and levels
+	static const char *invalid[]={"","4","012a","012345670123456701234567012"};
+
+	for(const char *inv : invalid) {
+		if(quadkey_string_to_ulong(inv,strlen(inv))!=0) {
+			std::cout << "  Invalid quadkey \"" << inv << "\" accepted" << std::endl;
+			mismatches++;
+		}
+		checked++;
+	}
+
+	uint64_t lo, hi;
+	uint64_t qk=quadkey_string_to_ulong("0123",4);
+
+	if(quadkey_ulong_to_string(0,str)!=0 || quadkey_ulong_range(qk,3,&lo,&hi)!=0 || quadkey_ulong_range(qk,QUADKEY_MAX_LEVEL+1,&lo,&hi)!=0) {
+		std::cout << "  Invalid level accepted" << std::endl;
+		mismatches++;
+	}
+	checked++;
+
+	std::cout << " - " << checked << " quadkeys, " << mismatches << " mismatches" << std::endl;
+
+	return mismatches;
+}
+
+// Decode "geohash" into the bounds of its cell, with the usual bisection algorithm
+static void decode_geohash(const char *geohash, double &lat_min, double &lat_max, double &lon_min, double &lon_max) {
+	static const char base32[]="0123456789bcdefghjkmnpqrstuvwxyz";
+	bool lon_bit=true;
+
+	lat_min=-90;
+	lat_max=90;
+	lon_min=-180;
+	lon_max=180;
+
+	for(const char *c=geohash;*c!='\0';c++) {
+		int value=(int) (strchr(base32,*c)-base32);
+
+		for(int bit=4;bit>=0;bit--) {
+			double &min=lon_bit ? lon_min : lat_min;
+			double &max=lon_bit ? lon_max : lat_max;
+			double mid=(min+max)/2;
+
+			if((value >> bit) & 1) {
+				min=mid;
+			} else {
+				max=mid;
+			}
+			lon_bit=!lon_bit;
+		}
+	}
+}
+
+static unsigned long check_geohash(void) {
+	static const struct {
+		double lat, lon;
+		unsigned int precision;
+		const char *expected;
+	} known[]={
+		{57.64911,10.40744,11,"u4pruydqqvj"},
+		{42.6,-5.6,5,"ezs42"},
+		{-25.382708,-49.265506,12,"6gkzwgjzn820"},
+		{90,180,4,"zzzz"},
+		{-90,-180,4,"0000"},
+		{90,-180,4,"bpbp"},
+		{-90,180,4,"pbpb"}
+	};
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> rand_lat(-90,90), rand_lon(-180,180);
+	unsigned long mismatches=0, checked=0;
+	char geohash[SPATIAL_GEOHASH_MAX_PRECISION+1];
+
+	std::cout << "Geohash" << std::endl;
+
+	for(const auto &k : known) {
+		spatial_geohash(spatial_morton(k.lat,k.lon),k.precision,geohash);
+
+		if(strcmp(geohash,k.expected)!=0) {
+			std::cout << "  Mismatch at " << k.lat << ", " << k.lon << ": " << geohash << ", expected " << k.expected << std::endl;
+			mismatches++;
+		}
+		checked++;
+	}
+
+	for(int i=0;i<CHECK_GEOHASH_POINTS;i++) {
+		double lat=rand_lat(rng), lon=rand_lon(rng);
+		unsigned int precision=1+i % SPATIAL_GEOHASH_MAX_PRECISION;
+		double lat_min, lat_max, lon_min, lon_max;
+		// The quantization to 32 bits integers may move a point by less than 1e-7 degrees
+		const double eps=1e-7;
+
+		spatial_geohash(spatial_morton(lat,lon),precision,geohash);
+		decode_geohash(geohash,lat_min,lat_max,lon_min,lon_max);
+
+		if(strlen(geohash)!=precision || lat<lat_min-eps || lat>lat_max+eps || lon<lon_min-eps || lon>lon_max+eps) {
+			if(mismatches<10) {
+				std::cout << "  Mismatch at " << lat << ", " << lon << ": " << geohash << std::endl;
+			}
+			mismatches++;
+		}
+		checked++;
+	}
+
+	std::cout << " - " << checked << " points, " << mismatches << " mismatches" << std::endl;
+
+	return mismatches;
+}
+
+// Neighbors of (tile_x, tile_y), in the same order as quadkey_ulong_neighbors() (the tile itself, then N, NE, E, SE, S,
+// SW, W, NW), computed with signed coordinates and a modulo, instead of the masks used by quadkey_ulong_neighbors()
+static size_t reference_neighbors(uint32_t tile_x, uint32_t tile_y, unsigned int level, uint32_t *x, uint32_t *y) {
+	static const int dx[9]={0,0,1,1,1,0,-1,-1,-1};
+	static const int dy[9]={0,-1,-1,0,1,1,1,0,-1};
+	int64_t size=(int64_t) 1 << level;
+	size_t count=0;
+
+	for(int i=0;i<9;i++) {
+		int64_t ny=(int64_t) tile_y+dy[i];
+
+		if(ny<0 || ny>=size) {
+			continue;
+		}
+		x[count]=(uint32_t) ((((int64_t) tile_x+dx[i]) % size+size) % size);
+		y[count]=(uint32_t) ny;
+		count++;
+	}
+
+	return count;
+}
+
+static unsigned long check_neighbors(void) {
+	// Tiles of level 2: north-west corner (north edge and antimeridian wrap), inner tile, south-east corner
+	static const struct {
+		uint32_t tile_x, tile_y;
+		const char *expected;
+	} known[]={
+		{0,0,"00 01 03 02 13 11"},
+		{1,1,"03 01 10 12 30 21 20 02 00"},
+		{3,3,"33 31 20 22 32 30"}
+	};
+	std::mt19937_64 rng(42);
+	unsigned long mismatches=0, checked=0;
+
+	std::cout << "Neighbor tiles" << std::endl;
+
+	for(const auto &k : known) {
+		uint64_t tiles[QUADKEY_NEIGHBORS_MAX];
+		char str[QUADKEY_MAX_LEVEL+1];
+		size_t count=quadkey_ulong_neighbors(k.tile_x,k.tile_y,2,tiles);
+		std::string result;
+
+		for(size_t i=0;i<count;i++) {
+			quadkey_ulong_to_string(tiles[i],str);
+			result+=(i>0 ? " " : "")+std::string(str);
+		}
+
+		if(result!=k.expected) {
+			std::cout << "  Mismatch for tile " << k.tile_x << "/" << k.tile_y << ": " << result << ", expected " << k.expected << std::endl;
+			mismatches++;
+		}
+		checked++;
+	}
+
+	for(unsigned int level=2;level<=QUADKEY_MAX_LEVEL;level++) {
+		uint32_t max=(uint32_t) ((1ULL << level)-1);
+
+		for(int i=0;i<CHECK_NEIGHBOR_TILES;i++) {
+			uint32_t tile_x=(uint32_t) rng() & max, tile_y=(uint32_t) rng() & max;
+			uint64_t tiles[QUADKEY_NEIGHBORS_MAX];
+			uint32_t x[9], y[9];
+
+			// A quarter of the tiles on the edges of the map
+			switch(i % 8) {
+				case 0: tile_y=0; break;
+				case 1: tile_y=max; break;
+				case 2: tile_x=0; break;
+				case 3: tile_x=max; break;
+			}
+
+			size_t count=quadkey_ulong_neighbors(tile_x,tile_y,level,tiles);
+			bool ok=count==reference_neighbors(tile_x,tile_y,level,x,y) && count==(tile_y==0 || tile_y==max ? 6U : 9U);
+
+			for(size_t j=0;ok && j<count;j++) {
+				uint32_t nx, ny;
+
+				quadkey_morton_decode(quadkey_ulong_morton(tiles[j]),&nx,&ny);
+				ok=quadkey_ulong_level(tiles[j])==level && nx==x[j] && ny==y[j];
+			}
+
+			if(!ok) {
+				if(mismatches<10) {
+					std::cout << "  Mismatch at level " << level << ": tile " << tile_x << "/" << tile_y << std::endl;
+				}
+				mismatches++;
+			}
+			checked++;
+		}
+	}
+
+	std::cout << " - " << checked << " tiles, " << mismatches << " mismatches" << std::endl;
+
+	return mismatches;
+}
+
+// Tile of the int32 coordinates (lat, lon), in 1e-7 degrees, looked up in "cache" in the same way as the relayer does
+static void cached_tile(QuadKeyTSSimple &ts, tileCache &cache, int32_t lat, int32_t lon, uint32_t &tile_x, uint32_t &tile_y) {
+	tilecache_result_t result=cache.lookup(lat,lon,tile_x,tile_y);
+
+	if(result==TILECACHE_MISS) {
+		double lat_min, lon_min, lat_max, lon_max;
+		uint32_t min_x, min_y, max_x, max_y;
+
+		cache.getCellCorners(lat,lon,lat_min,lon_min,lat_max,lon_max);
+		ts.LatLonToTileXY(lat_min,lon_min,min_x,min_y);
+		ts.LatLonToTileXY(lat_max,lon_max,max_x,max_y);
+
+		if(cache.insert(lat,lon,min_x,min_y,max_x,max_y)) {
+			tile_x=min_x;
+			tile_y=min_y;
+			return;
+		}
+	}
+
+	if(result!=TILECACHE_HIT) {
+		ts.LatLonToTileXY((double) lat/1e7,(double) lon/1e7,tile_x,tile_y);
+	}
+}
+
+static void compare_cached(QuadKeyTSSimple &ts, tileCache &cache, int32_t lat, int32_t lon, unsigned long &mismatches) {
+	uint32_t x, y, cached_x, cached_y;
+
+	ts.LatLonToTileXY((double) lat/1e7,(double) lon/1e7,x,y);
+	cached_tile(ts,cache,lat,lon,cached_x,cached_y);
+
+	if(x!=cached_x || y!=cached_y) {
+		if(mismatches<10) {
+			std::cout << "  Mismatch at level " << ts.getLevelOfDetail() << ": " << lat << ", " << lon << " -> direct " <<
+				x << "/" << y << ", cached " << cached_x << "/" << cached_y << std::endl;
+		}
+		mismatches++;
+	}
+}
+
+static unsigned long check_tile_cache(void) {
+	std::mt19937_64 rng(42);
+	unsigned long mismatches=0;
+
+	std::cout << "Tile cache" << std::endl;
+
+	for(int level=CHECK_MIN_LEVEL;level<=CHECK_MAX_LEVEL;level++) {
+		QuadKeyTSSimple ts;
+		tileCache cache(1e7,level);
+		std::vector<int32_t> veh_lat(CHECK_CACHE_VEHICLES), veh_lon(CHECK_CACHE_VEHICLES);
+		unsigned long level_mismatches=0;
+
+		ts.setLevelOfDetail(level);
+
+		for(int v=0;v<CHECK_CACHE_VEHICLES;v++) {
+			veh_lat[v]=(int32_t) (rng() % 1600000000)-800000000;
+			veh_lon[v]=(int32_t) (rng() % 3600000000ULL)-1800000000;
+		}
+
+		for(int i=0;i<CHECK_CACHE_POINTS;i++) {
+			int v=i % CHECK_CACHE_VEHICLES;
+
+			if(i % 10==9) {
+				// Random point, over the whole int32 range accepted by the relayer
+				compare_cached(ts,cache,(int32_t) (rng() % 1800000001ULL)-900000000,(int32_t) (rng() % 3600000001ULL)-1800000000,level_mismatches);
+			} else {
+				// Vehicle moving by up to about 3 m
+				veh_lat[v]+=(int32_t) (rng() % 601)-300;
+				veh_lon[v]+=(int32_t) (rng() % 601)-300;
+				compare_cached(ts,cache,veh_lat[v],veh_lon[v],level_mismatches);
+			}
+		}
+
+		// Points around the tile edges, where the cells straddle two tiles
+		for(int i=0;i<CHECK_EDGES/10;i++) {
+			int32_t edge_lat=(int32_t) lround(edge_latitude(rng() % (1U << level),level)*1e7);
+			int32_t edge_lon=(int32_t) llround(((double) (rng() % (1U << level))*360/(1U << level)-180)*1e7);
+
+			for(int d=-3;d<=3;d++) {
+				compare_cached(ts,cache,edge_lat+d,edge_lon-d,level_mismatches);
+			}
+		}
+
+		std::cout << " - level " << level << ": hit ratio " << 100*cache.getHits()/cache.getLookups() << "%, " << cache.getStraddles() <<
+			" straddling cells, " << level_mismatches << " mismatches" << std::endl;
+		mismatches+=level_mismatches;
+	}
+
+	return mismatches;
+}
+
+static const char *coord_status_name(coord_status_t status) {
+	switch(status) {
+		case COORD_VALID: return "valid";
+		case COORD_UNAVAILABLE: return "unavailable";
+		case COORD_OUT_OF_RANGE: return "out of range";
+		default: return "invalid status";
+	}
+}
+
+static unsigned long check_coord_validate(void) {
+	static const double inf=INFINITY;
+	static const double nan=NAN;
+	static const struct {
+		double lat, lon;
+		bool has_int;
+		int32_t lat_int, lon_int;
+		bool sentinels;
+		coord_status_t expected;
+	} known[]={
+		// Inclusive bounds, and the next representable values beyond them
+		{0,0,false,0,0,false,COORD_VALID},
+		{90,180,false,0,0,false,COORD_VALID},
+		{-90,-180,false,0,0,false,COORD_VALID},
+		{90,-180,false,0,0,true,COORD_VALID},
+		{nextafter(90.0,100.0),0,false,0,0,false,COORD_OUT_OF_RANGE},
+		{nextafter(-90.0,-100.0),0,false,0,0,false,COORD_OUT_OF_RANGE},
+		{0,nextafter(180.0,200.0),false,0,0,false,COORD_OUT_OF_RANGE},
+		{0,nextafter(-180.0,-200.0),false,0,0,false,COORD_OUT_OF_RANGE},
+		{1e300,-1e300,false,0,0,false,COORD_OUT_OF_RANGE},
+		// Infinities are out of range, NaN is unavailable (even together with an out of range value)
+		{inf,0,false,0,0,false,COORD_OUT_OF_RANGE},
+		{0,-inf,false,0,0,false,COORD_OUT_OF_RANGE},
+		{nan,0,false,0,0,false,COORD_UNAVAILABLE},
+		{0,nan,false,0,0,false,COORD_UNAVAILABLE},
+		{nan,inf,false,0,0,false,COORD_UNAVAILABLE},
+		{-inf,nan,false,0,0,true,COORD_UNAVAILABLE},
+		// ETSI "unavailable" values: detected only with the sentinels and valid integer coordinates, else out of range
+		{ETSI_LAT_UNAVAILABLE/1e7,45,true,ETSI_LAT_UNAVAILABLE,450000000,true,COORD_UNAVAILABLE},
+		{45,ETSI_LON_UNAVAILABLE/1e7,true,450000000,ETSI_LON_UNAVAILABLE,true,COORD_UNAVAILABLE},
+		{ETSI_LAT_UNAVAILABLE/1e7,ETSI_LON_UNAVAILABLE/1e7,true,ETSI_LAT_UNAVAILABLE,ETSI_LON_UNAVAILABLE,true,COORD_UNAVAILABLE},
+		{ETSI_LAT_UNAVAILABLE/1e7,45,true,ETSI_LAT_UNAVAILABLE,450000000,false,COORD_OUT_OF_RANGE},
+		{45,ETSI_LON_UNAVAILABLE/1e7,true,450000000,ETSI_LON_UNAVAILABLE,false,COORD_OUT_OF_RANGE},
+		{ETSI_LAT_UNAVAILABLE/1e7,45,false,ETSI_LAT_UNAVAILABLE,450000000,true,COORD_OUT_OF_RANGE},
+		// The sentinels are integer values: a valid position with the same integers in the other coordinate is valid
+		{45,7,true,450000000,70000000,true,COORD_VALID},
+		{-90,-180,true,-900000000,-1800000000,true,COORD_VALID},
+		{-90.0000001,0,true,-900000001,0,true,COORD_OUT_OF_RANGE},
+		{0,-180.0000001,true,0,-1800000001,true,COORD_OUT_OF_RANGE}
+	};
+	// int32 payloads (big endian, 1e-7 degrees), decoded as the relayer does with "--coord-format i32be"
+	static const struct {
+		int32_t lat, lon;
+		coord_status_t expected;
+	} payloads[]={
+		{900000000,1800000000,COORD_VALID},
+		{-900000000,-1800000000,COORD_VALID},
+		{900000001,0,COORD_UNAVAILABLE},
+		{0,1800000001,COORD_UNAVAILABLE},
+		{-900000001,0,COORD_OUT_OF_RANGE},
+		{900000002,0,COORD_OUT_OF_RANGE},
+		{0,-1800000001,COORD_OUT_OF_RANGE},
+		{0,1800000002,COORD_OUT_OF_RANGE},
+		{INT32_MIN,INT32_MAX,COORD_OUT_OF_RANGE}
+	};
+	unsigned long mismatches=0, checked=0;
+
+	std::cout << "Coordinates validation" << std::endl;
+
+	for(const auto &k : known) {
+		coord_decoded_t c;
+
+		memset(&c,0,sizeof(c));
+		c.lat=k.lat;
+		c.lon=k.lon;
+		c.has_int=k.has_int;
+		c.lat_int=k.lat_int;
+		c.lon_int=k.lon_int;
+
+		coord_status_t status=coord_validate(c,k.sentinels);
+
+		if(status!=k.expected) {
+			std::cout << "  Mismatch at " << k.lat << ", " << k.lon << (k.has_int ? " (int32 " : "") << (k.has_int ? std::to_string(k.lat_int)+", "+std::to_string(k.lon_int)+")" : "") <<
+				(k.sentinels ? " with sentinels: " : ": ") << coord_status_name(status) << ", expected " << coord_status_name(k.expected) << std::endl;
+			mismatches++;
+		}
+		checked++;
+	}
+
+	coord_format_t fmt;
+	fmt.type=COORD_INT32;
+	fmt.big_endian=true;
+	fmt.offset=4;
+	fmt.scale=coord_default_scale(COORD_INT32);
+	fmt.strip=false;
+	coord_decoder_fn decode=coord_select_decoder(fmt);
+
+	for(const auto &p : payloads) {
+		uint8_t buf[12]={0};
+		uint32_t raw_lat=htobe32((uint32_t) p.lat), raw_lon=htobe32((uint32_t) p.lon);
+		coord_decoded_t c;
+		coord_status_t status;
+
+		memcpy(buf+4,&raw_lat,sizeof(raw_lat));
+		memcpy(buf+8,&raw_lon,sizeof(raw_lon));
+
+		// The sentinels are detected only when the relayer does (int32 coordinates with the default scale)
+		status=decode(buf,sizeof(buf),fmt,c) ? coord_validate(c,true) : COORD_UNAVAILABLE;
+
+		if(status!=p.expected) {
+			std::cout << "  Mismatch for the int32 payload " << p.lat << ", " << p.lon << ": " << coord_status_name(status) <<
+				", expected " << coord_status_name(p.expected) << std::endl;
+			mismatches++;
+		}
+		checked++;
+	}
+
+	std::cout << " - " << checked << " coordinates, " << mismatches << " mismatches" << std::endl;
+
+	return mismatches;
+}
+
+// Check the latitudes first_lat, first_lat+step, ... (up to last_lat) at all the levels
+static void check_exhaustive_range(long first_lat, long last_lat, long step, std::atomic<unsigned long> &mismatches) {
+	QuadKeyTSSimple ts[CHECK_MAX_LEVEL-CHECK_MIN_LEVEL+1];
+
+	for(int level=CHECK_MIN_LEVEL;level<=CHECK_MAX_LEVEL;level++) {
+		ts[level-CHECK_MIN_LEVEL].setLevelOfDetail(level);
+	}
+
+	for(long lat_int=first_lat;lat_int<=last_lat;lat_int+=step) {
+		double lat=(double) lat_int/1e7;
+		// The longitude path is the same for both functions: any longitude is fine, as long as it changes
+		double lon=(double) ((lat_int*7919) % 1800000000L)/1e7;
+
+		for(QuadKeyTSSimple &level_ts : ts) {
+			uint32_t x, y, exact_x, exact_y;
+
+			level_ts.LatLonToTileXY(lat,lon,x,y);
+			level_ts.LatLonToTileXYExact(lat,lon,exact_x,exact_y);
+
+			if(x!=exact_x || y!=exact_y) {
+				if(mismatches++<10) {
+					std::cout << "  Mismatch at level " << level_ts.getLevelOfDetail() << ": " << lat << ", " << lon << " -> interpolated " <<
+						x << "/" << y << ", exact " << exact_x << "/" << exact_y << std::endl;
+				}
+			}
+		}
+	}
+}
+
+static unsigned long check_exhaustive(long step) {
+	unsigned int nthreads=std::max(1U,std::thread::hardware_concurrency());
+	long count=(2*CHECK_LAT_INT_MAX)/step+1;
+	long per_thread=(count+nthreads-1)/nthreads;
+	std::vector<std::thread> threads;
+	std::atomic<unsigned long> mismatches(0);
+
+	std::cout << "Interpolated Mercator projection: " << count << " latitudes x " << CHECK_MAX_LEVEL-CHECK_MIN_LEVEL+1 << " levels, " <<
+		nthreads << " thread(s)" << std::endl;
+
+	for(unsigned int t=0;t<nthreads;t++) {
+		long first=-CHECK_LAT_INT_MAX+(long) t*per_thread*step;
+		long last=std::min(CHECK_LAT_INT_MAX,first+(per_thread-1)*step);
+
+		threads.emplace_back(check_exhaustive_range,first,last,step,std::ref(mismatches));
+	}
+
+	for(std::thread &thread : threads) {
+		thread.join();
+	}
+
+	std::cout << " - " << mismatches << " mismatches" << std::endl;
+
+	return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+	long step=argc>1 ? atol(argv[1]) : 1;
+
+	if(step<1) {
+		std::cerr << "Error: invalid step: " << argv[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	unsigned long mismatches=check_batch();
+
+	mismatches+=check_quadkey_strings();
+	mismatches+=check_geohash();
+	mismatches+=check_neighbors();
+	mismatches+=check_tile_cache();
+	mismatches+=check_coord_validate();
+
+	mismatches+=check_exhaustive(step);
+
+	if(mismatches>0) {
+		std::cout << "FAILED: " << mismatches << " mismatches" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All the checks passed" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+// Consistency checks of the station index (run with "make check")
+// - box and tile queries: the stations returned by stationIndex::answer() against a brute-force scan of all the
+//   stations (including expired ones, which must never be returned), on random and clustered positions
+// - station queries: existing, missing and invalid station IDs (e.g., larger than 32 bits, which must not wrap around)
+// The program exits with a non-zero status if any result differs
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "stationindex.h"
+#include "quadkey_ts_simple.h"
+#include "quadkey_morton.h"
+#include "timers.h"
+
+// Level of the tiles of the indexed stations
+#define CHECK_TILE_LEVEL 18
+
+#define CHECK_MAX_AGE_MS 60000
+
+// Indexed stations: spread over the whole map, and clustered around a few places (so that the tile and box queries
+// return many stations without being truncated)
+#define CHECK_SPREAD_STATIONS 100000
+#define CHECK_CLUSTERS 20
+#define CHECK_CLUSTER_STATIONS 5000
+
+#define CHECK_QUERIES 4000
+
+using namespace QuadKeys;
+
+typedef struct _check_station {
+	uint32_t id;
+	double lat;
+	double lon;
+	uint32_t tile_x;
+	uint32_t tile_y;
+	bool expired;
+} check_station_t;
+
+// Parse the answer of a query, returning false if it is an error, and storing the IDs of the returned stations
+static bool parse_answer(const std::string &reply, std::set<uint32_t> &ids, bool &truncated) {
+	std::istringstream lines(reply);
+	std::string status, flag;
+	size_t count;
+
+	if(!(lines >> status >> count) || status!="ok") {
+		return false;
+	}
+
+	std::getline(lines,flag);
+	truncated=flag.find("truncated")!=std::string::npos;
+
+	for(size_t i=0;i<count;i++) {
+		uint32_t id;
+		double lat, lon;
+		uint64_t age_ms;
+
+		if(!(lines >> id >> lat >> lon >> age_ms)) {
+			return false;
+		}
+		ids.insert(id);
+	}
+
+	return true;
+}
+
+// Compare the answer of "query" with the brute-force result "expected" (a truncated answer must be a subset of it)
+static bool compare_query(stationIndex &index, const std::string &query, const std::set<uint32_t> &expected, unsigned long &mismatches) {
+	std::string reply;
+	std::set<uint32_t> ids;
+	bool truncated=false;
+	bool ok;
+
+	index.answer(query.c_str(),reply);
+
+	if(!parse_answer(reply,ids,truncated)) {
+		ok=false;
+	} else if(truncated) {
+		ok=expected.size()>STATIONINDEX_MAX_RESULTS && ids.size()==STATIONINDEX_MAX_RESULTS &&
+			std::includes(expected.begin(),expected.end(),ids.begin(),ids.end());
+	} else {
+		ok=ids==expected;
+	}
+
+	if(!ok) {
+		if(mismatches<10) {
+			std::cout << "  Mismatch for \"" << query << "\": " << ids.size() << (truncated ? " (truncated)" : "") << " stations, expected " <<
+				expected.size() << std::endl;
+		}
+		mismatches++;
+	}
+
+	return truncated;
+}
+
+int main(void) {
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> rand_lat(-90,90), rand_lon(-180,180), rand_unit(0,1);
+	stationIndex index(CHECK_MAX_AGE_MS,CHECK_TILE_LEVEL);
+	std::vector<check_station_t> stations;
+	std::set<uint32_t> ids;
+	QuadKeyTSSimple ts;
+	struct timespec now;
+	unsigned long mismatches=0, truncated=0;
+
+	ts.setLevelOfDetail(CHECK_TILE_LEVEL);
+	clock_gettime(CLOCK_REALTIME,&now);
+	uint64_t now_ns=(uint64_t) now.tv_sec*SEC_TO_NANOSEC+now.tv_nsec;
+
+	for(int i=0;i<CHECK_SPREAD_STATIONS+CHECK_CLUSTERS*CHECK_CLUSTER_STATIONS;i++) {
+		check_station_t station;
+
+		if(i<CHECK_SPREAD_STATIONS) {
+			station.lat=rand_lat(rng);
+			station.lon=rand_lon(rng);
+		} else {
+			// Clusters of about 0.05 degrees, around places spread over the map (including the poles and 180 degrees)
+			static const double centers[][2]={{45.07,7.68},{0,0},{-33.9,151.2},{85.05,179.99},{-85.05,-179.99},{89.99,0},{-89.99,0}};
+			int cluster=(i-CHECK_SPREAD_STATIONS)/CHECK_CLUSTER_STATIONS;
+			std::mt19937_64 center_rng(cluster);
+			double center_lat=cluster<7 ? centers[cluster][0] : rand_lat(center_rng)*0.9;
+			double center_lon=cluster<7 ? centers[cluster][1] : rand_lon(center_rng);
+
+			station.lat=std::max(-90.0,std::min(90.0,center_lat+(rand_unit(rng)-0.5)*0.05));
+			station.lon=std::max(-180.0,std::min(180.0,center_lon+(rand_unit(rng)-0.5)*0.05));
+		}
+
+		station.id=(uint32_t) rng();
+		station.expired=i % 10==0;
+		ts.LatLonToTileXY(station.lat,station.lon,station.tile_x,station.tile_y);
+
+		// Station IDs are unique
+		if(!ids.insert(station.id).second) {
+			continue;
+		}
+
+		index.update(station.id,station.lat,station.lon,station.tile_x,station.tile_y,
+			station.expired ? now_ns-2ULL*CHECK_MAX_AGE_MS*MILLISEC_TO_NANOSEC : now_ns);
+		stations.push_back(station);
+	}
+
+	std::cout.precision(10);
+	std::cout << "Station index: " << stations.size() << " stations" << std::endl;
+
+	for(int i=0;i<CHECK_QUERIES;i++) {
+		const check_station_t &pivot=stations[rng() % stations.size()];
+		std::set<uint32_t> expected;
+		std::ostringstream query;
+
+		query.precision(10);
+
+		if(i % 2==0) {
+			// Box around a station, from about 10 m to about 20 km wide
+			double half_size=pow(10,-4+rand_unit(rng)*3);
+			double lat_min=std::max(-90.0,pivot.lat-half_size*rand_unit(rng)), lat_max=std::min(90.0,pivot.lat+half_size*rand_unit(rng));
+			double lon_min=std::max(-180.0,pivot.lon-half_size*rand_unit(rng)), lon_max=std::min(180.0,pivot.lon+half_size*rand_unit(rng));
+
+			query << "box " << lat_min << " " << lon_min << " " << lat_max << " " << lon_max;
+
+			// The query string is what the index parses: the brute-force scan uses the same (printed) bounds
+			std::istringstream bounds(query.str().substr(4));
+			bounds >> lat_min >> lon_min >> lat_max >> lon_max;
+
+			for(const check_station_t &station : stations) {
+				if(!station.expired && station.lat>=lat_min && station.lat<=lat_max && station.lon>=lon_min && station.lon<=lon_max) {
+					expected.insert(station.id);
+				}
+			}
+		} else {
+			// Tile of a station, at a random level (the larger tiles of the clusters are mostly truncated)
+			unsigned int level=CHECK_TILE_LEVEL-rng() % 12;
+			int shift=CHECK_TILE_LEVEL-level;
+			char quadkey[QUADKEY_MAX_LEVEL+1];
+
+			quadkey_ulong_to_string(quadkey_ulong_encode(pivot.tile_x >> shift,pivot.tile_y >> shift,level),quadkey);
+			query << "tile " << quadkey;
+
+			for(const check_station_t &station : stations) {
+				if(!station.expired && (station.tile_x >> shift)==(pivot.tile_x >> shift) && (station.tile_y >> shift)==(pivot.tile_y >> shift)) {
+					expected.insert(station.id);
+				}
+			}
+		}
+
+		truncated+=compare_query(index,query.str(),expected,mismatches);
+	}
+
+	std::cout << " - box and tile queries: " << CHECK_QUERIES << " (" << truncated << " truncated), " << mismatches << " mismatches" << std::endl;
+
+	// Station queries
+	unsigned long station_mismatches=0;
+	const check_station_t *fresh=NULL, *expired=NULL;
+
+	for(const check_station_t &station : stations) {
+		if(station.expired) {
+			expired=expired==NULL ? &station : expired;
+		} else {
+			fresh=fresh==NULL ? &station : fresh;
+		}
+	}
+
+	compare_query(index,"station "+std::to_string(fresh->id),std::set<uint32_t>{fresh->id},station_mismatches);
+	compare_query(index,"station "+std::to_string(expired->id),std::set<uint32_t>(),station_mismatches);
+	// 2^32 + ID: it must be rejected, not wrap around to the station with that ID
+	std::string wrapped="station "+std::to_string((1ULL << 32)+fresh->id);
+	static const char *invalid[]={"station","station -1","station 12ab","station 99999999999999999999999"};
+	std::vector<std::string> invalid_queries(invalid,invalid+sizeof(invalid)/sizeof(invalid[0]));
+
+	invalid_queries.push_back(wrapped);
+	for(const std::string &query : invalid_queries) {
+		std::string reply;
+
+		index.answer(query.c_str(),reply);
+		if(reply.compare(0,6,"error ")!=0) {
+			std::cout << "  Invalid query \"" << query << "\" accepted: " << reply.substr(0,reply.find('\n')) << std::endl;
+			station_mismatches++;
+		}
+	}
+
+	std::cout << " - station queries: " << station_mismatches << " mismatches" << std::endl;
+	mismatches+=station_mismatches;
+
+	if(mismatches>0) {
+		std::cout << "FAILED: " << mismatches << " mismatches" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All the checks passed" << std::endl;
+
+	return EXIT_SUCCESS;
+}